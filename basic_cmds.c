@@ -21,7 +21,9 @@
 
 #include <string.h>
 #include <inttypes.h>
+#include "nksched.h"
 #include "nkreadline.h"
+#include "nkuart.h"
 #include "nkcli.h"
  
 // Control echoing
@@ -54,36 +56,57 @@ COMMAND(cmd_echo,
 
 // Read/Write/hex-dump memory
 
-static int cmd_mem(nkinfile_t *args)
+static int mem_rd(nkinfile_t *args)
+{
+    uintptr_t addr;
+    if (!nk_fscan(args, "%"PRIxPTR" ", &addr))
+        return NK_SUBCMD_SYNTAX;
+    nk_printf("[%"PRIxPTR"] has %"PRIx32"\n", addr, *(uint32_t *)addr);
+    return 0;
+}
+
+static int mem_wr(nkinfile_t *args)
 {
     uintptr_t addr;
-    uint32_t len;
     uint32_t val;
-    if (facmode && nk_fscan(args, "rd %"PRIxPTR" ", &addr))
-    {
-        nk_printf("[%"PRIxPTR"] has %"PRIx32"\n", addr, *(uint32_t *)addr);
-    }
-    else if (facmode && nk_fscan(args, "wr %"PRIxPTR" %"PRIx32" ", &addr, &val))
-    {
-        *(uint32_t *)addr = val;
-        nk_printf("Wrote %"PRIx32" to [%"PRIxPTR"]\n", val, addr);
-    }
-    else if (facmode && nk_fscan(args, "hd %"PRIxPTR" %"PRIx32" ", &addr, &len))
+    if (!nk_fscan(args, "%"PRIxPTR" %"PRIx32" ", &addr, &val))
+        return NK_SUBCMD_SYNTAX;
+    *(uint32_t *)addr = val;
+    nk_printf("Wrote %"PRIx32" to [%"PRIxPTR"]\n", val, addr);
+    return 0;
+}
+
+static int mem_hd(nkinfile_t *args)
+{
+    uintptr_t addr;
+    uint32_t len;
+    if (nk_fscan(args, "%"PRIxPTR" %"PRIx32" ", &addr, &len))
     {
 	nk_byte_hex_dump((unsigned char *)0, 0, addr, len);
     }
-    else if (facmode && nk_fscan(args, "hd %"PRIxPTR" ", &addr))
+    else if (nk_fscan(args, "%"PRIxPTR" ", &addr))
     {
     	len = 0x100;
 	nk_byte_hex_dump((unsigned char *)0, 0, addr, len);
     }
     else
     {
-        nk_printf("Syntax error\n");
+        return NK_SUBCMD_SYNTAX;
     }
     return 0;
 }
 
+NK_SUBCMDS(mem_subcmds) {
+    NK_SUBCMD_HIDDEN("rd", mem_rd),
+    NK_SUBCMD_HIDDEN("wr", mem_wr),
+    NK_SUBCMD_HIDDEN("hd", mem_hd),
+};
+
+static int cmd_mem(nkinfile_t *args)
+{
+    return NK_SUBCMD_DISPATCH(args, mem_subcmds);
+}
+
 COMMAND(cmd_mem,
     ">mem                       Read/write memory\n"
     "-mem rd <addr>             Read 32-bit word from address\n"
@@ -92,13 +115,121 @@ COMMAND(cmd_mem,
     "-mem hd <addr>             Hex dump 256 bytes\n"
 )
 
+// Show UART receive statistics
+
+static int cmd_uart(nkinfile_t *args)
+{
+    nk_uart_stats_t stats;
+    int clear = 0;
+    if (nk_fscan(args, "stats ") || (clear = nk_fscan(args, "clear "))) {
+        nk_uart_get_stats(&stats, clear);
+        nk_printf("Rx size = %u, high water = %u\n", (unsigned)NK_UART_RXBUF_SIZE, (unsigned)stats.high_water);
+        nk_printf("Overruns = %u, framing errors = %u, dropped = %u\n", (unsigned)stats.overrun, (unsigned)stats.framing, (unsigned)stats.dropped);
+        if (clear)
+            nk_printf("UART statistics cleared\n");
+    } else {
+        nk_printf("Syntax error\n");
+    }
+    return 0;
+}
+
+COMMAND(cmd_uart,
+    ">uart                      UART statistics\n"
+    "-uart stats                Show receive statistics\n"
+    "-uart clear                Show and clear receive statistics\n"
+)
+
+#ifdef NK_UART_INSTANCES
+
+// Change baud rate
+//
+// The new rate has to be confirmed by pressing Enter at it within
+// BAUD_CONFIRM_MS, otherwise we go back to the old one: a rate the terminal
+// can't use doesn't leave us without a console.
+
+#define BAUD_CONFIRM_MS 10000
+
+static uint32_t baud_old;
+static int baud_tid;
+static int baud_timeout_tid;
+
+static void baud_timeout(void *data);
+
+// Characters at the new rate: wait for Enter
+
+static void baud_rx(void *data)
+{
+    int c;
+    (void)data;
+    while ((c = nk_getc()) != -1) {
+        if (c == '\r') {
+            nk_unsched(baud_timeout_tid);
+            nk_printf("Baud rate is now %"PRIu32"\n", nk_uart_get_baud(&nk_uart0));
+            nk_cli_enable();
+            return;
+        }
+    }
+    nk_set_uart_callback(baud_tid, baud_rx, NULL);
+}
+
+static void baud_timeout(void *data)
+{
+    (void)data;
+    nk_unsched(baud_tid); // Stop waiting for input
+    nk_uart_set_baud(&nk_uart0, baud_old);
+    nk_printf("Not confirmed, baud rate is back to %"PRIu32"\n", baud_old);
+    nk_cli_enable();
+}
+
+static int cmd_baud(nkinfile_t *args)
+{
+    uint32_t baud;
+    if (nk_fscan(args, "")) {
+        if (nk_uart_get_baud(&nk_uart0))
+            nk_printf("Baud rate is %"PRIu32"\n", nk_uart_get_baud(&nk_uart0));
+        else
+            nk_printf("Baud rate is unknown\n");
+    } else if (nk_fscan(args, "%"PRIu32" ", &baud)) {
+        if (!baud_tid) {
+            baud_tid = nk_alloc_tid();
+            baud_timeout_tid = nk_alloc_tid();
+        }
+        baud_old = nk_uart_get_baud(&nk_uart0);
+        if (nk_uart_check_baud(&nk_uart0, baud)) {
+            nk_printf("Unsupported baud rate\n");
+            return 0;
+        }
+        nk_printf("Switching to %"PRIu32" baud, press Enter within %d seconds to keep it...\n", baud, BAUD_CONFIRM_MS / 1000);
+        if (nk_uart_set_baud(&nk_uart0, baud)) {
+            nk_printf("Could not change baud rate\n");
+        } else {
+            // Throw away anything garbled by the switch
+            while (nk_getc() != -1);
+            nk_cli_disable();
+            nk_set_uart_callback(baud_tid, baud_rx, NULL);
+            nk_sched(baud_timeout_tid, baud_timeout, NULL, BAUD_CONFIRM_MS, "Baud confirm");
+        }
+    } else {
+        nk_printf("Syntax error\n");
+    }
+    return 0;
+}
+
+COMMAND(cmd_baud,
+    ">baud                      Console baud rate\n"
+    "-baud                      Show baud rate\n"
+    "-baud <rate>               Change baud rate, confirm with Enter\n"
+)
+
+#endif
+
 // Reboot the system
 
 static int cmd_reboot(nkinfile_t *args)
 {
         if (nk_fscan(args, "")) {
             nk_printf("Rebooting...\n");
-            nk_udelay(2000);
+            nk_uart_flush();
             nk_reboot();
         } else {
             nk_printf("Syntax error\n");
@@ -19,4 +19,22 @@
 // OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#ifdef NK_PLATFORM_POSIX
+
+// Host build (Makefile.posix): run as a Linux process
+
+#include "nkarch_posix.h"
+
+#else
+
+// Define for tickless scheduler timer: instead of a 1 kHz tick, timer 2 runs
+// free and only interrupts on overflow and for the next scheduled task
+// #define NK_AVR_TICKLESS
+
+// Define if a 32.768 kHz crystal is on TOSC1/TOSC2 (requires NK_AVR_TICKLESS):
+// timer 2 is clocked from it, so that it keeps running in power-save mode
+// #define NK_AVR_TIMER2_ASYNC
+
 #include "nkarch_avr.h"
+
+#endif
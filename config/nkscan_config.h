@@ -23,4 +23,8 @@
 
 #define NKSCAN_NOFLOAT // No floating support
 
+// #define NKSCAN_SMALL_STRTOD // Leave out the 128-bit powers of 5 for correctly
+                              // rounded floating point (10 KB of flash, 1.6 KB
+                              // where double is 32 bits)
+
 #define NKSCAN_NODBASE // No nkdbase support
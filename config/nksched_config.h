@@ -20,3 +20,39 @@
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #define NK_WORK_QUEUE_SIZE 4
+
+// Keep the work queue in a binary heap instead of a sorted linked list.
+// Submit, reschedule and cancel are then O(log n) instead of O(n), which
+// bounds the time spent with interrupts disabled for large queues.  This
+// needs the tid index below: if NK_SCHED_TID_INDEX_SIZE is not defined, it
+// defaults to NK_WORK_QUEUE_SIZE.
+// #define NK_SCHED_HEAP
+
+// Size of direct mapped tid to task table.  With this, finding the pending
+// task for a tid is O(1) for tids below this number instead of a search of
+// the queue.  Costs one pointer per entry: leave undefined on small parts
+// unless NK_SCHED_HEAP is defined.
+// #define NK_SCHED_TID_INDEX_SIZE 64
+
+// Keep per-task run count, execution time and dispatch lateness for tids
+// below this number, shown with "work stats".  Leave undefined to compile
+// the instrumentation out.
+// #define NK_SCHED_STATS_SIZE 16
+
+// Number of interrupt sources which can post tasks with nk_sched_from_isr().
+// This is much cheaper than calling nk_sched() from an interrupt handler.
+// Leave undefined to compile out.
+#define NK_SCHED_ISR_SOURCES 2
+
+// Periodic tasks with nk_sched_periodic().  Costs an nk_time_t per work queue
+// entry.  Leave undefined to compile out.
+#define NK_SCHED_PERIODIC
+
+// Timer slack with nk_sched_slack(), so that tasks can share wakeups.  Costs
+// an nk_time_t per work queue entry.  Leave undefined to compile out.
+// #define NK_SCHED_SLACK
+
+// Events with nk_event_wait() and nk_event_signal().  Costs two pointers
+// per work queue entry.  Needed by nkuart_avr.c, nkuart_posix.c and
+// NK_AWAIT_EVENT().  Leave undefined to compile out.
+#define NK_SCHED_EVENTS
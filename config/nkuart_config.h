@@ -26,3 +26,54 @@
 // #define NK_UART_RXBUF_SIZE 16384 // for 921600 Baud
 // #define NK_UART_RXBUF_SIZE 2048 // for 115200 Baud
 #define NK_UART_RXBUF_SIZE 128 // for small systems...
+
+// Console baud rate.  UBRR and U2X are picked at compile time for the rate
+// closest to this, and it's an error if that's off by more than
+// NK_UART_BAUD_MAX_ERROR (in units of 0.1%, default 25).  With a 16 MHz
+// clock, 115200 is 2.1% fast using U2X.
+// #define BAUD 115200
+// #define NK_UART_BAUD_MAX_ERROR 25
+
+// Rx buffer index type: defaults to the smallest type that holds
+// NK_UART_RXBUF_SIZE (uint8_t up to 128)
+// #define NK_UART_RX_IDX_TYPE uint16_t
+
+// Wake the task waiting for input only once this many characters are
+// buffered, or once the line has been idle for NK_UART_RX_WAKE_IDLE ms
+// (default 2).  This schedules the task once per burst instead of once per
+// character.
+// #define NK_UART_RX_WAKE_THRESHOLD 16
+// #define NK_UART_RX_WAKE_IDLE 2
+
+// Transmit buffer size (power of 2): define to send from a buffer drained by
+// the transmit interrupt instead of waiting for the UART with interrupts
+// disabled
+#define NK_UART_TXBUF_SIZE 64
+
+// Define to drop characters when the transmit buffer is full, instead of
+// waiting for space
+// #define NK_UART_TX_DROP
+
+// Software flow control: XOFF / XON from the other side pause and resume
+// output, and we send XOFF when the Rx buffer is 3/4 full and XON when it's
+// back down to 1/4.  Not in binary mode (nk_set_uart_mode(1), as used by
+// YMODEM): XON and XOFF are data then.
+// #define NK_UART_XONXOFF
+
+// Hardware flow control on any GPIO pins: output stops while CTS is high, and
+// RTS is driven high when the Rx buffer is 3/4 full.  The CTS pin change
+// interrupt must call nk_uart_cts_changed(&nk_uart0).  The RTS pin has to be
+// set as an output.
+// #define NK_UART_CTS_PIN PIND
+// #define NK_UART_CTS_BIT 2
+// #define NK_UART_RTS_PORT PORTD
+// #define NK_UART_RTS_BIT 3
+
+// Second USART (ATmega328PB): define its buffer sizes to get nk_uart1
+// #define NK_UART1_RXBUF_SIZE 128
+// #define NK_UART1_TXBUF_SIZE 64
+// #define NK_UART1_BAUD 38400
+// #define NK_UART1_CTS_PIN PINB
+// #define NK_UART1_CTS_BIT 0
+// #define NK_UART1_RTS_PORT PORTB
+// #define NK_UART1_RTS_BIT 1
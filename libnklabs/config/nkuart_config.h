@@ -26,3 +26,23 @@
 // #define NK_UART_RXBUF_SIZE 16384 // for 921600 Baud
 #define NK_UART_RXBUF_SIZE 2048 // for 115200 Baud
 //#define NK_UART_RXBUF_SIZE 256 // for small systems...
+
+// Rx buffer index type: defaults to the smallest type that holds
+// NK_UART_RXBUF_SIZE (uint8_t up to 128)
+// #define NK_UART_RX_IDX_TYPE uint16_t
+
+// Wake the task waiting for input only once this many characters are
+// buffered, or once the line has been idle for NK_UART_RX_WAKE_IDLE ms
+// (default 2).  This schedules the task once per burst instead of once per
+// character.
+// #define NK_UART_RX_WAKE_THRESHOLD 16
+// #define NK_UART_RX_WAKE_IDLE 2
+
+// Transmit buffer size (power of 2): define to send from a buffer drained by
+// the transmit interrupt instead of waiting for the UART with interrupts
+// disabled
+// #define NK_UART_TXBUF_SIZE 64
+
+// Define to drop characters when the transmit buffer is full, instead of
+// waiting for space
+// #define NK_UART_TX_DROP
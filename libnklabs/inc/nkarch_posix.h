@@ -0,0 +1,120 @@
+// POSIX host port
+
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Run libnklabs applications as an ordinary Linux (or other POSIX) process
+//
+// There are no real interrupts: nk_irq_unlock_and_wait() sleeps in poll()
+// until the next scheduled wakeup or until a registered file descriptor is
+// readable, then calls that descriptor's handler as if it was an interrupt
+// handler.  Everything runs in one thread, so locks are no-ops.
+
+#ifndef _Inkarch_posix
+#define _Inkarch_posix
+
+#include <stdint.h>
+#include <stddef.h>
+
+// This is not AVR..
+#define NK_FLASH
+
+// nkuart_posix.c provides the nk_uart_t API of nkuart.h
+#define NK_UART_INSTANCES
+
+// Borrow Linux kernel lock syntax
+
+typedef int nk_spinlock_t;
+typedef int nk_irq_flag_t;
+#define SPIN_LOCK_UNLOCKED 0
+
+// Restore interrupt enable flag
+static inline __attribute__((always_inline)) void nk_irq_unlock(nk_spinlock_t *lock, nk_irq_flag_t flags)
+{
+    (void)lock;
+    (void)flags;
+}
+
+// Save interrupt enable flag and disable all interrupts
+static inline __attribute__((always_inline)) nk_irq_flag_t nk_irq_lock(nk_spinlock_t *lock)
+{
+    (void)lock;
+    return 0;
+}
+
+// Restore interrupt enable flag, then wait for the next scheduled wakeup or
+// for a registered file descriptor to become readable
+//
+// This always sleeps in poll() until the wakeup time or until a descriptor is
+// readable, whatever the deepness: busy waiting would only burn host CPU.
+
+void nk_irq_unlock_and_wait(nk_spinlock_t *lock, nk_irq_flag_t flags, int deepness);
+
+// Register an "interrupt handler": 'handler' is called from
+// nk_irq_unlock_and_wait() when 'fd' is readable.  Returns 0 for success, -1
+// if NK_POSIX_MAX_FDS are already registered.
+
+#ifndef NK_POSIX_MAX_FDS
+#define NK_POSIX_MAX_FDS 4
+#endif
+
+int nk_posix_irq_fd(int fd, void (*handler)(void));
+
+// Scheduler timer: CLOCK_MONOTONIC in microseconds
+
+typedef uint32_t nk_time_t;
+
+// Units for scheduler time
+#define NK_TIME_COUNTS_PER_SECOND 1000000
+#define NK_TIME_COUNTS_PER_USECOND 1
+
+// Get current time
+nk_time_t nk_get_time();
+
+// Convert milliseconds into scheduler time
+nk_time_t nk_convert_delay(uint32_t delay);
+
+// Initialize scheduler timer
+void nk_init_sched_timer();
+
+// Set an alarm for 'when'.  The next nk_irq_unlock_and_wait() returns by
+// this time.
+
+void nk_sched_wakeup(nk_time_t when);
+
+// Microsecond delay
+
+void nk_udelay(unsigned long usec);
+
+// MCU flash is simulated in RAM
+
+#ifndef NK_MCUFLASH_SIZE
+#define NK_MCUFLASH_SIZE 65536
+#endif
+
+#define NK_MCUFLASH_ERASE_SIZE 4096
+
+// Reboot: restore the terminal and exit
+
+void nk_reboot(void);
+
+#endif
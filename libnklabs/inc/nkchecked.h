@@ -30,6 +30,13 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include "nkoutfile.h"
+
+// Largest flash write granularity supported by nk_checked_writev()
+
+#ifndef NK_CHECKED_MAX_GRANULARITY
+#define NK_CHECKED_MAX_GRANULARITY 32
+#endif
 
 // File header
 
@@ -51,6 +58,8 @@ typedef struct {
     int (* const flash_erase)(const void *info, uint32_t addr, uint32_t size); // NULL for no erase
     int (* const flash_write)(const void *info, uint32_t addr, const uint8_t *buf, size_t size);
     const size_t granularity;
+    // Optional: return pointer to memory mapped flash, or NULL if it must be read with flash_read
+    const uint8_t *(* const flash_map)(const void *info, uint32_t addr);
 } nk_checked_base_t;
 
 // File access structure: variable part
@@ -72,9 +81,19 @@ int nk_checked_write_open(nk_checked_t *var_file, const nk_checked_base_t *file)
 // For nkoutfile_t: write a block to the file
 int nk_checked_write(nk_checked_t *ptr, const unsigned char *buffer, size_t len);
 
+// For nkoutfile_t with block_writev: write segments to the file.  A write unit
+// (granularity bytes) that straddles two segments is assembled in a small
+// local buffer, everything else is written directly from the segments.
+int nk_checked_writev(nk_checked_t *ptr, const struct nkoutfile_seg *seg, size_t nseg);
+
 // Close write file: write header
 int nk_checked_write_close(nk_checked_t *var_file);
 
+// Return pointer to the data of a file opened for reading if it can be
+// accessed in place (see flash_map), otherwise NULL.  For example, pass it
+// to nkinfile_open_mem() instead of using nk_checked_read().
+const uint8_t *nk_checked_map(nk_checked_t *var_file);
+
 // For nkinfile_t: read a block from the file
 size_t nk_checked_read(nk_checked_t *ptr, uint32_t offset, unsigned char *buffer, size_t block_size);
 
@@ -71,6 +71,43 @@ static struct console_cmd cmd_entry_ ## func __attribute__ ((section (".COMMAND_
 
 #endif
 
+// Subcommand tables
+
+// Most commands are a keyword followed by arguments: "mem rd <addr>".
+// Instead of trying a chain of nk_fscan() calls, each of which rescans the
+// keyword, a command can declare a table of subcommands and pass its
+// arguments to nk_subcmd().  The keyword is scanned once and the matching
+// handler is called with the input positioned just after it, so the
+// handler's nk_fscan() formats hold only the arguments.
+
+// The table lives in flash.  The name is a fixed size array, not a pointer,
+// because PSTR() can not be used at file scope.
+
+#ifndef NK_MAX_SUBCMD_LEN
+#define NK_MAX_SUBCMD_LEN 8
+#endif
+
+struct nk_subcmd {
+    char name[NK_MAX_SUBCMD_LEN]; // Subcommand keyword, "" to match no arguments
+    unsigned char hidden; // Set if only available in factory mode
+    int (*func)(nkinfile_t *args); // Subcommand function
+};
+
+// Subcommand function return value: print "Syntax error"
+#define NK_SUBCMD_SYNTAX (-1)
+
+#define NK_SUBCMDS(table) static const NK_FLASH struct nk_subcmd table[] =
+#define NK_SUBCMD(name, func) { (name), 0, (func) }
+#define NK_SUBCMD_HIDDEN(name, func) { (name), 1, (func) }
+
+// Find the subcommand named by the next word of args and call it.  Prints
+// "Syntax error" for an unknown subcommand or if it returns
+// NK_SUBCMD_SYNTAX.  Otherwise returns the subcommand's return value.
+
+int nk_subcmd(nkinfile_t *args, const NK_FLASH struct nk_subcmd *table, size_t count);
+
+#define NK_SUBCMD_DISPATCH(args, table) nk_subcmd((args), (table), sizeof(table) / sizeof((table)[0]))
+
 // Start up CLI, print first prompt
 // (this submits a task, so prompt is issued on next return to sched)
 void nk_init_cli(void);
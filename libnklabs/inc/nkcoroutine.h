@@ -0,0 +1,155 @@
+// Stackless coroutines
+
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Stackless coroutines (protothreads) on top of the work queue
+//
+// A coroutine is an ordinary work queue task whose body is wrapped in
+// NK_CO_BEGIN() / NK_CO_END().  Instead of spinning, it can give the main
+// loop back with NK_AWAIT_DELAY() or NK_AWAIT_UNTIL() and pick up at the
+// same place the next time it is called.
+//
+// The resume point is kept as a line number in an nk_co_t, and the body is
+// one big switch statement, so:
+//   - Local variables are not preserved across an await: keep state in
+//     static variables or in the structure passed as 'data'.
+//   - Awaits must be in the coroutine function itself, not in a function
+//     it calls, and not inside a switch statement of its own.
+//   - Only one await per source line.
+
+#ifndef _Inkcoroutine
+#define _Inkcoroutine
+
+#include "nksched.h"
+
+typedef struct {
+	unsigned short lc; // Resume point: 0 for not running, 1 for start at the top
+	int tid; // Task ID the coroutine runs under
+	void (*func)(void *data); // Coroutine function and its argument
+	void *data;
+	const NK_FLASH char *name; // Function name for "work" command
+} nk_co_t;
+
+#ifdef NK_PSTR
+
+#define _nk_co_name(func) PSTR(#func)
+#define _nk_co_sched(co, delay, comment) _nk_sched((co)->tid, (co)->func, (co)->data, (delay), (co)->name, PSTR(__FILE__ ":" nk_tostring(__LINE__)), PSTR(comment))
+#define _nk_co_wait(co, ev, timeout, comment) _nk_event_wait((ev), (co)->tid, (co)->func, (co)->data, (timeout), (co)->name, PSTR(__FILE__ ":" nk_tostring(__LINE__)), PSTR(comment))
+
+#else
+
+#define _nk_co_name(func) #func
+#define _nk_co_sched(co, delay, comment) _nk_sched((co)->tid, (co)->func, (co)->data, (delay), (co)->name, __FILE__ ":" nk_tostring(__LINE__), comment)
+#define _nk_co_wait(co, ev, timeout, comment) _nk_event_wait((ev), (co)->tid, (co)->func, (co)->data, (timeout), (co)->name, __FILE__ ":" nk_tostring(__LINE__), comment)
+
+#endif
+
+// Start (or restart from the top) coroutine function 'f' with argument
+// 'd'.  It is first called the next time we return to the main loop.
+// A task ID is allocated on first use.
+
+#define nk_co_start(co, f, d) do { \
+	if (!(co)->tid) \
+		(co)->tid = nk_alloc_tid(); \
+	(co)->lc = 1; \
+	(co)->func = (f); \
+	(co)->data = (d); \
+	(co)->name = _nk_co_name(f); \
+	_nk_co_sched((co), 0, "Coroutine start"); \
+} while (0)
+
+// Wake up a coroutine blocked in NK_AWAIT_UNTIL() so that it re-checks its
+// condition.  This is safe to call from interrupt handlers.
+
+#define nk_co_wake(co) _nk_co_sched((co), 0, "Coroutine wake")
+
+// Stop a coroutine: cancel any pending delay and forget the resume point
+
+#define nk_co_stop(co) do { \
+	nk_unsched((co)->tid); \
+	(co)->lc = 0; \
+} while (0)
+
+// Returns true if the coroutine has been started and has not finished
+
+#define nk_co_running(co) ((co)->lc != 0)
+
+// Begin and end the body of a coroutine.  Only nk_co_start() starts the
+// body: a coroutine which has finished or was stopped returns at once if its
+// task ID is submitted again, for example by a late nk_co_wake().
+
+#define NK_CO_BEGIN(co) switch ((co)->lc) { case 0: return; case 1: (co)->lc = 1;
+
+#define NK_CO_END(co) } (co)->lc = 0; return
+
+// Finish early
+
+#define NK_CO_EXIT(co) do { (co)->lc = 0; return; } while (0)
+
+// Yield to the main loop for 'ms' milliseconds, then continue
+
+#define NK_AWAIT_DELAY(co, ms) do { \
+	(co)->lc = __LINE__; \
+	_nk_co_sched((co), (ms), "Coroutine delay"); \
+	return; \
+	case __LINE__:; \
+} while (0)
+
+#ifdef NK_SCHED_EVENTS
+
+// Yield until event 'ev' is signaled, or for at most 'ms' milliseconds
+// (NK_EVENT_FOREVER for no timeout).  The coroutine continues either way, so
+// check what it was waiting for.
+
+#define NK_AWAIT_EVENT(co, ev, ms) do { \
+	(co)->lc = __LINE__; \
+	_nk_co_wait((co), (ev), (ms), "Coroutine event"); \
+	return; \
+	case __LINE__:; \
+} while (0)
+
+#endif
+
+// Yield until 'cond' is true.  The condition is checked now, and again each
+// time the coroutine is woken up with nk_co_wake() (or by anything else that
+// submits its task ID).
+
+#define NK_AWAIT_UNTIL(co, cond) do { \
+	(co)->lc = __LINE__; \
+	case __LINE__: \
+	if (!(cond)) \
+		return; \
+} while (0)
+
+// Yield until 'cond' is true, checking it every 'ms' milliseconds.  For
+// hardware that has no interrupt to tell us when it's ready.
+
+#define NK_AWAIT_POLL(co, cond, ms) do { \
+	(co)->lc = __LINE__; \
+	case __LINE__: \
+	if (!(cond)) { \
+		_nk_co_sched((co), (ms), "Coroutine poll"); \
+		return; \
+	} \
+} while (0)
+
+#endif
@@ -37,10 +37,15 @@ struct nk_dbase {
 	nk_checked_base_t bank1;
 	unsigned char * const buf; // Transfer buffer for flash memory: this is used for flash_read and flash_write
 	const size_t buf_size; // Size of above buffer
+	// Number of buf_size blocks in buf used as a window when loading (0 or 1 for just one)
+	//  buf must then be buf_blocks * buf_size bytes
+	const size_t buf_blocks;
 	// Flash write granularity
 	//  flash_writes are padded to a multiple of this size
 	//  flash_granularity must be a power of 2 (including 2^0 == 1)
 	const uint32_t flash_granularity;
+	// Set to print block window counters after each load, for tuning buf_blocks
+	const int verbose;
 };
 
 // Bump version number and save a database from RAM to flash
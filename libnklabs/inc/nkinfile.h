@@ -45,6 +45,36 @@
 
 typedef struct nkinfile nkinfile_t;
 
+// Window of several blocks for block-based files: see nkinfile_open_window()
+
+#ifndef NKINFILE_WINDOW_MAX
+#define NKINFILE_WINDOW_MAX 4 // Maximum number of blocks in a window
+#endif
+
+typedef struct nkinfile_window nkinfile_window_t;
+
+struct nkinfile_window
+{
+    unsigned char *buffer; // nblocks * block_size bytes
+    size_t nblocks; // Number of blocks in window
+
+    // Start reading a block in the background, or NULL
+    void (*block_prefetch)(void *block_read_ptr, size_t pos, unsigned char *buffer, size_t block_size);
+
+    // Block in each buffer
+    size_t pos[NKINFILE_WINDOW_MAX]; // File offset of block, NKINFILE_EMPTY if none
+    size_t len[NKINFILE_WINDOW_MAX]; // Bytes in block, NKINFILE_PENDING if prefetch not yet complete
+
+    // Statistics
+    size_t reads; // Number of blocks read (including prefetches)
+    size_t hits; // Number of times we moved to a block already in the window
+    size_t rereads; // Number of reads of blocks which had been read before
+    size_t read_end; // End of furthest block read so far
+};
+
+#define NKINFILE_EMPTY ((size_t)-1)
+#define NKINFILE_PENDING ((size_t)-1)
+
 struct nkinfile
 {
     // Information about current buffer
@@ -59,6 +89,7 @@ struct nkinfile
     void *block_read_ptr; // Pointer to pass to block_read
     size_t (*block_read)(void *block_read_ptr, size_t pos, unsigned char *buffer, size_t block_size);
     size_t block_size; // Block size, also buffer must be this size
+    nkinfile_window_t *window; // Window of blocks, or NULL if buffer holds just one
 };
 
 // Return current file position
@@ -199,6 +230,36 @@ inline __attribute__((always_inline)) int nk_fnext(nkinfile_t *f)
         return nk_fnext_fast(f);
 }
 
+// Span access for scanners
+
+// The bytes from f->ptr up to nk_fspan_end(f) are in the current buffer and
+// may be examined directly instead of with a call per character.  For
+// nkinfile_open_mem() and nkinfile_open_string() this is the rest of the
+// file.
+
+inline __attribute__((always_inline)) const unsigned char *nk_fspan_end(nkinfile_t *f)
+{
+    return f->end;
+}
+
+// Set file position to p, somewhere in the current span.  If p is at the end
+// of the span, load the next one: returns true if there is more to scan, or
+// false if p is not at the end or if we are at end of file.
+
+inline __attribute__((always_inline)) int nk_fspan_next(nkinfile_t *f, const unsigned char *p)
+{
+    if (p != f->end || p == f->ptr)
+    {
+        // Stopped within span, or nothing was consumed from an empty span (end of file)
+        f->ptr = p;
+        return 0;
+    }
+    else
+    {
+        return nk_fseek_slow(f, f->start_offset + f->len) != -1;
+    }
+}
+
 // Read current character, then advance to next position
 // Only safe to call if you know we're not already at end of file
 // Always returns valid character
@@ -238,6 +299,29 @@ nkinfile_t *nkinfile_open(
     unsigned char *buffer
 );
 
+// Open a block device with a window of several blocks, and optionally
+// read-ahead
+nkinfile_t *nkinfile_open_window(
+    nkinfile_t *f,
+    size_t (*block_read)(
+        void *block_read_ptr,
+        size_t pos,
+        unsigned char *buffer,
+        size_t block_size
+    ),
+    void (*block_prefetch)(
+        void *block_read_ptr,
+        size_t pos,
+        unsigned char *buffer,
+        size_t block_size
+    ),
+    void *block_read_ptr,
+    size_t block_size,
+    unsigned char *buffer, // nblocks * block_size bytes
+    size_t nblocks,
+    nkinfile_window_t *window
+);
+
 // Open a memory block as a file
 nkinfile_t *nkinfile_open_mem(nkinfile_t *f, const unsigned char *mem, size_t size);
 
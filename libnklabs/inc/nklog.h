@@ -0,0 +1,65 @@
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _NKLOG_H
+#define _NKLOG_H
+
+// Deferred logging
+//
+// nk_log() takes printf arguments like nk_printf(), but only stores the
+// time, the format string pointer and the raw arguments in a RAM ring
+// buffer.  The records are formatted and printed later, when the work queue
+// is idle.  This makes it cheap enough for interrupt handlers and time
+// critical loops.
+//
+// The format string and any %s strings are kept by pointer: they must still
+// be there when the record is printed, so use string constants.
+
+#include "nkprintf.h"
+#include "nklog_config.h"
+
+#ifdef NK_PSTR
+
+void _nk_log(const NK_FLASH char *fmt, ...);
+#define nk_log(a, ...) _nk_log(PSTR(a), ##__VA_ARGS__)
+
+#else
+
+void _nk_log(const NK_FLASH char *fmt, ...) __attribute__((__format__ (__printf__, 1, 2)));
+#define nk_log(a, ...) _nk_log((a), ##__VA_ARGS__)
+
+#endif
+
+// Print the oldest record, returns 0 if there were none
+
+int nk_log_print(void);
+
+// Print all records now, for example from a fault handler before it resets
+// the system
+
+void nk_log_dump(void);
+
+// Initialize logging: records are printed whenever the work queue is idle.
+// If the buffer survived a reset (NK_LOG_NOINIT), its records are kept.
+
+void nk_init_log(void);
+
+#endif
@@ -42,4 +42,9 @@ int nk_mcuflash_write(const void *info, uint32_t address, const uint8_t *data, s
 // Return 0 for success, -1 for error.
 int nk_mcuflash_read(const void *info, uint32_t address, uint8_t *data, size_t byte_count);
 
+// Return pointer to flash memory at address if it is memory mapped, so that
+// it can be read in place instead of copied with nk_mcuflash_read.
+// Returns NULL if flash can not be read directly.
+const uint8_t *nk_mcuflash_map(const void *info, uint32_t address);
+
 #endif
@@ -30,6 +30,14 @@
 
 typedef struct nkoutfile nkoutfile_t;
 
+// One segment of a vectored write
+
+struct nkoutfile_seg
+{
+    const unsigned char *ptr;
+    size_t len;
+};
+
 struct nkoutfile
 {
     // Information about output buffer
@@ -42,6 +50,13 @@ struct nkoutfile
     void *block_write_ptr; // Pointer to pass to block_read
     int (*block_write)(void *block_write_ptr, unsigned char *buffer, size_t len);
     size_t granularity; // Write granularity
+
+    // Optional vectored version of block_write: write nseg segments in order
+    // as one block.  Only the total length is a multiple of the granularity,
+    // the individual segments need not be.  When present it is used instead
+    // of block_write, so that buffered data and caller's data can be written
+    // together without first copying the caller's data into the buffer.
+    int (*block_writev)(void *block_write_ptr, const struct nkoutfile_seg *seg, size_t nseg);
 };
 
 // Write character to file, flush if buffer is full
@@ -65,6 +80,13 @@ inline  __attribute__((always_inline)) int nk_fputc(nkoutfile_t *f, int c)
     }
 }
 
+// Write len bytes from buf.  If nothing is buffered and there is at least a
+// buffer's worth, the data is passed straight to block_write without copying
+// it into the buffer.  With block_writev, this is also done when something is
+// buffered: the buffer and the data are written as two segments.  Returns the
+// return value of block_write or 0.
+int nk_fwrite(nkoutfile_t *f, const unsigned char *buf, size_t len);
+
 // Flush buffered output.  Returns return value of block_write().
 // Note that block_write() is called with a length of 0 if there is no data to flush.
 int nk_fflush(nkoutfile_t *f);
@@ -83,6 +105,20 @@ nkoutfile_t *nkoutfile_open(
     size_t granularity
 );
 
+// Open a block device with a vectored write function
+nkoutfile_t *nkoutfile_open_writev(
+    nkoutfile_t *f,
+    int (*block_writev)(
+        void *block_write_ptr,
+        const struct nkoutfile_seg *seg,
+        size_t nseg
+    ),
+    void *block_write_ptr,
+    unsigned char *buffer,
+    size_t len,
+    size_t granularity
+);
+
 // Open a memory block as a file
 nkoutfile_t *nkoutfile_open_mem(nkoutfile_t *f, char *mem, size_t size);
 
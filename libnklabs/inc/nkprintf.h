@@ -66,6 +66,10 @@ int nk_indent(int ind);
 //  _ prints an empty string.  This is useful for variable indentation, as in nk_printf("%*_Hello, world!\n", indent);
 //
 //  v prints an nkdbase in serialized format, for example:   nk_printf("%v", type, location);
+//
+//  r prints a double with the fewest digits which read back as exactly the
+//    same value, or "nan", "inf" or "-inf".  %hr does the same for a float.
+//    With '#', there is always a decimal point or an exponent: "1.0".
 
 #ifdef NK_PSTR
 // Adorn format strings with PSTR() for AVR
@@ -123,6 +127,16 @@ int _nk_sfprintf(char *dest, size_t len, const NK_FLASH char *fmt,...) __attribu
 
 #endif
 
+// Deferred printing, as used by nk_log(): pack the arguments for fmt into
+// buf without formatting them.  Returns the packed length, or -1 if they
+// don't fit in len bytes.
+
+int _nk_vpack_args(void *buf, size_t len, const NK_FLASH char *fmt, va_list ap);
+
+// Print with arguments packed by _nk_vpack_args()
+
+int _nk_vprintf_packed(nkoutfile_t *f, const NK_FLASH char *fmt, const void *packed);
+
 extern nkoutfile_t *nkstdout;
 extern nkoutfile_t *nkstderr;
 extern nkoutfile_t *nkstdnull;
@@ -57,4 +57,7 @@ DEALINGS IN THE SOFTWARE.
 #define FLgformat	0x1000		/* g floating point format	*/
 char  *__floatfmt(int c, int flags, int precision, double *pdval, char *buf, int *psl, int width);
 
+// Shortest round-trip formatter (as a float if single is set)
+char  *__floatshort(int c, int flags, double *pdval, char *buf, int *psl, int single);
+
 #endif
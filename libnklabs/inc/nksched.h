@@ -53,6 +53,184 @@ int _nk_sched(int tid, void (*func)(void *data), void *data, uint32_t delay, con
 
 #endif
 
+#ifdef NK_SCHED_SLACK
+
+// Submit a callback function with timer slack.  Like nk_sched(), but the
+// main loop may call it up to 'slack' ms after 'delay' so that its wakeup
+// can be shared with other tasks.  When the system wakes up, every task
+// whose delay has passed is called.
+//
+// This is safe to call from interrupt handlers
+//
+// Returns 1 if new task was submitted
+// Returns 0 if existing task was rescheduled
+
+#ifdef NK_PSTR
+
+int _nk_sched_slack(int tid, void (*func)(void *data), void *data, uint32_t delay, uint32_t slack, const __flash char *name, const __flash char *by, const __flash char *comment);
+
+#define nk_sched_slack(tid, func, data, delay, slack, comment) _nk_sched_slack(tid, func, data, delay, slack, PSTR(#func), PSTR(__FILE__ ":" nk_tostring(__LINE__)), PSTR(comment))
+
+#else
+
+int _nk_sched_slack(int tid, void (*func)(void *data), void *data, uint32_t delay, uint32_t slack, const char *name, const char *by, const char *comment);
+
+#define nk_sched_slack(tid, func, data, delay, slack, comment) _nk_sched_slack(tid, func, data, delay, slack, #func, __FILE__ ":" nk_tostring(__LINE__), comment)
+
+#endif
+
+#endif
+
+#ifdef NK_SCHED_PERIODIC
+
+// Submit a periodic callback function to the work queue.  The main loop
+// first calls it 'phase' ms in the future, then every 'period' ms after
+// that.  The task stays in the queue between calls, and each deadline is
+// the previous deadline plus the period, so time spent in the task (or
+// in other tasks) does not cause drift.
+//
+// If the main loop falls behind by more than one period:
+//   NK_SCHED_CATCHUP: the missed calls are made back to back
+//   NK_SCHED_SKIP: the missed calls are dropped, next call is at the next
+//                  period boundary
+//
+// The task is stopped with nk_unsched().  nk_sched() on the same tid turns
+// it back into a one-shot task.  nk_resched() keeps it periodic with the
+// new phase.
+//
+// This is safe to call from interrupt handlers
+//
+// Returns 1 if new task was submitted
+// Returns 0 if existing task was replaced
+
+#define NK_SCHED_CATCHUP 0
+#define NK_SCHED_SKIP 1
+
+#ifdef NK_PSTR
+
+int _nk_sched_periodic(int tid, void (*func)(void *data), void *data, uint32_t period, uint32_t phase, int flags, const __flash char *name, const __flash char *by, const __flash char *comment);
+
+#define nk_sched_periodic(tid, func, data, period, phase, flags, comment) _nk_sched_periodic(tid, func, data, period, phase, flags, PSTR(#func), PSTR(__FILE__ ":" nk_tostring(__LINE__)), PSTR(comment))
+
+#else
+
+int _nk_sched_periodic(int tid, void (*func)(void *data), void *data, uint32_t period, uint32_t phase, int flags, const char *name, const char *by, const char *comment);
+
+#define nk_sched_periodic(tid, func, data, period, phase, flags, comment) _nk_sched_periodic(tid, func, data, period, phase, flags, #func, __FILE__ ":" nk_tostring(__LINE__), comment)
+
+#endif
+
+#endif
+
+#ifdef NK_SCHED_EVENTS
+
+// Events
+//
+// A task can wait for an event instead of polling or using a driver specific
+// callback.  nk_event_signal() wakes up every task waiting for the event: each
+// one is called with no delay, through the work queue.  A waiting task is
+// also called if its timeout expires first.  Either way it is no longer
+// waiting once it's called, so it should check what it was waiting for and
+// wait again if necessary.
+//
+// A task waits for at most one event.  nk_sched(), nk_unsched() or another
+// nk_event_wait() on the same tid cancel the wait.
+
+typedef struct {
+	void *waiters; // Work queue items of waiting tasks
+} nk_event_t;
+
+#define NK_EVENT_INIT { 0 }
+
+// Timeout for no timeout
+#define NK_EVENT_FOREVER 0xFFFFFFFF
+
+// Wait for an event: 'func' is called with 'data' after the event is
+// signaled, or after 'timeout' ms.
+//
+// This is safe to call from interrupt handlers
+//
+// Returns 1 if new task was submitted
+// Returns 0 if existing task was replaced
+
+#ifdef NK_PSTR
+
+int _nk_event_wait(nk_event_t *ev, int tid, void (*func)(void *data), void *data, uint32_t timeout, const __flash char *name, const __flash char *by, const __flash char *comment);
+
+#define nk_event_wait(ev, tid, func, data, timeout, comment) _nk_event_wait(ev, tid, func, data, timeout, PSTR(#func), PSTR(__FILE__ ":" nk_tostring(__LINE__)), PSTR(comment))
+
+#else
+
+int _nk_event_wait(nk_event_t *ev, int tid, void (*func)(void *data), void *data, uint32_t timeout, const char *name, const char *by, const char *comment);
+
+#define nk_event_wait(ev, tid, func, data, timeout, comment) _nk_event_wait(ev, tid, func, data, timeout, #func, __FILE__ ":" nk_tostring(__LINE__), comment)
+
+#endif
+
+// Signal an event: wake up all tasks waiting for it.  A signal with no
+// tasks waiting is not remembered.
+//
+// This is safe to call from interrupt handlers
+//
+// Returns number of tasks woken up
+
+int nk_event_signal(nk_event_t *ev);
+
+// Returns true if any tasks are waiting for the event
+
+static inline int nk_event_waiting(nk_event_t *ev)
+{
+	return ev->waiters != 0;
+}
+
+#endif
+
+#ifdef NK_SCHED_ISR_SOURCES
+
+// Fast submission from interrupt handlers
+//
+// nk_sched() from an interrupt handler searches and relinks the work queue
+// with interrupts disabled.  Instead, allocate an interrupt source and set
+// the task it submits ahead of time.  The interrupt handler then calls
+// nk_sched_from_isr(), which only sets two flags.  The main loop submits
+// the task (with no delay) on its next pass.  Posting a source more than
+// once before the main loop runs submits the task once.
+
+// Allocate an interrupt source number, returns -1 if NK_SCHED_ISR_SOURCES
+// are all in use
+int nk_alloc_isr_source();
+
+// Set task submitted when source 'src' is posted
+
+#ifdef NK_PSTR
+
+void _nk_set_isr_source(int src, int tid, void (*func)(void *data), void *data, const __flash char *name, const __flash char *by, const __flash char *comment);
+
+#define nk_set_isr_source(src, tid, func, data, comment) _nk_set_isr_source(src, tid, func, data, PSTR(#func), PSTR(__FILE__ ":" nk_tostring(__LINE__)), PSTR(comment))
+
+#else
+
+void _nk_set_isr_source(int src, int tid, void (*func)(void *data), void *data, const char *name, const char *by, const char *comment);
+
+#define nk_set_isr_source(src, tid, func, data, comment) _nk_set_isr_source(src, tid, func, data, #func, __FILE__ ":" nk_tostring(__LINE__), comment)
+
+#endif
+
+extern volatile unsigned char nk_isr_pending[NK_SCHED_ISR_SOURCES];
+extern volatile unsigned char nk_isr_any_pending;
+
+// Post interrupt source 'src'
+//
+// Single byte stores only, so this is safe even with nested interrupts
+
+static inline void nk_sched_from_isr(int src)
+{
+	nk_isr_pending[src] = 1;
+	nk_isr_any_pending = 1;
+}
+
+#endif
+
 // Reschedule an already submitted callback function.  Unlike submit, this does not
 // submit the callback if it does not already exist.
 //
@@ -78,6 +256,13 @@ int nk_check(int tid);
 
 void nk_sched_loop(void);
 
+// Idle function: called by the main loop whenever no task is due, before
+// it sleeps.  It should do a small piece of work and return nonzero if it
+// has more to do, so that tasks which become due in the meantime run first.
+// Return zero to let the main loop sleep.
+
+void nk_set_sched_idle(int (*func)(void));
+
 // Initialize scheduler
 
 void nk_init_sched(void);
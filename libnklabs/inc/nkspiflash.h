@@ -104,6 +104,20 @@ int nk_flash_busy_wait(const struct nk_spiflash_info *info);
 
 int nk_spiflash_erase(const struct nk_spiflash_info *info, uint32_t address, uint32_t byte_count);
 
+// Read status once: returns 1 if busy, 0 if not busy, -1 for error.
+
+int nk_spiflash_busy(const struct nk_spiflash_info *info);
+
+// Erase a region in the background.  Like nk_spiflash_erase(), but this
+// returns right away and the erase runs from the work queue as a coroutine.
+// It polls the status register between commands instead of spinning, so
+// other tasks keep running.  done(data, status) is called when it's finished,
+// status is 0 for success or -1 for error (including a command that took
+// longer than NK_SPIFLASH_ERASE_TIMEOUT ms).
+// Returns -1 if an erase is already in progress, otherwise 0.
+
+int nk_spiflash_erase_start(const struct nk_spiflash_info *info, uint32_t address, uint32_t byte_count, void (*done)(void *data, int status), void *data);
+
 // Write to flash. This handles any number for byte_count- it will break up the write
 // into multiple page writes as necessary.
 // Return 0 for success, -1 for error.
@@ -32,9 +32,19 @@ int nk_getc();
 // True if any input available
 int nk_kbhit();
 
-// Read data from UART
+// Read data from UART: spins until len characters have been read or no
+// character has arrived for timeout ms.  Returns number of characters read.
 int nk_uart_read(char *s, int len, uint32_t timeout);
 
+// Read data from UART without blocking: done(buf, n) is called from task tid
+// once len characters have been read, or once no character has arrived for
+// timeout_ms.  n is the number of characters read.  Only one read may be
+// outstanding: returns -1 if one already is, otherwise 0.
+int nk_uart_read_async(char *buf, int len, uint32_t timeout_ms, int tid, void (*done)(char *buf, int len));
+
+// Cancel outstanding nk_uart_read_async() without calling done
+void nk_uart_read_cancel();
+
 // Set task to trigger when characters are available
 void nk_set_uart_callback(int tid, void (*func)(void *data), void *data);
 
@@ -47,6 +57,21 @@ void nk_puts(const char *s);
 // Write data
 void nk_uart_write(const char *s, int len);
 
+// Wait until all buffered output has been sent
+void nk_uart_flush();
+
+// Receive statistics
+
+typedef struct {
+	uint16_t overrun; // Characters lost in the UART before we could read them
+	uint16_t framing; // Characters received with a framing error
+	uint16_t dropped; // Characters discarded because the Rx buffer was full
+	uint16_t high_water; // Most characters ever held in the Rx buffer
+} nk_uart_stats_t;
+
+// Get receive statistics, optionally clearing them
+void nk_uart_get_stats(nk_uart_stats_t *stats, int clear);
+
 extern nk_spinlock_t console_lock;
 
 int nk_set_uart_mode(int new_mode);
@@ -58,4 +83,70 @@ void nk_init_uart();
 int nk_get_uart_mode();
 int nk_set_uart_moed(int new_mode);
 
+// UART instances
+//
+// Drivers which support more than one UART define an nk_uart_t for each:
+// nk_uart0 is the console, which the functions above use.  Each instance
+// has its own buffers, callback and statistics.  The structure is private to
+// the driver.  Ports whose driver provides this API define NK_UART_INSTANCES
+// in their nkarch header.
+
+#ifdef NK_UART_INSTANCES
+
+typedef struct nk_uart nk_uart_t;
+
+extern nk_uart_t nk_uart0;
+#ifdef NK_UART1_RXBUF_SIZE
+extern nk_uart_t nk_uart1;
+#endif
+
+// Initialize UART
+void nk_uart_init(nk_uart_t *u);
+
+// Get character from input buffer or return -1 if none available
+int nk_uart_getc(nk_uart_t *u);
+
+// True if any input available
+int nk_uart_kbhit(nk_uart_t *u);
+
+// Read data, see nk_uart_read()
+int nk_uart_recv(nk_uart_t *u, char *s, int len, uint32_t timeout);
+
+// Set task to trigger when characters are available
+void nk_uart_set_callback(nk_uart_t *u, int tid, void (*func)(void *data), void *data);
+
+// Put character, convert \n to \r\n unless in tty mode
+void nk_uart_putc(nk_uart_t *u, char ch);
+
+// Write string
+void nk_uart_puts(nk_uart_t *u, const char *s);
+
+// Write data
+void nk_uart_send(nk_uart_t *u, const char *s, int len);
+
+// Wait until all buffered output has been sent
+void nk_uart_drain(nk_uart_t *u);
+
+// Get receive statistics, optionally clearing them
+void nk_uart_stats(nk_uart_t *u, nk_uart_stats_t *stats, int clear);
+
+// Set tty mode: 1 for binary, 0 to convert \n to \r\n.  Returns old mode.
+int nk_uart_set_mode(nk_uart_t *u, int new_mode);
+int nk_uart_get_mode(nk_uart_t *u);
+
+// Change baud rate once buffered output has been sent.  Returns -1 if the
+// rate is not supported or can't be generated accurately, otherwise 0.
+int nk_uart_set_baud(nk_uart_t *u, uint32_t baud);
+
+// Check whether nk_uart_set_baud() would accept a rate: -1 if not, otherwise 0
+int nk_uart_check_baud(nk_uart_t *u, uint32_t baud);
+
+// Get baud rate: zero if unknown
+uint32_t nk_uart_get_baud(nk_uart_t *u);
+
+// Call from the CTS pin change interrupt, with hardware flow control
+void nk_uart_cts_changed(nk_uart_t *u);
+
+#endif /* NK_UART_INSTANCES */
+
 #endif   /* _NKUART_H */
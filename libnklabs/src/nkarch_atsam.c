@@ -181,3 +181,10 @@ int nk_mcuflash_read(const void *info, uint32_t address, uint8_t *data, size_t b
 
 	return rtn;
 }
+
+const uint8_t *nk_mcuflash_map(const void *info, uint32_t address)
+{
+	(void)info;
+	// Flash is memory mapped
+	return (const uint8_t *)FLASH_ADDR + address;
+}
@@ -0,0 +1,170 @@
+// POSIX host port
+
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <errno.h>
+#include "nkarch.h"
+#include "nkmcuflash.h"
+
+// Scheduler timer
+
+static int wakeup_armed;
+static nk_time_t wakeup_when;
+
+// Convert delay in milliseconds to number of scheduler timer clock ticks
+nk_time_t nk_convert_delay(uint32_t delay)
+{
+	return delay * (NK_TIME_COUNTS_PER_SECOND / 1000);
+}
+
+void nk_init_sched_timer()
+{
+	// Nothing to do
+}
+
+void nk_sched_wakeup(nk_time_t when)
+{
+	wakeup_armed = 1;
+	wakeup_when = when;
+}
+
+// Get current time
+
+nk_time_t nk_get_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (nk_time_t)((uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U);
+}
+
+void nk_udelay(unsigned long usec)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)(usec / 1000000);
+	ts.tv_nsec = (long)(usec % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) && errno == EINTR);
+}
+
+// "Interrupts": file descriptors checked by nk_irq_unlock_and_wait()
+
+static struct pollfd irq_fds[NK_POSIX_MAX_FDS];
+static void (*irq_handlers[NK_POSIX_MAX_FDS])(void);
+static int irq_fd_count;
+
+int nk_posix_irq_fd(int fd, void (*handler)(void))
+{
+	if (irq_fd_count == NK_POSIX_MAX_FDS)
+		return -1;
+	irq_fds[irq_fd_count].fd = fd;
+	irq_fds[irq_fd_count].events = POLLIN;
+	irq_handlers[irq_fd_count] = handler;
+	++irq_fd_count;
+	return 0;
+}
+
+void nk_irq_unlock_and_wait(nk_spinlock_t *lock, nk_irq_flag_t flags, int deepness)
+{
+	int timeout = -1; // Nothing scheduled: wait for input
+	int x;
+
+	(void)deepness; // Always sleep: there is no power saving to trade off on a host
+
+	nk_irq_unlock(lock, flags);
+
+	if (wakeup_armed) {
+		int32_t delta = (int32_t)(wakeup_when - nk_get_time());
+		if (delta <= 0)
+			timeout = 0;
+		else
+			// Round up to whole milliseconds so we never wake up early
+			timeout = (int)((delta + 999) / 1000);
+	}
+	wakeup_armed = 0;
+
+	if (poll(irq_fds, (nfds_t)irq_fd_count, timeout) > 0) {
+		for (x = 0; x != irq_fd_count; ++x)
+			if (irq_fds[x].revents)
+				irq_handlers[x]();
+	}
+}
+
+// MCU flash simulated in RAM
+
+static uint8_t mcuflash[NK_MCUFLASH_SIZE];
+
+int nk_init_mcuflash()
+{
+	memset(mcuflash, 0xFF, sizeof(mcuflash));
+	return 0;
+}
+
+int nk_mcuflash_erase(const void *info, uint32_t address, uint32_t byte_count)
+{
+	(void)info;
+	if ((address & (NK_MCUFLASH_ERASE_SIZE - 1)) || (byte_count & (NK_MCUFLASH_ERASE_SIZE - 1)) ||
+	    address > NK_MCUFLASH_SIZE || byte_count > NK_MCUFLASH_SIZE - address)
+		return -1;
+	memset(mcuflash + address, 0xFF, byte_count);
+	return 0;
+}
+
+int nk_mcuflash_write(const void *info, uint32_t address, const uint8_t *data, size_t byte_count)
+{
+	size_t x;
+	(void)info;
+	if (address > NK_MCUFLASH_SIZE || byte_count > NK_MCUFLASH_SIZE - address)
+		return -1;
+	// Like real flash, writes can only clear bits
+	for (x = 0; x != byte_count; ++x)
+		mcuflash[address + x] &= data[x];
+	return 0;
+}
+
+int nk_mcuflash_read(const void *info, uint32_t address, uint8_t *data, size_t byte_count)
+{
+	(void)info;
+	if (address > NK_MCUFLASH_SIZE || byte_count > NK_MCUFLASH_SIZE - address)
+		return -1;
+	memcpy(data, mcuflash + address, byte_count);
+	return 0;
+}
+
+const uint8_t *nk_mcuflash_map(const void *info, uint32_t address)
+{
+	(void)info;
+	if (address > NK_MCUFLASH_SIZE)
+		return NULL;
+	return mcuflash + address;
+}
+
+void nk_reboot(void)
+{
+	// nk_init_uart() registered the terminal restore with atexit()
+	exit(0);
+}
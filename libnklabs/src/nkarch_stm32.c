@@ -291,6 +291,12 @@ int nk_mcuflash_read(const void *info, uint32_t address, uint8_t *data, size_t b
 	return 0;
 }
 
+const uint8_t *nk_mcuflash_map(const void *info, uint32_t address)
+{
+	(void)info;
+	return (const uint8_t *)(address + NK_FLASH_BASE_ADDRESS);
+}
+
 // Obtain the STM32 system reset cause
 reset_cause_t reset_cause_get(void)
 {
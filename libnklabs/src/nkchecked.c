@@ -30,6 +30,7 @@ int nk_checked_read_open(nk_checked_t *var_file, const nk_checked_base_t *file,
     uint32_t crc;
     uint32_t size;
     uint32_t addr;
+    const uint8_t *map;
     var_file->file = file;
     // Get header
     rtn = file->flash_read(file->info, file->area_base, buffer, sizeof(nk_checked_header_t));
@@ -45,6 +46,12 @@ int nk_checked_read_open(nk_checked_t *var_file, const nk_checked_base_t *file,
     // How about CRC?
     addr = sizeof(nk_checked_header_t) + file->area_base;
     crc = 0;
+    map = nk_checked_map(var_file);
+    if (map) {
+        // Memory mapped: check it in place
+        for (; size; --size)
+            crc = nk_crc32be_update(crc, *map++);
+    }
     while (size) {
         size_t x;
         size_t len;
@@ -67,6 +74,15 @@ int nk_checked_read_open(nk_checked_t *var_file, const nk_checked_base_t *file,
     return 0;
 }
 
+const uint8_t *nk_checked_map(nk_checked_t *var_file)
+{
+    const nk_checked_base_t *file = var_file->file;
+    if (file->flash_map)
+        return file->flash_map(file->info, file->area_base + sizeof(nk_checked_header_t));
+    else
+        return NULL;
+}
+
 // For nkinfile_t: read a block from the file
 size_t nk_checked_read(nk_checked_t *var_file, uint32_t offset, unsigned char *buffer, size_t buf_size)
 {
@@ -147,6 +163,50 @@ int nk_checked_write(nk_checked_t *var_file, const unsigned char *buffer, size_t
     return rtn;
 }
 
+// For nkoutfile_t: write segments to the file
+int nk_checked_writev(nk_checked_t *var_file, const struct nkoutfile_seg *seg, size_t nseg)
+{
+    int rtn = 0;
+    size_t granularity = var_file->file->granularity;
+    unsigned char part[NK_CHECKED_MAX_GRANULARITY]; // Write unit straddling segments
+    size_t part_len = 0;
+
+    if (granularity > sizeof(part))
+        return -1;
+
+    for (; nseg && !rtn; --nseg, ++seg) {
+        const unsigned char *buffer = seg->ptr;
+        size_t len = seg->len;
+        size_t n;
+        if (part_len) {
+            // Complete write unit started in previous segment
+            n = granularity - part_len;
+            if (n > len)
+                n = len;
+            memcpy(part + part_len, buffer, n);
+            part_len += n;
+            buffer += n;
+            len -= n;
+            if (part_len == granularity) {
+                rtn = nk_checked_write(var_file, part, part_len);
+                part_len = 0;
+            }
+        }
+        // Whole write units go directly from the segment
+        n = (len & ~(granularity - 1));
+        if (n && !rtn)
+            rtn = nk_checked_write(var_file, buffer, n);
+        // Save the rest for the next segment
+        memcpy(part + part_len, buffer + n, len - n);
+        part_len += len - n;
+    }
+
+    if (part_len && !rtn)
+        rtn = nk_checked_write(var_file, part, part_len);
+
+    return rtn;
+}
+
 // Close write file: write header
 int nk_checked_write_close(nk_checked_t *var_file)
 {
@@ -75,6 +75,31 @@ static struct console_cmd *find_cmd(const char *s)
     return 0;
 }
 
+// Dispatch to a subcommand
+
+int nk_subcmd(nkinfile_t *args, const NK_FLASH struct nk_subcmd *table, size_t count)
+{
+    char word[NK_MAX_SUBCMD_LEN + 2]; // Room to tell a too long word from a full length name
+    size_t x, y;
+    int rtn = NK_SUBCMD_SYNTAX;
+    if (nk_fscan(args, "%w %e", word, sizeof(word)) || (word[0] = 0, nk_fscan(args, ""))) {
+        for (x = 0; x != count; ++x) {
+            const NK_FLASH char *name = table[x].name;
+            for (y = 0; y != NK_MAX_SUBCMD_LEN && name[y] && name[y] == word[y]; ++y);
+            if ((y == NK_MAX_SUBCMD_LEN || !name[y]) && !word[y]) {
+                if (facmode || !table[x].hidden)
+                    rtn = table[x].func(args);
+                break;
+            }
+        }
+    }
+    if (rtn == NK_SUBCMD_SYNTAX) {
+        nk_printf("Syntax error\n");
+        rtn = 0;
+    }
+    return rtn;
+}
+
 // list_flag = 0: find next character to complete command, ' ' if command already complete, -1 if there are none or -2 multiple matches
 // list_flag = 1: show all possible completions
 
@@ -82,6 +82,11 @@ int nk_dbase_save(
 
     sta |= nk_dbase_serialize(f, dbase->ty, ram);
 
+    // Pad with spaces to the write granularity, so that nk_fflush does not
+    // pad with whatever is left in the buffer
+    while ((size_t)(f->ptr - f->start) & (ofilt.file->granularity - 1))
+        sta |= nk_fputc(f, ' ');
+
     sta |= nk_fflush(f);
 
     sta |= nk_checked_write_close(&ofilt);
@@ -105,6 +110,7 @@ int nk_dbase_save(
 int nk_dbase_load(const struct nk_dbase *dbase, char *rev, void *ram)
 {
     nkinfile_t f[1];
+    nkinfile_window_t window[1];
     nk_checked_t filt;
     int zero_good;
     char zero_rev;
@@ -136,20 +142,29 @@ int nk_dbase_load(const struct nk_dbase *dbase, char *rev, void *ram)
         nk_printf("Using bank 0\n");
         *rev = zero_rev;
         nk_checked_read_open(&filt, &dbase->bank0, dbase->buf, dbase->buf_size);
-        nkinfile_open(f, (size_t (*)(void *,size_t,unsigned char *,size_t))nk_checked_read, &filt, dbase->buf_size, dbase->buf);
     } else if (use_bank == 1) { 
         nk_printf("Using bank 1\n");
         *rev = one_rev;
         nk_checked_read_open(&filt, &dbase->bank1, dbase->buf, dbase->buf_size);
-        nkinfile_open(f, (size_t (*)(void *,size_t,unsigned char *,size_t))nk_checked_read, &filt, dbase->buf_size, dbase->buf);
     } else {
         nk_fprintf(nkstderr, "Neither bank is good!\n");
         return -1;
     }
+    if (nk_checked_map(&filt)) {
+        // Memory mapped flash: parse it in place
+        nkinfile_open_mem(f, nk_checked_map(&filt), filt.size);
+    } else {
+        // Parser may seek backwards a little: a window avoids reading blocks again
+        nkinfile_open_window(f, (size_t (*)(void *,size_t,unsigned char *,size_t))nk_checked_read, NULL, &filt, dbase->buf_size, dbase->buf,
+                             dbase->buf_blocks ? dbase->buf_blocks : 1, window);
+    }
     nk_fgetc(f);
 
-    if (nk_fscan(f, " %v", dbase->ty, ram)) {
+    if (nk_fscan(f, " %v ", dbase->ty, ram)) {
         nk_printf("Calibration store loaded OK\n");
+        if (dbase->verbose && f->window)
+            nk_printf("  blocks read = %lu, hits = %lu, re-reads = %lu\n", (unsigned long)window->reads,
+                      (unsigned long)window->hits, (unsigned long)window->rereads);
         return 0;
     } else {
         nk_fprintf(nkstderr, "CRC good, but calibration store failed to parse on load?\n");
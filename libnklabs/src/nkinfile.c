@@ -23,6 +23,100 @@
 #include "nkprintf.h"
 #include "nkinfile.h"
 
+// Block windows
+
+// Read a block into buffer x of the window, or with prefetch just start
+// reading it
+
+static void window_read(nkinfile_t *f, size_t x, size_t pos, int prefetch)
+{
+    nkinfile_window_t *w = f->window;
+    unsigned char *buf = w->buffer + x * f->block_size;
+    ++w->reads;
+    if (pos < w->read_end)
+        ++w->rereads;
+    else
+        w->read_end = pos + f->block_size;
+    w->pos[x] = pos;
+    if (prefetch)
+    {
+        w->block_prefetch(f->block_read_ptr, pos, buf, f->block_size);
+        w->len[x] = NKINFILE_PENDING;
+    }
+    else
+    {
+        w->len[x] = f->block_read(f->block_read_ptr, pos, buf, f->block_size);
+    }
+}
+
+// Wait for prefetch of buffer x to complete
+
+static void window_complete(nkinfile_t *f, size_t x)
+{
+    nkinfile_window_t *w = f->window;
+    if (w->len[x] == NKINFILE_PENDING)
+        w->len[x] = f->block_read(f->block_read_ptr, w->pos[x], w->buffer + x * f->block_size, f->block_size);
+}
+
+// Find buffer holding block at pos, or nblocks if there is none
+
+static size_t window_find(nkinfile_window_t *w, size_t pos)
+{
+    size_t x;
+    for (x = 0; x != w->nblocks; ++x)
+        if (w->pos[x] == pos)
+            break;
+    return x;
+}
+
+// Choose buffer to reuse: an empty one, otherwise the one with lowest file
+// offset, since we mostly read forward.  Never the one in use.
+
+static size_t window_victim(nkinfile_t *f, size_t keep)
+{
+    nkinfile_window_t *w = f->window;
+    size_t x, best = keep;
+    for (x = 0; x != w->nblocks; ++x)
+    {
+        if (x == keep)
+            continue;
+        if (w->pos[x] == NKINFILE_EMPTY)
+            return x;
+        if (best == keep || w->pos[x] < w->pos[best])
+            best = x;
+    }
+    window_complete(f, best);
+    return best;
+}
+
+// Make block at pos the current buffer
+
+static void window_seek(nkinfile_t *f, size_t pos)
+{
+    nkinfile_window_t *w = f->window;
+    size_t cur = (size_t)(f->start - w->buffer) / f->block_size;
+    size_t x = window_find(w, pos);
+    if (x == w->nblocks)
+    {
+        // Not in window: read it (buffer in use is reused only if there is just one)
+        x = window_victim(f, w->nblocks == 1 ? w->nblocks : cur);
+        window_read(f, x, pos, 0);
+    }
+    else if (x != cur)
+    {
+        ++w->hits;
+        window_complete(f, x);
+    }
+    f->start = w->buffer + x * f->block_size;
+    f->len = w->len[x];
+
+    // Start reading next block.  Only with three or more buffers: with two,
+    // the only spare one holds the block we just left, which the parser may
+    // still seek back into.
+    if (w->block_prefetch && w->nblocks > 2 && f->len == f->block_size && window_find(w, pos + f->block_size) == w->nblocks)
+        window_read(f, window_victim(f, x), pos + f->block_size, 1);
+}
+
 int nk_fseek_slow(nkinfile_t *f, size_t pos)
 {
     size_t offset;
@@ -38,7 +132,11 @@ int nk_fseek_slow(nkinfile_t *f, size_t pos)
     offset = (pos & (f->block_size - 1));
     f->start_offset = pos - offset;
 
-    if (f->block_read)
+    if (f->window)
+    {
+        window_seek(f, f->start_offset);
+    }
+    else if (f->block_read)
     {
         // Load block.  If end of file is within block, f->len will be less than block_size.
         // If end of file is exactly at start of block, then nothing is loaded and f->len is zero.
@@ -77,6 +175,7 @@ nkinfile_t *nkinfile_open(nkinfile_t *f, size_t (*block_read)(void *block_read_p
     f->block_read_ptr = block_read_ptr;
     f->block_read = block_read;
     f->block_size = block_size;
+    f->window = NULL;
     f->len = block_size;
 
     // Read first block into buffer
@@ -88,6 +187,39 @@ nkinfile_t *nkinfile_open(nkinfile_t *f, size_t (*block_read)(void *block_read_p
     return f;
 }
 
+nkinfile_t *nkinfile_open_window(nkinfile_t *f, size_t (*block_read)(void *block_read_ptr, size_t pos, unsigned char *buffer, size_t block_size), void (*block_prefetch)(void *block_read_ptr, size_t pos, unsigned char *buffer, size_t block_size), void *block_read_ptr, size_t block_size, unsigned char *buffer, size_t nblocks, nkinfile_window_t *window)
+{
+    size_t x;
+    if (nblocks > NKINFILE_WINDOW_MAX)
+        nblocks = NKINFILE_WINDOW_MAX;
+    window->buffer = buffer;
+    window->nblocks = nblocks;
+    window->block_prefetch = block_prefetch;
+    for (x = 0; x != nblocks; ++x)
+        window->pos[x] = NKINFILE_EMPTY;
+    window->reads = 0;
+    window->hits = 0;
+    window->rereads = 0;
+    window->read_end = 0;
+
+    f->buffer = buffer;
+    f->start = buffer;
+    f->start_offset = 0;
+    f->len = 0;
+
+    f->block_read_ptr = block_read_ptr;
+    f->block_read = block_read;
+    f->block_size = block_size;
+    f->window = window;
+
+    // Read first block into window
+    window_seek(f, 0);
+    f->ptr = f->start;
+    f->end = f->start + f->len;
+
+    return f;
+}
+
 nkinfile_t *nkinfile_open_mem(nkinfile_t *f, const unsigned char *mem, size_t size)
 {
     f->buffer = 0;
@@ -98,6 +230,7 @@ nkinfile_t *nkinfile_open_mem(nkinfile_t *f, const unsigned char *mem, size_t si
     f->block_read_ptr = NULL;
     f->block_read = NULL;
     f->block_size = 0;
+    f->window = NULL;
     f->len = size;
 
     f->end = f->start + f->len;
@@ -110,11 +243,18 @@ nkinfile_t *nkinfile_open_string(nkinfile_t *f, const char *s)
     return nkinfile_open_mem(f, (const unsigned char *)s, strlen(s));
 }
 
+// A span at a time: for a memory file (including mapped flash) this is a
+// single nk_fwrite
+
 int nk_fcopy(nkoutfile_t *g, nkinfile_t *f)
 {
     int status = 0;
     while (!nk_feof(f))
-        status |= nk_fputc(g, nk_fgetc(f));
+    {
+        const unsigned char *e = nk_fspan_end(f);
+        status |= nk_fwrite(g, f->ptr, (size_t)(e - f->ptr));
+        nk_fspan_next(f, e);
+    }
     return status;
 }
 
@@ -133,7 +273,8 @@ static nkinfile_t _nkinfile_null =
     .start_offset = 0,
     .block_read_ptr = 0,
     .block_read = 0,
-    .block_size = 0
+    .block_size = 0,
+    .window = 0
 };
 
 nkinfile_t *nkinfile_null = &_nkinfile_null;
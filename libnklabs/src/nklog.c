@@ -0,0 +1,188 @@
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Deferred logging
+
+#include <string.h>
+#include "nkcli.h"
+#include "nksched.h"
+#include "nklog.h"
+
+#ifndef NK_LOG_NOINIT
+#define NK_LOG_NOINIT
+#endif
+
+#define LOG_MAGIC 0x4E4B4C47UL
+
+// A record in the ring: header followed by len bytes of packed arguments
+
+struct log_hdr {
+	uint8_t len;
+	nk_time_t when;
+	const NK_FLASH char *fmt;
+};
+
+// Indices run freely: masked when the buffer is accessed
+
+static struct {
+	uint32_t magic; // LOG_MAGIC once initialized
+	uint16_t rd;
+	uint16_t wr;
+	uint16_t lost; // Records dropped because the buffer was full
+	unsigned char buf[NK_LOG_SIZE];
+} log_ring NK_LOG_NOINIT;
+
+static nk_spinlock_t log_lock = SPIN_LOCK_UNLOCKED;
+
+#define log_used() ((uint16_t)(log_ring.wr - log_ring.rd))
+
+// Copy in and out of the ring, wrapping as needed
+
+static void ring_put(const void *src, uint16_t len)
+{
+	const unsigned char *s = (const unsigned char *)src;
+	while (len--) {
+		log_ring.buf[log_ring.wr & (NK_LOG_SIZE - 1)] = *s++;
+		log_ring.wr = (uint16_t)(log_ring.wr + 1);
+	}
+}
+
+static void ring_get(void *dest, uint16_t len)
+{
+	unsigned char *d = (unsigned char *)dest;
+	while (len--) {
+		*d++ = log_ring.buf[log_ring.rd & (NK_LOG_SIZE - 1)];
+		log_ring.rd = (uint16_t)(log_ring.rd + 1);
+	}
+}
+
+void _nk_log(const NK_FLASH char *fmt, ...)
+{
+	struct log_hdr hdr;
+	unsigned char args[NK_LOG_ARGS_MAX];
+	nk_irq_flag_t irq_flag;
+	int len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = _nk_vpack_args(args, sizeof(args), fmt, ap);
+	va_end(ap);
+
+	hdr.when = nk_get_time();
+	hdr.fmt = fmt;
+
+	irq_flag = nk_irq_lock(&log_lock);
+	if (len < 0 || (size_t)(NK_LOG_SIZE - log_used()) < sizeof(hdr) + (size_t)len) {
+		++log_ring.lost;
+	} else {
+		hdr.len = (uint8_t)len;
+		ring_put(&hdr, sizeof(hdr));
+		ring_put(args, hdr.len);
+	}
+	nk_irq_unlock(&log_lock, irq_flag);
+}
+
+int nk_log_print(void)
+{
+	struct log_hdr hdr;
+	unsigned char args[NK_LOG_ARGS_MAX];
+	uint16_t lost;
+	nk_irq_flag_t irq_flag = nk_irq_lock(&log_lock);
+	if (log_ring.rd == log_ring.wr) {
+		// Report dropped records once the ones before them are out
+		lost = log_ring.lost;
+		log_ring.lost = 0;
+		nk_irq_unlock(&log_lock, irq_flag);
+		if (lost)
+			nk_printf("[log] %u records lost\n", (unsigned)lost);
+		return 0;
+	}
+	ring_get(&hdr, sizeof(hdr));
+	ring_get(args, hdr.len);
+	nk_irq_unlock(&log_lock, irq_flag);
+
+	nk_printf("[%lu] ", (unsigned long)hdr.when);
+#ifdef NKPRINTF_LOCK
+	NKPRINTF_LOCK
+#endif
+	_nk_vprintf_packed(nkstdout, hdr.fmt, args);
+#ifdef NKPRINTF_UNLOCK
+	NKPRINTF_UNLOCK
+#endif
+	return 1;
+}
+
+void nk_log_dump(void)
+{
+	while (nk_log_print());
+}
+
+// Idle function: one record at a time, so that tasks which become ready run
+// first
+
+static int log_idle(void)
+{
+	return nk_log_print();
+}
+
+void nk_init_log(void)
+{
+	uint16_t rd = log_ring.rd;
+	// Check that a buffer which survived a reset is intact
+	if (log_ring.magic == LOG_MAGIC) {
+		while (rd != log_ring.wr && (uint16_t)(log_ring.wr - rd) <= NK_LOG_SIZE) {
+			if (log_ring.buf[rd & (NK_LOG_SIZE - 1)] > NK_LOG_ARGS_MAX)
+				break;
+			rd = (uint16_t)(rd + sizeof(struct log_hdr) + log_ring.buf[rd & (NK_LOG_SIZE - 1)]);
+		}
+	}
+	if (log_ring.magic != LOG_MAGIC || rd != log_ring.wr) {
+		log_ring.rd = log_ring.wr = log_ring.lost = 0;
+		log_ring.magic = LOG_MAGIC;
+	} else if (log_ring.rd != log_ring.wr) {
+		nk_startup_message("Log has %u bytes from before reset\n", (unsigned)log_used());
+	}
+	nk_set_sched_idle(log_idle);
+}
+
+static int cmd_log(nkinfile_t *args)
+{
+	nk_irq_flag_t irq_flag;
+	uint16_t used, lost;
+	if (nk_fscan(args, "")) {
+		irq_flag = nk_irq_lock(&log_lock);
+		used = log_used();
+		lost = log_ring.lost;
+		nk_irq_unlock(&log_lock, irq_flag);
+		nk_printf("Log buffer: %u of %u bytes waiting, %u records lost\n", (unsigned)used, (unsigned)NK_LOG_SIZE, (unsigned)lost);
+	} else if (nk_fscan(args, "test ")) {
+		nk_log("Log test: time %lu\n", (unsigned long)nk_get_time());
+	} else {
+		nk_printf("Syntax error\n");
+	}
+	return 0;
+}
+
+COMMAND(cmd_log,
+	">log                       Deferred log\n"
+	"-log                       Show log buffer use\n"
+	"-log test                  Log a test record\n"
+)
@@ -36,8 +36,17 @@ static void flash_hex_dump(uint32_t addr, uint32_t len)
         if (this_len > len)
             this_len = (size_t)len;
 
-        nk_mcuflash_read(NULL, this_page + this_ofst, buf + this_ofst, this_len);
-        nk_byte_hex_dump(buf, this_page, this_ofst, this_len);
+        const uint8_t *map = nk_mcuflash_map(NULL, this_page);
+        if (map)
+        {
+            // Dump it in place
+            nk_byte_hex_dump((unsigned char *)map, this_page, this_ofst, this_len);
+        }
+        else
+        {
+            nk_mcuflash_read(NULL, this_page + this_ofst, buf + this_ofst, this_len);
+            nk_byte_hex_dump(buf, this_page, this_ofst, this_len);
+        }
 
         addr += this_len;
         len -= this_len;
@@ -49,16 +58,20 @@ static uint32_t flash_crc(uint32_t addr, uint32_t len)
     unsigned char buf[256];
     uint32_t x, crc = 0;
     while(len) {
-        uint32_t this_page = (addr & ~255U);
         uint32_t this_ofst = (addr & 255U);
         size_t this_len = (size_t)(256U - this_ofst);
         if (this_len > len)
             this_len = (size_t)len;
 
-        nk_mcuflash_read(NULL, this_page, buf, this_len);
+        const uint8_t *map = nk_mcuflash_map(NULL, addr);
+        if (!map)
+        {
+            nk_mcuflash_read(NULL, addr, buf, this_len);
+            map = buf;
+        }
 
         for (x = 0; x != this_len; ++x)
-            crc = nk_crc32be_update(crc, buf[x]);
+            crc = nk_crc32be_update(crc, map[x]);
 
         addr += this_len;
         len -= this_len;
@@ -66,35 +79,65 @@ static uint32_t flash_crc(uint32_t addr, uint32_t len)
     return crc;
 }
 
-static int cmd_mcuflash(nkinfile_t *args)
+static int mcuflash_rd(nkinfile_t *args)
 {
-    int status = 0;
     uint32_t addr;
-    uint32_t len;
     uint64_t val;
-    uint8_t val8;
-    if (facmode && nk_fscan(args, "rd %"PRIx32" ", &addr)) {
-        nk_mcuflash_read(NULL, addr, (uint8_t *)&val, 8);
-        nk_printf("[%"PRIx32"] has %"PRIx64"\n", addr, val);
-    } else if (facmode && nk_fscan(args, "wr %"PRIx32" %"PRIx64" ", &addr, &val)) {
-        nk_mcuflash_write(NULL, addr, (uint8_t *)&val, 8);
-        nk_printf("Wrote %"PRIx64" to [%"PRIx32"]\n", val, addr);
-    } else if (facmode && nk_fscan(args, "hd %"PRIx32" %"PRIx32" ", &old_mcuflash_addr, &len)) {
+    if (!nk_fscan(args, "%"PRIx32" ", &addr))
+        return NK_SUBCMD_SYNTAX;
+    nk_mcuflash_read(NULL, addr, (uint8_t *)&val, 8);
+    nk_printf("[%"PRIx32"] has %"PRIx64"\n", addr, val);
+    return 0;
+}
+
+static int mcuflash_wr(nkinfile_t *args)
+{
+    uint32_t addr;
+    uint64_t val;
+    if (!nk_fscan(args, "%"PRIx32" %"PRIx64" ", &addr, &val))
+        return NK_SUBCMD_SYNTAX;
+    nk_mcuflash_write(NULL, addr, (uint8_t *)&val, 8);
+    nk_printf("Wrote %"PRIx64" to [%"PRIx32"]\n", val, addr);
+    return 0;
+}
+
+static int mcuflash_hd(nkinfile_t *args)
+{
+    uint32_t len;
+    if (nk_fscan(args, "%"PRIx32" %"PRIx32" ", &old_mcuflash_addr, &len)) {
         flash_hex_dump(old_mcuflash_addr, len);
 	old_mcuflash_addr += len;
-    } else if (facmode && nk_fscan(args, "hd %"PRIx32" ", &old_mcuflash_addr)) {
+    } else if (nk_fscan(args, "%"PRIx32" ", &old_mcuflash_addr)) {
     	len = 0x100;
         flash_hex_dump(old_mcuflash_addr, len);
 	old_mcuflash_addr += len;
-    } else if (facmode && nk_fscan(args, "crc %"PRIx32" %"PRIu32" ", &addr, &len)) {
-        nk_printf("Calculate CRC of %"PRIx32" - %"PRIx32"\n", addr, addr + len);
-        addr = flash_crc(addr, len);
-        nk_printf("CRC is %"PRIx32"\n", addr);
-    } else if (facmode && nk_fscan(args, "erase %"PRIx32" %"PRIx32" ", &addr, &len)) {
+    } else {
+        return NK_SUBCMD_SYNTAX;
+    }
+    return 0;
+}
+
+static int mcuflash_crc(nkinfile_t *args)
+{
+    uint32_t addr;
+    uint32_t len;
+    if (!nk_fscan(args, "%"PRIx32" %"PRIu32" ", &addr, &len))
+        return NK_SUBCMD_SYNTAX;
+    nk_printf("Calculate CRC of %"PRIx32" - %"PRIx32"\n", addr, addr + len);
+    addr = flash_crc(addr, len);
+    nk_printf("CRC is %"PRIx32"\n", addr);
+    return 0;
+}
+
+static int mcuflash_erase(nkinfile_t *args)
+{
+    uint32_t addr;
+    uint32_t len;
+    if (nk_fscan(args, "%"PRIx32" %"PRIx32" ", &addr, &len)) {
     	nk_printf("Erasing %"PRIu32" bytes...\n", len);
         nk_mcuflash_erase(NULL, addr, len);
         nk_printf("done.\n");
-    } else if (facmode && nk_fscan(args, "erase %"PRIx32" ", &addr)) {
+    } else if (nk_fscan(args, "%"PRIx32" ", &addr)) {
 #ifdef FLASH_PAGE_SIZE
     	len = FLASH_PAGE_SIZE;
     	nk_printf("Erasing %"PRIu32" bytes...\n", len);
@@ -103,7 +146,19 @@ static int cmd_mcuflash(nkinfile_t *args)
 #else
         nk_printf("Ooops.\n");
 #endif
-    } else if (facmode && nk_fscan(args, "fill %"PRIx32" %"PRIx32" ", &addr, &len)) {
+    } else {
+        return NK_SUBCMD_SYNTAX;
+    }
+    return 0;
+}
+
+static int mcuflash_fill(nkinfile_t *args)
+{
+    int status = 0;
+    uint32_t addr;
+    uint32_t len;
+    uint8_t val8;
+    if (nk_fscan(args, "%"PRIx32" %"PRIx32" ", &addr, &len)) {
     	uint8_t buf[16];
     	uint8_t x = 0x10;
         nk_printf("Writing %"PRIu32" bytes...\n", len);
@@ -124,7 +179,7 @@ static int cmd_mcuflash(nkinfile_t *args)
 		addr += th;
     	}
         nk_printf("done.\n");
-    } else if (facmode && nk_fscan(args, "fill %"PRIx32" %"PRIx32" %"PRIx8" ", &addr, &len, &val8)) {
+    } else if (nk_fscan(args, "%"PRIx32" %"PRIx32" %"PRIx8" ", &addr, &len, &val8)) {
     	uint8_t buf[16];
     	memset(buf, val8, sizeof(buf));
         nk_printf("Writing %"PRIu32" bytes...\n", len);
@@ -143,13 +198,27 @@ static int cmd_mcuflash(nkinfile_t *args)
     	}
         nk_printf("done.\n");
     } else {
-        nk_printf("Syntax error\n");
+        return NK_SUBCMD_SYNTAX;
     }
     if (status)
     	nk_printf("Flash error\n");
     return 0;
 }
 
+NK_SUBCMDS(mcuflash_subcmds) {
+    NK_SUBCMD_HIDDEN("rd", mcuflash_rd),
+    NK_SUBCMD_HIDDEN("wr", mcuflash_wr),
+    NK_SUBCMD_HIDDEN("hd", mcuflash_hd),
+    NK_SUBCMD_HIDDEN("crc", mcuflash_crc),
+    NK_SUBCMD_HIDDEN("erase", mcuflash_erase),
+    NK_SUBCMD_HIDDEN("fill", mcuflash_fill),
+};
+
+static int cmd_mcuflash(nkinfile_t *args)
+{
+    return NK_SUBCMD_DISPATCH(args, mcuflash_subcmds);
+}
+
 COMMAND(cmd_mcuflash,
     ">mcuflash                  Read/write flash memory\n"
     "-mcuflash rd <addr>        Read word\n"
@@ -21,6 +21,7 @@
 // OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <string.h>
 #include "nkoutfile.h"
 
 nkoutfile_t *nkoutfile_open(
@@ -41,25 +42,58 @@ nkoutfile_t *nkoutfile_open(
     f->block_write_ptr = block_write_ptr;
     f->block_write = block_write;
     f->granularity = granularity;
+    f->block_writev = NULL;
     return f;
 }
 
-int nk_fflush(nkoutfile_t *f)
+nkoutfile_t *nkoutfile_open_writev(
+    nkoutfile_t *f,
+    int (*block_writev)(
+        void *block_write_ptr,
+        const struct nkoutfile_seg *seg,
+        size_t nseg
+    ),
+    void *block_write_ptr,
+    unsigned char *buffer,
+    size_t len,
+    size_t granularity
+) {
+    nkoutfile_open(f, NULL, block_write_ptr, buffer, len, granularity);
+    f->block_writev = block_writev;
+    return f;
+}
+
+// Write one block with whichever write function we have
+
+static int write_block(nkoutfile_t *f, const unsigned char *buf, size_t len)
 {
-    int rtn;
-    size_t len = (size_t)(f->ptr - f->start);
-    f->ptr = f->start;
-    // Round write up to granularity
-    len = ((len + (f->granularity - 1)) & ~(f->granularity - 1));
-    if (f->block_write)
+    if (f->block_writev)
     {
-        rtn = f->block_write(f->block_write_ptr, f->start, len);
+        struct nkoutfile_seg seg;
+        seg.ptr = buf;
+        seg.len = len;
+        return f->block_writev(f->block_write_ptr, &seg, 1);
+    }
+    else if (f->block_write)
+    {
+        // block_write does not modify the data it is given
+        return f->block_write(f->block_write_ptr, (unsigned char *)buf, len);
     }
     else
     {
         // No flush function
-        rtn = -1;
+        return -1;
     }
+}
+
+int nk_fflush(nkoutfile_t *f)
+{
+    int rtn;
+    size_t len = (size_t)(f->ptr - f->start);
+    f->ptr = f->start;
+    // Round write up to granularity
+    len = ((len + (f->granularity - 1)) & ~(f->granularity - 1));
+    rtn = write_block(f, f->start, len);
     if (!rtn)
     {
         // Flush was successful, reset buffer
@@ -68,6 +102,58 @@ int nk_fflush(nkoutfile_t *f)
     return rtn;
 }
 
+int nk_fwrite(nkoutfile_t *f, const unsigned char *buf, size_t len)
+{
+    int rtn = 0;
+    while (len && !rtn)
+    {
+        size_t n;
+        size_t buffered = (size_t)(f->ptr - f->start);
+        // Amount we could write directly: buffered data plus caller's data,
+        // rounded down to granularity
+        size_t total = ((buffered + len) & ~(f->granularity - 1));
+        if (buffered + len >= f->size && total > buffered && (f->block_writev || (!buffered && f->block_write)))
+        {
+            n = total - buffered;
+            if (buffered)
+            {
+                // Write buffer and caller's data together
+                struct nkoutfile_seg seg[2];
+                seg[0].ptr = f->start;
+                seg[0].len = buffered;
+                seg[1].ptr = buf;
+                seg[1].len = n;
+                rtn = f->block_writev(f->block_write_ptr, seg, 2);
+                if (!rtn)
+                    f->ptr = f->start;
+            }
+            else
+            {
+                // Nothing buffered: write straight from caller's data
+                rtn = write_block(f, buf, n);
+            }
+        }
+        else if (f->ptr != f->end)
+        {
+            // Copy as much as fits into buffer
+            n = (size_t)(f->end - f->ptr);
+            if (n > len)
+                n = len;
+            memcpy(f->ptr, buf, n);
+            f->ptr += n;
+        }
+        else
+        {
+            // Buffer is full, or there is none
+            n = 1;
+            rtn = _nk_flush_and_putc(f, *buf);
+        }
+        buf += n;
+        len -= n;
+    }
+    return rtn;
+}
+
 nkoutfile_t *nkoutfile_open_mem(nkoutfile_t *f, char *mem, size_t size)
 {
     // We have a buffer, but not output function
@@ -89,12 +175,12 @@ int _nk_flush_and_putc(nkoutfile_t *f, int c)
         }
         return rtn;
     }
-    else if (f->block_write)
+    else if (f->block_write || f->block_writev)
     {
         unsigned char d = (unsigned char)c;
         // Special case: no buffering, just call output function directly
         // If granularity is not 1, we write junk after &c on the stack
-        return f->block_write(f->block_write_ptr, &d, f->granularity);
+        return write_block(f, &d, f->granularity);
     }
     else
     {
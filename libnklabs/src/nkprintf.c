@@ -92,7 +92,131 @@ int nk_byte_hex_dump(unsigned char *buf, unsigned long base, unsigned long offse
 
 // Small printf()
 
-int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
+// Integer conversion
+//
+// Division is slow on small MCUs (AVR has no divide instruction at all), and
+// 64-bit division is a long software routine even on 32-bit ones.  So
+// numbers are converted two digits per division using a table, the
+// divisions by 100 are done by multiplication, and 64 or 32-bit arithmetic
+// is only used while the value is too big for a narrower type.
+
+static const NK_FLASH char dec_pairs[] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const NK_FLASH char hex_digits[] = "0123456789abcdef0123456789ABCDEF";
+
+// x / 100 for x < 43699
+
+#define DIV100(x) ((uint16_t)(((uint32_t)(x) * 5243U) >> 19))
+
+// Append two digits of x (< 100), least significant first
+
+#define PUT_PAIR(p, x) do { \
+		(p)[0] = dec_pairs[(x) * 2 + 1]; \
+		(p)[1] = dec_pairs[(x) * 2]; \
+		(p) += 2; \
+	} while (0)
+
+// Append exactly four digits of x (< 10000), least significant first
+
+static char *dec4(char *p, uint16_t x)
+{
+	uint16_t hi = DIV100(x);
+	uint16_t lo = (uint16_t)(x - hi * 100);
+	PUT_PAIR(p, lo);
+	PUT_PAIR(p, hi);
+	return p;
+}
+
+// Convert to decimal in buf, least significant digit first.  Returns the
+// number of digits: none for zero.
+
+static size_t dec_rev(char *buf, unsigned long long val)
+{
+	char *p = buf;
+	uint32_t v32;
+	uint16_t v;
+	// 64-bit division only while needed, for 8 digits at a time
+	while (val >> 32) {
+		unsigned long long q = val / 100000000U;
+		uint32_t r = (uint32_t)(val - q * 100000000U);
+		uint16_t hi = (uint16_t)(r / 10000);
+		p = dec4(p, (uint16_t)(r - hi * 10000UL));
+		p = dec4(p, hi);
+		val = q;
+	}
+	// Then 32-bit division, for 4 digits at a time
+	v32 = (uint32_t)val;
+	while (v32 >> 16) {
+		uint32_t q = v32 / 10000;
+		p = dec4(p, (uint16_t)(v32 - q * 10000));
+		v32 = q;
+	}
+	v = (uint16_t)v32;
+	if (v >= 10000) {
+		// Five digits: DIV100 doesn't reach, take off the top one
+		char top = '0';
+		do {
+			v = (uint16_t)(v - 10000);
+			++top;
+		} while (v >= 10000);
+		p = dec4(p, v);
+		*p++ = top;
+	} else {
+		while (v >= 100) {
+			uint16_t q = DIV100(v);
+			uint16_t d = (uint16_t)(v - q * 100);
+			PUT_PAIR(p, d);
+			v = q;
+		}
+		if (v >= 10)
+			PUT_PAIR(p, v);
+		else if (v)
+			*p++ = (char)('0' + v);
+	}
+	return (size_t)(p - buf);
+}
+
+// Convert to hex in buf, least significant digit first.  Returns the number
+// of digits: none for zero.
+
+static size_t hex_rev(char *buf, unsigned long long val, int upr)
+{
+	char *p = buf;
+	const NK_FLASH char *digits = hex_digits + (upr ? 16 : 0);
+	uint32_t v;
+	if (val >> 32) {
+		int n;
+		v = (uint32_t)val;
+		for (n = 0; n != 8; ++n) {
+			*p++ = digits[v & 0xF];
+			v >>= 4;
+		}
+		val >>= 32;
+	}
+	for (v = (uint32_t)val; v; v >>= 4)
+		*p++ = digits[v & 0xF];
+	return (size_t)(p - buf);
+}
+
+// Arguments come from a va_list, or from a buffer filled in by
+// _nk_vpack_args(): each argument packed after the previous one as its
+// promoted type
+
+struct printf_args {
+	va_list ap;
+	const unsigned char *packed; // NULL for va_list
+};
+
+#define NEXT_ARG(type) (args->packed ? \
+	({ type _v; memcpy(&_v, args->packed, sizeof(type)); args->packed += sizeof(type); _v; }) : \
+	va_arg(args->ap, type))
+
+static int vprintf_args(nkoutfile_t *f, const NK_FLASH char *fmt, struct printf_args *args)
 {
 	int status = 0;
 
@@ -140,7 +264,7 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 			// Width
 			if (*fmt == '*') {
 				++fmt;
-				width = (size_t)(int)va_arg(ap, int);
+				width = (size_t)(int)NEXT_ARG(int);
 			} else {
 				while (*fmt >= '0' && *fmt <= '9') {
 					width = width * 10 + *fmt++ - '0';
@@ -152,7 +276,7 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 				// Precision
 				if (*fmt == '*') {
 					++fmt;
-					prec = (size_t)(int)va_arg(ap, int);
+					prec = (size_t)(int)NEXT_ARG(int);
 				} else {
 					while (*fmt >= '0' && *fmt <= '9') {
 						prec = prec * 10 + *fmt++ - '0';
@@ -175,23 +299,27 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 			switch (c = *fmt++) {
 #ifndef NKPRINTF_NOFLOAT
 				case 'A': case 'a':
-				case 'G': case 'F': case 'E':
-				case 'g': case 'f': case 'e': { // Floating point
-					double fp = (double)va_arg(ap, double);
+				case 'G': case 'F': case 'E': case 'R':
+				case 'g': case 'f': case 'e': case 'r': { // Floating point
+					double fp = (double)NEXT_ARG(double);
 					int formatted_len = sizeof(buf); // Buffer size on input, printed length on output (or -1 for error)
 					int fp_flags = 0;
+					char *pfx;
 					if (plus) fp_flags |= FLplus;
 					if (pound) fp_flags |= FLhash;
 					if (space) fp_flags |= FLspc;
-					char *pfx = __floatfmt(
-						c,
-						fp_flags,
-						prec,
-						&fp,
-						buf,
-						&formatted_len,
-						width
-					);
+					if ((c | 0x20) == 'r') // Shortest round trip, %hr for float
+						pfx = __floatshort(c, fp_flags, &fp, buf, &formatted_len, size < 0);
+					else
+						pfx = __floatfmt(
+							c,
+							fp_flags,
+							prec,
+							&fp,
+							buf,
+							&formatted_len,
+							width
+						);
 					if (formatted_len < 0) {
 						status |= nk_fputc(f, '!');
 					} else {
@@ -205,7 +333,7 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 				}
 #endif
 				case 'c': { // Character
-					buf[0] = (char)va_arg(ap, int);
+					buf[0] = (char)NEXT_ARG(int);
 					s = buf;
 					len = 1;
 					goto emits;
@@ -303,40 +431,37 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 					break;
 				} case 'i': case 'd': { // Signed decimal
 					if (size == 1)
-						val = (unsigned long long)(long long)va_arg(ap, long);
+						val = (unsigned long long)(long long)NEXT_ARG(long);
 					else if (size == 2)
-						val = (unsigned long long)(long long)va_arg(ap, long long);
+						val = (unsigned long long)(long long)NEXT_ARG(long long);
 					else if (size == 3)
-						val = (unsigned long long)(long long)va_arg(ap, size_t);
+						val = (unsigned long long)(long long)NEXT_ARG(size_t);
 					else if (size == 4)
-						val = (unsigned long long)(long long)va_arg(ap, ptrdiff_t);
+						val = (unsigned long long)(long long)NEXT_ARG(ptrdiff_t);
 					else
-						val = (unsigned long long)(long long)va_arg(ap, int);
+						val = (unsigned long long)(long long)NEXT_ARG(int);
 					if ((long long)val < 0) {
 						neg = 1;
 						val = -val;
 					}
 					dec:
-					// Convert decimal to string
-					for (len = 0; val; val /= 10, ++len) {
-						buf[len] = (char)('0' + (val % 10));
-					}
+					len = dec_rev(buf, val);
 					s = buf;
 					goto rev;
 					break;
 				} case 'u': case 'x': case 'X': case 'p': { // Unsigned decimal or hex
 					if (c == 'p') // Pointer
-						val = (uintptr_t)va_arg(ap, void *);
+						val = (uintptr_t)NEXT_ARG(void *);
 					else if (size == 1)
-						val = va_arg(ap, unsigned long);
+						val = NEXT_ARG(unsigned long);
 					else if (size == 2)
-						val = va_arg(ap, unsigned long long);
+						val = NEXT_ARG(unsigned long long);
 					else if (size == 3)
-						val = va_arg(ap, size_t);
+						val = NEXT_ARG(size_t);
 					else if (size == 4)
-						val = (unsigned long long)va_arg(ap, ptrdiff_t);
+						val = (unsigned long long)NEXT_ARG(ptrdiff_t);
 					else
-						val = va_arg(ap, unsigned int);
+						val = NEXT_ARG(unsigned int);
 					if (c == 'x' || c == 'p') {
 						hex = 1;
 					} else if (c == 'X') {
@@ -345,26 +470,17 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 					}
 					if (!hex)
 						goto dec;
-					// Convert hex to string
-					for (len = 0; val; val >>= 4, ++len) {
-						int v = (val & 0xF);
-						if (v < 10)
-							buf[len] = (char)('0' + v);
-						else if (upr)
-							buf[len] = (char)('A' + v - 10);
-						else
-							buf[len] = (char)('a' + v - 10);
-					}
+					len = hex_rev(buf, val, upr);
 					goto rev;
 					break;
 				} case 's': { // String
-					s = va_arg(ap, char *);
+					s = NEXT_ARG(char *);
 					len = strlen(s);
 					goto emits;
 					break;
 #ifdef NK_PSTR
 				} case 'S': { // AVR String located in flash memory
-					const NK_FLASH char *S = va_arg(ap, char *);
+					const NK_FLASH char *S = NEXT_ARG(char *);
 					len = strlen_P(S);
 					if (minus) { // Left justify
 						/* Emit string */
@@ -410,6 +526,119 @@ int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
 	return status;
 }
 
+int _nk_vprintf(nkoutfile_t *f, const NK_FLASH char *fmt, va_list ap)
+{
+	int status;
+	struct printf_args args;
+	va_copy(args.ap, ap);
+	args.packed = NULL;
+	status = vprintf_args(f, fmt, &args);
+	va_end(args.ap);
+	return status;
+}
+
+int _nk_vprintf_packed(nkoutfile_t *f, const NK_FLASH char *fmt, const void *packed)
+{
+	struct printf_args args;
+	args.packed = (const unsigned char *)packed;
+	return vprintf_args(f, fmt, &args);
+}
+
+// Pack arguments for _nk_vprintf_packed(): this has to consume them exactly
+// as vprintf_args() does
+
+#define PACK_ARG(type) do { \
+		type _v = va_arg(ap, type); \
+		if ((size_t)(end - p) < sizeof(type)) \
+			return -1; \
+		memcpy(p, &_v, sizeof(type)); \
+		p += sizeof(type); \
+	} while (0)
+
+int _nk_vpack_args(void *buf, size_t len, const NK_FLASH char *fmt, va_list ap)
+{
+	unsigned char *p = (unsigned char *)buf;
+	unsigned char *end = p + len;
+	while (*fmt) {
+		int size = 0;
+		if (*fmt++ != '%')
+			continue;
+		// Flags
+		while (*fmt == '-' || *fmt == '+' || *fmt == ' ' || *fmt == '#' || *fmt == '0' || *fmt == '_' || *fmt == ',')
+			++fmt;
+		// Width
+		if (*fmt == '*') {
+			++fmt;
+			PACK_ARG(int);
+		} else {
+			while (*fmt >= '0' && *fmt <= '9')
+				++fmt;
+		}
+		// Precision
+		if (*fmt == '.') {
+			++fmt;
+			if (*fmt == '*') {
+				++fmt;
+				PACK_ARG(int);
+			} else {
+				while (*fmt >= '0' && *fmt <= '9')
+					++fmt;
+			}
+		}
+		// Size
+		for (;; ++fmt) {
+			char c = *fmt;
+			if (c == 'z')
+				size = 3;
+			else if (c == 't')
+				size = 4;
+			else if (c == 'l')
+				++size;
+			else if (c == 'h')
+				--size;
+			else if (c != 'L')
+				break;
+		}
+		switch (*fmt++) {
+#ifndef NKPRINTF_NOFLOAT
+			case 'A': case 'a':
+			case 'G': case 'F': case 'E': case 'R':
+			case 'g': case 'f': case 'e': case 'r':
+				PACK_ARG(double);
+				break;
+#endif
+			case 'c':
+				PACK_ARG(int);
+				break;
+			case 'i': case 'd': case 'u': case 'x': case 'X':
+				if (size == 1)
+					PACK_ARG(long);
+				else if (size == 2)
+					PACK_ARG(long long);
+				else if (size == 3)
+					PACK_ARG(size_t);
+				else if (size == 4)
+					PACK_ARG(ptrdiff_t);
+				else
+					PACK_ARG(int);
+				break;
+			case 'p':
+				PACK_ARG(void *);
+				break;
+			case 's':
+#ifdef NK_PSTR
+			case 'S':
+#endif
+				PACK_ARG(char *);
+				break;
+			case 0:
+				--fmt;
+				break;
+		}
+	}
+	return (int)(p - (unsigned char *)buf);
+}
+
 // Print to string, NUL always written
 
 int _nk_snprintf(char *dest, size_t len, const NK_FLASH char *fmt, ...)
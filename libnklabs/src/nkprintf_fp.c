@@ -1,13 +1,13 @@
-// This is the floating point formatter extracted from Walter Bright's
-// Zortech-C compiler (now called "Digital Mars C").  We use this because
-// it is much smaller than the newlib one.
-
-//_ fmt.c
-// Copyright (C) 1986-2009 by Digital Mars
-// All Rights Reserved
-// http://www.digitalmars.com
-
-/*
+// This is the floating point formatter extracted from Walter Bright's
+// Zortech-C compiler (now called "Digital Mars C").  We use this because
+// it is much smaller than the newlib one.
+
+//_ fmt.c
+// Copyright (C) 1986-2009 by Digital Mars
+// All Rights Reserved
+// http://www.digitalmars.com
+
+/*
 All the files in this package that are copyrighted by:
 
     Walter Bright
@@ -43,473 +43,949 @@ SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
 FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
 ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
-*/
-
-#include <math.h>
-#include <string.h>
-
-#include "nkstring.h"
-#include "nkprintf_fp.h"
-#include "nkdectab.h"
-
-#define LDBL_DIG 18
-
-#define DIGMAX	(LDBL_DIG*2)	/* max # of digits in string		*/
-				/* (*2 is a good fudge factor)		*/
-
-#define ECVT	0
-#define FCVT	1
-
-/********************* printf interface ********************/
-
-char *__floatcvt(int cnvflag, char *digstr, double val, int ndig, int *pdecpt, int *psign);
-static void __doexponent(char **ps, int exp, int flag);
-static char *__trim0(char *s);
-
-char *__dosign(int sign, int flags)
-{
-	return	(sign)		 ? "-" :
-		(flags & FLplus) ? "+" :
-		(flags & FLspc)	 ? " " :
-				   "";
-}
-
-/***********************************
- * Do floating point formatting.
- */
-
-char  *__floatfmt(int c, int flags, int precision, double *pdval, char *buf, int *psl, int width)
-{
-    char *p;
-    int fpd;			/* classification of double value	*/
-    int decpt;			/* exponent (base 10) for floats	*/
-    int sign;
-    char  *prefix;
-    int sl;			/* length of formatted string s		*/
-    char digstr[LDBL_DIG*2 + 2];
-    char *sbuf;
-    double dval;
-    int bufmax = *psl;
-
-    if (!(flags & FLprec))	/* if no precision	*/
-	precision = 6;		/* default precision	*/
-
-    dval = *pdval;
-    fpd = fpclassify(dval);
-    if (fpd <= FP_INFINITE)	/* if nan or infinity	*/
-    {
-	static char fptab[][5] =
-	{ "nans","nan","inf" };
-	static char fptablen[] = { 4,3,3 };
-
-	/* '#' and '0' flags have no effect	*/
-	flags &= ~(FL0pad | FLhash);
-	prefix = __dosign(signbit(dval),flags);
-
-	*(unsigned long *)buf = *(unsigned long *)fptab[fpd];
-	if (!(c & 0x20))	/* if c is upper case	*/
-	    /* Convert to upper case */
-	    *(unsigned long *)buf &= ~0x20202020;
-	sl = fptablen[fpd];	/* length of string	*/
-    }
-    else
-    {
-	switch (c)
-	{
-	    case 'f':
-	    case 'F':
-	    fformat:
-		p = __floatcvt(FCVT,digstr,dval,precision,&decpt,&sign);
-		prefix = __dosign(sign,flags);
-		sbuf = &buf[0];
-		if (decpt <= 0)
-		    *sbuf++ = '0';	/* 1 digit before dec point */
-		while (decpt > 0)
-		{
-		    if (sbuf >= &buf[bufmax - 1])
-			goto Lerror;
-		    *sbuf++ = *p ? *p++ : '0';
-		    decpt--;
-		}
-		if (precision > 0 || flags & FLhash)
-		{
-		    *sbuf++ = '.';	/* . */
-		    while (decpt < 0 && precision > 0)
-		    {
-			if (sbuf >= &buf[bufmax])
-			    goto Lerror;
-			*sbuf++ = '0';
-			decpt++;
-			precision--;
-		    }
-
-		    if (precision > &buf[bufmax] - sbuf)
-			goto Lerror;
-		    for (; precision; precision--)
-		    {
-			*sbuf++ = *p ? *p++ : '0';
-		    }
-
-		    /* remove trailing 0s	*/
-		    if ((flags & (FLgformat | FLhash)) == FLgformat)
-			sbuf = __trim0(sbuf);
-		}
-		sl = sbuf - &buf[0];	/* length of string	*/
-		break;
-	    case 'e':
-	    case 'E':
-		p = __floatcvt(ECVT,digstr,dval,precision + 1,&decpt,&sign);
-	    eformat:
-		prefix = __dosign(sign,flags);
-		buf[0] = *p;
-		sbuf = &buf[1];
-		if (flags & FLhash ||
-		    (precision > 0 &&
-		    (!(flags & FLgformat) || precision != 1 || width))
-		   )
-		{	int n;
-
-			buf[1] = '.';	/* . */
-			n = bufmax - 5 - 2;
-			if (n < precision)
-			    goto Lerror;
-
-			p++;
-			sbuf++;
-			for (n = 0; n < precision; n++)
-			{
-			    *sbuf++ = *p ? *p++ : '0';
-			}
-
-			/* remove trailing 0s	*/
-			if ((flags & (FLgformat | FLhash)) == FLgformat)
-			    sbuf = __trim0(sbuf);
-		}
-		if (precision || (flags & FLprec && !(flags & FLgformat)))
-		{   *sbuf++ = c;
-		    if (dval)		/* avoid 0.00e-01	*/
-			decpt--;
-		    __doexponent(&sbuf,decpt,1);
-		}
-		sl = sbuf - &buf[0];	/* length of string	*/
-		break;
-	    case 'G':
-	    case 'g':
-		flags |= FLgformat;
-		if (precision == 0)
-		    precision = 1;
-		p = __floatcvt(ECVT,digstr,dval,precision,&decpt,&sign);
-		/* decpt-1 is the exponent	*/
-		if (decpt < -3 || decpt > precision)
-		{			/* use e format		*/
-		    if (precision > 1)
-			precision--;
-		    c -= 'g' - 'e';
-		    goto eformat;
-		}
-		else
-		{   /* Convert precision to digits *after* dot	*/
-		    precision -= decpt;	/* precision is >= 0	*/
-		    goto fformat;
-		}
-
-	    case 'a':
-	    case 'A':
-
-		decpt = ((((unsigned short *)&dval)[3] & 0x7FF0) >> 4) - 0x3FF;
-		{   unsigned long val[2];
-		    unsigned long val2[2];
-		    int i;
-
-		    val[0] = ((unsigned long *)&dval)[0];
-		    val[1] = ((unsigned long *)&dval)[1];
-
-		    // Left justify
-		    if (dval)
-		    {	val[1] |= 0x100000L;
-			val[1] <<= 11;
-			val[1] |= val[0] >> 5;
-			val[0] <<= 11;
-		    }
-
-		Lagain:
-		    val2[0] = val[0];
-		    val2[1] = val[1];
-		    p = digstr;
-		    if ((long)val[1] < 0)
-			*p = '1';
-		    else
-			*p = '0';
-		    p++;
-		    val[1] <<= 1;
-		    if ((long)val[0] < 0)
-			val[1] |= 1;
-		    val[0] <<= 1;
-
-		    if (!(flags & FLprec))
-			precision = 1000;	// number arbitrarilly larger
-						// than nibbles in mantissa
-
-		    for (i = 0; i < precision; i++)
-		    {
-			unsigned nibble;
-
-			if (!(flags & FLprec) && !(val[1] | val[0]))	// don't leave trailing 0's
-			{   precision = i;
-			    break;
-			}
-			nibble = (val[1] >> 28) & 0x0F;
-			if (nibble < 10)
-			    *p = '0' + nibble;
-			else if (c == 'a')
-			    *p = 'a' + nibble - 10;
-			else
-			    *p = 'A' + nibble - 10;
-			p++;
-			val[1] <<= 4;
-			val[1] |= val[0] >> 28;
-			val[0] <<= 4;
-			if (p - digstr == sizeof(digstr)/sizeof(digstr[0]) - 1)
-			    break;
-		    }
-		    *p = 0;
-
-		    // Round up if (guard && (odd || sticky))
-		    if ((long)val[1] < 0 && (p[-1] & 1 || (val[1] << 1) || val[0]))
-		    {
-			if (i >= 8)
-			{   if ((long)val2[0] < 0)
-			    {	val2[0] += 0x80000000L >> ((i - 8) * 4);
-				if ((long)val2[0] >= 0)
-				    val2[1]++;
-			    }
-			    else
-				val2[0] += 0x80000000L >> ((i - 8) * 4);
-			}
-			else
-			    val2[1] += 0x80000000L >> (i * 4);
-			if ((long)val2[1] >= 0)
-			{
-			    val2[0] >>= 1;
-			    if (val2[1] & 1)
-				val2[0] |= 0x80000000L;
-			    val2[1] >>= 1;
-			    val2[1] |= 0x80000000L;
-			    decpt++;
-			}
-			val[0] = val2[0];
-			val[1] = val2[1];
-			goto Lagain;
-		    }
-		}
-		p = digstr;
-		sign = 0;
-		//if (dval < 0)
-		if (signbit(dval))
-		    sign = 1;
-
-		prefix = __dosign(sign,flags);
-		buf[0] = '0';
-		buf[1] = 'X' | (c & 0x20);	// 'X' or 'x'
-		buf[2] = *p;
-		sbuf = &buf[3];
-		if (flags & FLhash || precision > 0 || !dval)
-		{	int n;
-
-			buf[3] = '.';	/* . */
-			n = bufmax - 7 - 4;	// 4 for 0xh., 7 for p+ddddd
-			if (n < precision)
-			    goto Lerror;
-
-			p++;
-			sbuf++;
-			for (n = 0; n < precision; n++)
-			{
-			    *sbuf++ = *p ? *p++ : '0';
-			}
-		}
-		//if (precision || flags & FLprec)
-		{   *sbuf++ = 'P' | (c & 0x20);		// 'P' or 'p'
-		    if (!dval)
-			decpt = 0;	// exponent for 0 is 0
-		    __doexponent(&sbuf,decpt,0);
-		}
-		sl = sbuf - &buf[0];	/* length of string	*/
-		break;
-	}
-    }
-    *psl = sl;
-    return prefix;
-
-Lerror:
-    *psl = -1;
-    return prefix;
-}
-
-/**************************
- * Add exponent to string s in form +-nn.
- * At least 2 digits.
- */
-
-static void   __doexponent(char **ps, int exp, int flag)
-{	register char *s = *ps;
-
-	*s++ = (exp < 0) ? ((exp = -exp),'-') : '+';
-
-	if (exp >= 10000)
-	{
-	    *s++ = exp / 10000 + '0';
-	    exp %= 10000;
-	    goto L2;
-	}
-	else if (exp >= 1000)
-	{
-	 L2:
-	    *s++ = exp / 1000 + '0';
-	    exp %= 1000;
-	    goto L1;
-	}
-	else if (exp >= 100)
-	{
-	 L1:
-	    *s++ = exp / 100 + '0';
-	    exp %= 100;
-	    goto L0;
-	}
-	// Microsoft uses a minimum of 3 digits.
-	// We do 2 for ANSI C99 compatibility.
-	else if (flag || exp >= 10)
-	{
-	 L0:
-	    *s++ = exp / 10 + '0';
-	    exp %= 10;
-	}
-	*s++ = exp + '0';
-	*ps = s;
-}
-
-/**************************
- * Trim trailing 0s and decimal point from string.
- */
-
-static char *__trim0(char *s)
-{
-	while (*(s-1) == '0')
-		s--;
-	if (*(s-1) == '.')		/* . */
-		s--;
-	return s;
-}
-
-
-/*************************
- * Convert double val to a string of
- * decimal digits.
- *	if (cnvflag == ECVT)
- *		ndig = # of digits in resulting string past the decimal point
- *	else
- *		ndig = # of digits in resulting string
- * 	digstr[LDBL_DIG * 2 + 2]
- * Returns:
- *	*pdecpt = position of decimal point from left of first digit
- *	*psign  = nonzero if value was negative
- * BUGS:
- *	This routine will hang if it is passed a NAN or INFINITY.
- */
-
-char * __floatcvt(int cnvflag, char *digstr, double val, int ndig, int *pdecpt, int *psign)
-{
-	int decpt,pow,i;
-	int nsig;
-	int sig;
-	char c;
-
-	if (signbit(val))
-	{
-	    *psign = 1;
-	    val = -val;
-	}
-	else
-	    *psign = 0;
-	ndig = (ndig < 0) ? 0
-			  : (ndig < DIGMAX) ? ndig
-					    : DIGMAX;
-	if (val == 0)
-	{
-		memset(digstr,'0',ndig);
-		decpt = 0;
-	}
-	else
-	{	/* Adjust things so that 1 <= val < 10	*/
-		decpt = 1;
-		pow = 256;
-		i = 0;
-		while (val < 1)
-		{	while (val < negtab[i + 1])
-			{	val *= postab[i];
-				decpt -= pow;
-			}
-			pow >>= 1;
-			i++;
-		}
-		pow = 256;
-		i = 0;
-		while (val >= 10)
-		{	while (val >= postab[i])
-			{	val *= negtab[i];
-				decpt += pow;
-			}
-			pow >>= 1;
-			i++;
-		}
-
-		if (cnvflag == FCVT && decpt > 0)
-		{	ndig += decpt;
-			if (ndig > DIGMAX)
-			    ndig = DIGMAX;
-		}
-
-		/* Pick off digits 1 by 1 and stuff into digstr[]	*/
-		/* Do 1 extra digit for rounding purposes		*/
-		nsig = 0;
-		sig = 0;
-		for (i = 0; i <= ndig; i++)
-		{	int n;
-
-			if (nsig > LDBL_DIG+1)
-			    c = '0';
-			else
-			{
-			    n = val;
-			    c = n + '0';
-			    val = (val - n) * 10;	/* get next digit */
-			    if (n)
-				sig = 1;
-			    nsig += sig;
-			}
-			digstr[i] = c;
-		}
-		if (c >= '5')		/* if we need to round		*/
-		{	--i;
-			while (1)
-			{
-				c = '0';
-				if (i == 0)		/* if at start	*/
-				{	ndig += cnvflag;
-					decpt++;	/* shift dec pnt */
-							/* "100000..."	*/
-					break;
-				}
-				digstr[i] = '0';
-				--i;
-				c = digstr[i];
-				if (c != '9')
-					break;
-			}
-			digstr[i] = c + 1;
-		} /* if */
-	} /* else */
-	*pdecpt = decpt;
-	digstr[ndig] = 0;		/* terminate string		*/
-	return digstr;
-}
+*/
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "nkarch.h"
+#include "nkstring.h"
+#include "nkprintf_fp.h"
+#include "nkdectab.h"
+
+#define LDBL_DIG 18
+
+#define DIGMAX	(LDBL_DIG*2)	/* max # of digits in string		*/
+				/* (*2 is a good fudge factor)		*/
+
+#define ECVT	0
+#define FCVT	1
+
+/********************* printf interface ********************/
+
+char *__floatcvt(int cnvflag, char *digstr, double val, int ndig, int *pdecpt, int *psign);
+static void __doexponent(char **ps, int exp, int flag);
+static char *__trim0(char *s);
+
+char *__dosign(int sign, int flags)
+{
+	return	(sign)		 ? "-" :
+		(flags & FLplus) ? "+" :
+		(flags & FLspc)	 ? " " :
+				   "";
+}
+
+/***********************************
+ * Do floating point formatting.
+ */
+
+char  *__floatfmt(int c, int flags, int precision, double *pdval, char *buf, int *psl, int width)
+{
+    char *p;
+    int fpd;			/* classification of double value	*/
+    int decpt;			/* exponent (base 10) for floats	*/
+    int sign;
+    char  *prefix;
+    int sl;			/* length of formatted string s		*/
+    char digstr[LDBL_DIG*2 + 2];
+    char *sbuf;
+    double dval;
+    int bufmax = *psl;
+
+    if (!(flags & FLprec))	/* if no precision	*/
+	precision = 6;		/* default precision	*/
+
+    dval = *pdval;
+    fpd = fpclassify(dval);
+    if (fpd <= FP_INFINITE)	/* if nan or infinity	*/
+    {
+	static char fptab[][5] =
+	{ "nans","nan","inf" };
+	static char fptablen[] = { 4,3,3 };
+
+	/* '#' and '0' flags have no effect	*/
+	flags &= ~(FL0pad | FLhash);
+	prefix = __dosign(signbit(dval),flags);
+
+	*(unsigned long *)buf = *(unsigned long *)fptab[fpd];
+	if (!(c & 0x20))	/* if c is upper case	*/
+	    /* Convert to upper case */
+	    *(unsigned long *)buf &= ~0x20202020;
+	sl = fptablen[fpd];	/* length of string	*/
+    }
+    else
+    {
+	switch (c)
+	{
+	    case 'f':
+	    case 'F':
+	    fformat:
+		p = __floatcvt(FCVT,digstr,dval,precision,&decpt,&sign);
+		prefix = __dosign(sign,flags);
+		sbuf = &buf[0];
+		if (decpt <= 0)
+		    *sbuf++ = '0';	/* 1 digit before dec point */
+		while (decpt > 0)
+		{
+		    if (sbuf >= &buf[bufmax - 1])
+			goto Lerror;
+		    *sbuf++ = *p ? *p++ : '0';
+		    decpt--;
+		}
+		if (precision > 0 || flags & FLhash)
+		{
+		    *sbuf++ = '.';	/* . */
+		    while (decpt < 0 && precision > 0)
+		    {
+			if (sbuf >= &buf[bufmax])
+			    goto Lerror;
+			*sbuf++ = '0';
+			decpt++;
+			precision--;
+		    }
+
+		    if (precision > &buf[bufmax] - sbuf)
+			goto Lerror;
+		    for (; precision; precision--)
+		    {
+			*sbuf++ = *p ? *p++ : '0';
+		    }
+
+		    /* remove trailing 0s	*/
+		    if ((flags & (FLgformat | FLhash)) == FLgformat)
+			sbuf = __trim0(sbuf);
+		}
+		sl = sbuf - &buf[0];	/* length of string	*/
+		break;
+	    case 'e':
+	    case 'E':
+		p = __floatcvt(ECVT,digstr,dval,precision + 1,&decpt,&sign);
+	    eformat:
+		prefix = __dosign(sign,flags);
+		buf[0] = *p;
+		sbuf = &buf[1];
+		if (flags & FLhash ||
+		    (precision > 0 &&
+		    (!(flags & FLgformat) || precision != 1 || width))
+		   )
+		{	int n;
+
+			buf[1] = '.';	/* . */
+			n = bufmax - 5 - 2;
+			if (n < precision)
+			    goto Lerror;
+
+			p++;
+			sbuf++;
+			for (n = 0; n < precision; n++)
+			{
+			    *sbuf++ = *p ? *p++ : '0';
+			}
+
+			/* remove trailing 0s	*/
+			if ((flags & (FLgformat | FLhash)) == FLgformat)
+			    sbuf = __trim0(sbuf);
+		}
+		if (precision || (flags & FLprec && !(flags & FLgformat)))
+		{   *sbuf++ = c;
+		    if (dval)		/* avoid 0.00e-01	*/
+			decpt--;
+		    __doexponent(&sbuf,decpt,1);
+		}
+		sl = sbuf - &buf[0];	/* length of string	*/
+		break;
+	    case 'G':
+	    case 'g':
+		flags |= FLgformat;
+		if (precision == 0)
+		    precision = 1;
+		p = __floatcvt(ECVT,digstr,dval,precision,&decpt,&sign);
+		/* decpt-1 is the exponent	*/
+		if (decpt < -3 || decpt > precision)
+		{			/* use e format		*/
+		    if (precision > 1)
+			precision--;
+		    c -= 'g' - 'e';
+		    goto eformat;
+		}
+		else
+		{   /* Convert precision to digits *after* dot	*/
+		    precision -= decpt;	/* precision is >= 0	*/
+		    goto fformat;
+		}
+
+	    case 'a':
+	    case 'A':
+
+		decpt = ((((unsigned short *)&dval)[3] & 0x7FF0) >> 4) - 0x3FF;
+		{   unsigned long val[2];
+		    unsigned long val2[2];
+		    int i;
+
+		    val[0] = ((unsigned long *)&dval)[0];
+		    val[1] = ((unsigned long *)&dval)[1];
+
+		    // Left justify
+		    if (dval)
+		    {	val[1] |= 0x100000L;
+			val[1] <<= 11;
+			val[1] |= val[0] >> 5;
+			val[0] <<= 11;
+		    }
+
+		Lagain:
+		    val2[0] = val[0];
+		    val2[1] = val[1];
+		    p = digstr;
+		    if ((long)val[1] < 0)
+			*p = '1';
+		    else
+			*p = '0';
+		    p++;
+		    val[1] <<= 1;
+		    if ((long)val[0] < 0)
+			val[1] |= 1;
+		    val[0] <<= 1;
+
+		    if (!(flags & FLprec))
+			precision = 1000;	// number arbitrarilly larger
+						// than nibbles in mantissa
+
+		    for (i = 0; i < precision; i++)
+		    {
+			unsigned nibble;
+
+			if (!(flags & FLprec) && !(val[1] | val[0]))	// don't leave trailing 0's
+			{   precision = i;
+			    break;
+			}
+			nibble = (val[1] >> 28) & 0x0F;
+			if (nibble < 10)
+			    *p = '0' + nibble;
+			else if (c == 'a')
+			    *p = 'a' + nibble - 10;
+			else
+			    *p = 'A' + nibble - 10;
+			p++;
+			val[1] <<= 4;
+			val[1] |= val[0] >> 28;
+			val[0] <<= 4;
+			if (p - digstr == sizeof(digstr)/sizeof(digstr[0]) - 1)
+			    break;
+		    }
+		    *p = 0;
+
+		    // Round up if (guard && (odd || sticky))
+		    if ((long)val[1] < 0 && (p[-1] & 1 || (val[1] << 1) || val[0]))
+		    {
+			if (i >= 8)
+			{   if ((long)val2[0] < 0)
+			    {	val2[0] += 0x80000000L >> ((i - 8) * 4);
+				if ((long)val2[0] >= 0)
+				    val2[1]++;
+			    }
+			    else
+				val2[0] += 0x80000000L >> ((i - 8) * 4);
+			}
+			else
+			    val2[1] += 0x80000000L >> (i * 4);
+			if ((long)val2[1] >= 0)
+			{
+			    val2[0] >>= 1;
+			    if (val2[1] & 1)
+				val2[0] |= 0x80000000L;
+			    val2[1] >>= 1;
+			    val2[1] |= 0x80000000L;
+			    decpt++;
+			}
+			val[0] = val2[0];
+			val[1] = val2[1];
+			goto Lagain;
+		    }
+		}
+		p = digstr;
+		sign = 0;
+		//if (dval < 0)
+		if (signbit(dval))
+		    sign = 1;
+
+		prefix = __dosign(sign,flags);
+		buf[0] = '0';
+		buf[1] = 'X' | (c & 0x20);	// 'X' or 'x'
+		buf[2] = *p;
+		sbuf = &buf[3];
+		if (flags & FLhash || precision > 0 || !dval)
+		{	int n;
+
+			buf[3] = '.';	/* . */
+			n = bufmax - 7 - 4;	// 4 for 0xh., 7 for p+ddddd
+			if (n < precision)
+			    goto Lerror;
+
+			p++;
+			sbuf++;
+			for (n = 0; n < precision; n++)
+			{
+			    *sbuf++ = *p ? *p++ : '0';
+			}
+		}
+		//if (precision || flags & FLprec)
+		{   *sbuf++ = 'P' | (c & 0x20);		// 'P' or 'p'
+		    if (!dval)
+			decpt = 0;	// exponent for 0 is 0
+		    __doexponent(&sbuf,decpt,0);
+		}
+		sl = sbuf - &buf[0];	/* length of string	*/
+		break;
+	}
+    }
+    *psl = sl;
+    return prefix;
+
+Lerror:
+    *psl = -1;
+    return prefix;
+}
+
+/**************************
+ * Add exponent to string s in form +-nn.
+ * At least 2 digits.
+ */
+
+static void   __doexponent(char **ps, int exp, int flag)
+{	register char *s = *ps;
+
+	*s++ = (exp < 0) ? ((exp = -exp),'-') : '+';
+
+	if (exp >= 10000)
+	{
+	    *s++ = exp / 10000 + '0';
+	    exp %= 10000;
+	    goto L2;
+	}
+	else if (exp >= 1000)
+	{
+	 L2:
+	    *s++ = exp / 1000 + '0';
+	    exp %= 1000;
+	    goto L1;
+	}
+	else if (exp >= 100)
+	{
+	 L1:
+	    *s++ = exp / 100 + '0';
+	    exp %= 100;
+	    goto L0;
+	}
+	// Microsoft uses a minimum of 3 digits.
+	// We do 2 for ANSI C99 compatibility.
+	else if (flag || exp >= 10)
+	{
+	 L0:
+	    *s++ = exp / 10 + '0';
+	    exp %= 10;
+	}
+	*s++ = exp + '0';
+	*ps = s;
+}
+
+/**************************
+ * Trim trailing 0s and decimal point from string.
+ */
+
+static char *__trim0(char *s)
+{
+	while (*(s-1) == '0')
+		s--;
+	if (*(s-1) == '.')		/* . */
+		s--;
+	return s;
+}
+
+
+/*************************
+ * Convert double val to a string of
+ * decimal digits.
+ *	if (cnvflag == ECVT)
+ *		ndig = # of digits in resulting string past the decimal point
+ *	else
+ *		ndig = # of digits in resulting string
+ * 	digstr[LDBL_DIG * 2 + 2]
+ * Returns:
+ *	*pdecpt = position of decimal point from left of first digit
+ *	*psign  = nonzero if value was negative
+ * BUGS:
+ *	This routine will hang if it is passed a NAN or INFINITY.
+ */
+
+char * __floatcvt(int cnvflag, char *digstr, double val, int ndig, int *pdecpt, int *psign)
+{
+	int decpt,pow,i;
+	int nsig;
+	int sig;
+	char c;
+
+	if (signbit(val))
+	{
+	    *psign = 1;
+	    val = -val;
+	}
+	else
+	    *psign = 0;
+	ndig = (ndig < 0) ? 0
+			  : (ndig < DIGMAX) ? ndig
+					    : DIGMAX;
+	if (val == 0)
+	{
+		memset(digstr,'0',ndig);
+		decpt = 0;
+	}
+	else
+	{	/* Adjust things so that 1 <= val < 10	*/
+		decpt = 1;
+		pow = 256;
+		i = 0;
+		while (val < 1)
+		{	while (val < negtab[i + 1])
+			{	val *= postab[i];
+				decpt -= pow;
+			}
+			pow >>= 1;
+			i++;
+		}
+		pow = 256;
+		i = 0;
+		while (val >= 10)
+		{	while (val >= postab[i])
+			{	val *= negtab[i];
+				decpt += pow;
+			}
+			pow >>= 1;
+			i++;
+		}
+
+		if (cnvflag == FCVT && decpt > 0)
+		{	ndig += decpt;
+			if (ndig > DIGMAX)
+			    ndig = DIGMAX;
+		}
+
+		/* Pick off digits 1 by 1 and stuff into digstr[]	*/
+		/* Do 1 extra digit for rounding purposes		*/
+		nsig = 0;
+		sig = 0;
+		for (i = 0; i <= ndig; i++)
+		{	int n;
+
+			if (nsig > LDBL_DIG+1)
+			    c = '0';
+			else
+			{
+			    n = val;
+			    c = n + '0';
+			    val = (val - n) * 10;	/* get next digit */
+			    if (n)
+				sig = 1;
+			    nsig += sig;
+			}
+			digstr[i] = c;
+		}
+		if (c >= '5')		/* if we need to round		*/
+		{	--i;
+			while (1)
+			{
+				c = '0';
+				if (i == 0)		/* if at start	*/
+				{	ndig += cnvflag;
+					decpt++;	/* shift dec pnt */
+							/* "100000..."	*/
+					break;
+				}
+				digstr[i] = '0';
+				--i;
+				c = digstr[i];
+				if (c != '9')
+					break;
+			}
+			digstr[i] = c + 1;
+		} /* if */
+	} /* else */
+	*pdecpt = decpt;
+	digstr[ndig] = 0;		/* terminate string		*/
+	return digstr;
+}
+
+/*********************** Shortest round trip ***********************/
+
+// Grisu2, from Florian Loitsch, "Printing Floating-Point Numbers Quickly
+// and Accurately with Integers" (PLDI 2010).  Finds the fewest digits which
+// still fall strictly between the value's neighbors, so that any correctly
+// rounding reader gets back the exact same bits.  Only integer arithmetic
+// on 64-bit "do it yourself" floats is used.  The interval is narrowed to
+// allow for rounding, so a shorter string right at its edge can be missed.
+// Like Grisu3, we notice when that might have happened and then check the
+// shorter strings exactly with big integers (see grisu_shorten).
+
+typedef struct {
+	uint64_t f;
+	int e;
+} diy_fp;
+
+// Normalized 10^k, for k = CACHED_MIN_K, CACHED_MIN_K + 8, ...  When double
+// is only 32 bits (AVR), we only need the powers which cover float.
+
+static const NK_FLASH struct cached_power {
+	uint64_t f;
+	int16_t e;
+} cached_powers[] =
+{
+#if __SIZEOF_DOUBLE__ > 4
+#define CACHED_MIN_K -348
+	{ 0xFA8FD5A0081C0288ULL, -1220 }, { 0xBAAEE17FA23EBF76ULL, -1193 }, { 0x8B16FB203055AC76ULL, -1166 },
+	{ 0xCF42894A5DCE35EAULL, -1140 }, { 0x9A6BB0AA55653B2DULL, -1113 }, { 0xE61ACF033D1A45DFULL, -1087 },
+	{ 0xAB70FE17C79AC6CAULL, -1060 }, { 0xFF77B1FCBEBCDC4FULL, -1034 }, { 0xBE5691EF416BD60CULL, -1007 },
+	{ 0x8DD01FAD907FFC3CULL, -980 }, { 0xD3515C2831559A83ULL, -954 }, { 0x9D71AC8FADA6C9B5ULL, -927 },
+	{ 0xEA9C227723EE8BCBULL, -901 }, { 0xAECC49914078536DULL, -874 }, { 0x823C12795DB6CE57ULL, -847 },
+	{ 0xC21094364DFB5637ULL, -821 }, { 0x9096EA6F3848984FULL, -794 }, { 0xD77485CB25823AC7ULL, -768 },
+	{ 0xA086CFCD97BF97F4ULL, -741 }, { 0xEF340A98172AACE5ULL, -715 }, { 0xB23867FB2A35B28EULL, -688 },
+	{ 0x84C8D4DFD2C63F3BULL, -661 }, { 0xC5DD44271AD3CDBAULL, -635 }, { 0x936B9FCEBB25C996ULL, -608 },
+	{ 0xDBAC6C247D62A584ULL, -582 }, { 0xA3AB66580D5FDAF6ULL, -555 }, { 0xF3E2F893DEC3F126ULL, -529 },
+	{ 0xB5B5ADA8AAFF80B8ULL, -502 }, { 0x87625F056C7C4A8BULL, -475 }, { 0xC9BCFF6034C13053ULL, -449 },
+	{ 0x964E858C91BA2655ULL, -422 }, { 0xDFF9772470297EBDULL, -396 }, { 0xA6DFBD9FB8E5B88FULL, -369 },
+	{ 0xF8A95FCF88747D94ULL, -343 }, { 0xB94470938FA89BCFULL, -316 }, { 0x8A08F0F8BF0F156BULL, -289 },
+	{ 0xCDB02555653131B6ULL, -263 }, { 0x993FE2C6D07B7FACULL, -236 }, { 0xE45C10C42A2B3B06ULL, -210 },
+	{ 0xAA242499697392D3ULL, -183 }, { 0xFD87B5F28300CA0EULL, -157 }, { 0xBCE5086492111AEBULL, -130 },
+	{ 0x8CBCCC096F5088CCULL, -103 }, { 0xD1B71758E219652CULL, -77 }, { 0x9C40000000000000ULL, -50 },
+	{ 0xE8D4A51000000000ULL, -24 }, { 0xAD78EBC5AC620000ULL, 3 }, { 0x813F3978F8940984ULL, 30 },
+	{ 0xC097CE7BC90715B3ULL, 56 }, { 0x8F7E32CE7BEA5C70ULL, 83 }, { 0xD5D238A4ABE98068ULL, 109 },
+	{ 0x9F4F2726179A2245ULL, 136 }, { 0xED63A231D4C4FB27ULL, 162 }, { 0xB0DE65388CC8ADA8ULL, 189 },
+	{ 0x83C7088E1AAB65DBULL, 216 }, { 0xC45D1DF942711D9AULL, 242 }, { 0x924D692CA61BE758ULL, 269 },
+	{ 0xDA01EE641A708DEAULL, 295 }, { 0xA26DA3999AEF774AULL, 322 }, { 0xF209787BB47D6B85ULL, 348 },
+	{ 0xB454E4A179DD1877ULL, 375 }, { 0x865B86925B9BC5C2ULL, 402 }, { 0xC83553C5C8965D3DULL, 428 },
+	{ 0x952AB45CFA97A0B3ULL, 455 }, { 0xDE469FBD99A05FE3ULL, 481 }, { 0xA59BC234DB398C25ULL, 508 },
+	{ 0xF6C69A72A3989F5CULL, 534 }, { 0xB7DCBF5354E9BECEULL, 561 }, { 0x88FCF317F22241E2ULL, 588 },
+	{ 0xCC20CE9BD35C78A5ULL, 614 }, { 0x98165AF37B2153DFULL, 641 }, { 0xE2A0B5DC971F303AULL, 667 },
+	{ 0xA8D9D1535CE3B396ULL, 694 }, { 0xFB9B7CD9A4A7443CULL, 720 }, { 0xBB764C4CA7A44410ULL, 747 },
+	{ 0x8BAB8EEFB6409C1AULL, 774 }, { 0xD01FEF10A657842CULL, 800 }, { 0x9B10A4E5E9913129ULL, 827 },
+	{ 0xE7109BFBA19C0C9DULL, 853 }, { 0xAC2820D9623BF429ULL, 880 }, { 0x80444B5E7AA7CF85ULL, 907 },
+	{ 0xBF21E44003ACDD2DULL, 933 }, { 0x8E679C2F5E44FF8FULL, 960 }, { 0xD433179D9C8CB841ULL, 986 },
+	{ 0x9E19DB92B4E31BA9ULL, 1013 }, { 0xEB96BF6EBADF77D9ULL, 1039 }, { 0xAF87023B9BF0EE6BULL, 1066 },
+#else
+#define CACHED_MIN_K -52
+	{ 0x993FE2C6D07B7FACULL, -236 }, { 0xE45C10C42A2B3B06ULL, -210 }, { 0xAA242499697392D3ULL, -183 },
+	{ 0xFD87B5F28300CA0EULL, -157 }, { 0xBCE5086492111AEBULL, -130 }, { 0x8CBCCC096F5088CCULL, -103 },
+	{ 0xD1B71758E219652CULL, -77 }, { 0x9C40000000000000ULL, -50 }, { 0xE8D4A51000000000ULL, -24 },
+	{ 0xAD78EBC5AC620000ULL, 3 }, { 0x813F3978F8940984ULL, 30 }, { 0xC097CE7BC90715B3ULL, 56 },
+	{ 0x8F7E32CE7BEA5C70ULL, 83 }, { 0xD5D238A4ABE98068ULL, 109 }, { 0x9F4F2726179A2245ULL, 136 },
+#endif
+};
+
+// Product of x and y, rounded to 64 bits
+
+static diy_fp diy_mul(diy_fp x, diy_fp y)
+{
+	uint64_t a = x.f >> 32, b = (uint32_t)x.f;
+	uint64_t c = y.f >> 32, d = (uint32_t)y.f;
+	uint64_t ad = a * d, bc = b * c;
+	uint64_t mid = ((b * d) >> 32) + (uint32_t)ad + (uint32_t)bc + (1UL << 31);
+	diy_fp r;
+	r.f = a * c + (ad >> 32) + (bc >> 32) + (mid >> 32);
+	r.e = x.e + y.e + 64;
+	return r;
+}
+
+static diy_fp diy_normalize(diy_fp x)
+{
+	while (!(x.f >> 56)) {
+		x.f <<= 8;
+		x.e -= 8;
+	}
+	while (!(x.f >> 63)) {
+		x.f <<= 1;
+		--x.e;
+	}
+	return x;
+}
+
+static const NK_FLASH uint32_t pow10_32[] =
+{
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Move the last digit down while that brings us closer to the value without
+// leaving the interval
+
+static void grisu_round(char *digits, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+	       (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		digits[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+// Value is f * 2^e.  lower_closer is set if the next value down is half as
+// far away as the next one up (f is a power of 2 and not the smallest
+// normal).  Digits are written to digits, the value is digits * 10^*pk.
+// *punsure is set if a string one digit shorter might still be inside the
+// exact interval.  Returns number of digits (at most 17).
+
+static int grisu2(uint64_t f, int e, int lower_closer, char *digits, int *pk, int *punsure)
+{
+	diy_fp v, w, wp, wm, c, one;
+	uint64_t delta, p2, wp_w, unit;
+	uint32_t p1;
+	int32_t x;
+	int kappa, len, idx, unsure;
+
+	// Boundaries halfway to the neighbors, with the same exponent
+	wp.f = (f << 1) + 1;
+	wp.e = e - 1;
+	wp = diy_normalize(wp);
+	if (lower_closer) {
+		wm.f = (f << 2) - 1;
+		wm.e = e - 2;
+	} else {
+		wm.f = (f << 1) - 1;
+		wm.e = e - 1;
+	}
+	wm.f <<= wm.e - wp.e;
+	wm.e = wp.e;
+	v.f = f;
+	v.e = e;
+
+	// Scale by 10^k so that the exponent is in [-60, -32]: the integer
+	// part of the upper boundary then fits in 32 bits.  k is the smallest
+	// table entry >= ceil((-61 - e) * log10(2)): (n * 78913) >> 18 is
+	// floor(n * log10(2)) for 0 <= n <= 1650.
+	x = -61 - wp.e;
+	if (x > 0)
+		x = ((x * 78913L) >> 18) + 1;
+	else
+		x = -((-x * 78913L) >> 18);
+	idx = (int)((x - CACHED_MIN_K + 7) >> 3);
+	c.f = cached_powers[idx].f;
+	c.e = cached_powers[idx].e;
+	*pk = -(CACHED_MIN_K + idx * 8);
+
+	w = diy_mul(diy_normalize(v), c);
+	wp = diy_mul(wp, c);
+	wm = diy_mul(wm, c);
+	// Stay inside the interval despite rounding in diy_mul
+	++wm.f;
+	--wp.f;
+	delta = wp.f - wm.f;
+	wp_w = wp.f - w.f;
+
+	one.e = wp.e;
+	one.f = (uint64_t)1 << -one.e;
+	p1 = (uint32_t)(wp.f >> -one.e);
+	p2 = wp.f & (one.f - 1);
+
+	// The exact boundaries are within a couple of units of wm and wp.  If
+	// we go past a digit count whose candidates (the digits so far, or one
+	// more in the last digit) are this close to the interval, we're unsure.
+	unit = 4;
+	unsure = 0;
+
+	// Integer part
+	for (kappa = 10; kappa > 1 && p1 < pow10_32[kappa - 1]; --kappa);
+	len = 0;
+	while (kappa > 0) {
+		uint32_t div = pow10_32[--kappa];
+		uint32_t d = p1 / div;
+		uint64_t rest, ten_kappa;
+		p1 -= d * div;
+		if (d || len)
+			digits[len++] = (char)('0' + d);
+		rest = ((uint64_t)p1 << -one.e) + p2;
+		ten_kappa = (uint64_t)div << -one.e;
+		if (rest <= delta) {
+			*pk += kappa;
+			*punsure = unsure;
+			grisu_round(digits, len, delta, rest, ten_kappa, wp_w);
+			return len;
+		}
+		unsure = (rest - delta < unit || ten_kappa - rest < unit);
+	}
+
+	// Fraction
+	for (;;) {
+		char d;
+		p2 *= 10;
+		delta *= 10;
+		wp_w *= 10;
+		unit *= 10;
+		d = (char)(p2 >> -one.e);
+		if (d || len)
+			digits[len++] = (char)('0' + d);
+		p2 &= one.f - 1;
+		--kappa;
+		if (p2 < delta) {
+			*pk += kappa;
+			*punsure = unsure;
+			grisu_round(digits, len, delta, p2, one.f, wp_w);
+			return len;
+		}
+		unsure = (p2 - delta < unit || one.f - p2 < unit);
+	}
+}
+
+// Big integers for exact comparisons, least significant word first.  Large
+// enough for 5^340 * 2^64 (or 5^54 * 2^96 where double is 32 bits).
+
+#if __SIZEOF_DOUBLE__ > 4
+#define BIG_WORDS 30
+#else
+#define BIG_WORDS 6
+#endif
+
+typedef struct {
+	int len;
+	uint32_t w[BIG_WORDS];
+} bignum;
+
+static void big_set(bignum *b, uint64_t v)
+{
+	b->w[0] = (uint32_t)v;
+	b->w[1] = (uint32_t)(v >> 32);
+	b->len = b->w[1] ? 2 : 1;
+}
+
+static void big_mul(bignum *b, uint32_t m)
+{
+	uint64_t carry = 0;
+	int i;
+	for (i = 0; i != b->len; ++i) {
+		carry += (uint64_t)b->w[i] * m;
+		b->w[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	if (carry)
+		b->w[b->len++] = (uint32_t)carry;
+}
+
+static void big_pow5(bignum *b, int n)
+{
+	for (; n >= 13; n -= 13)
+		big_mul(b, 1220703125); // 5^13
+	while (n--)
+		big_mul(b, 5);
+}
+
+static void big_shl(bignum *b, int n)
+{
+	int words = n >> 5, bits = n & 31, i;
+	b->w[b->len] = 0;
+	for (i = b->len; i >= 0; --i) {
+		uint32_t v = b->w[i] << bits;
+		if (bits && i)
+			v |= b->w[i - 1] >> (32 - bits);
+		b->w[i + words] = v;
+	}
+	for (i = 0; i != words; ++i)
+		b->w[i] = 0;
+	b->len += words + 1;
+	while (b->len > 1 && !b->w[b->len - 1])
+		--b->len;
+}
+
+static int big_cmp(const bignum *a, const bignum *b)
+{
+	int i;
+	if (a->len != b->len)
+		return a->len - b->len;
+	for (i = a->len - 1; i >= 0; --i)
+		if (a->w[i] != b->w[i])
+			return a->w[i] > b->w[i] ? 1 : -1;
+	return 0;
+}
+
+// Compare c * 10^k with m * 2^e exactly: returns < 0, 0 or > 0
+
+static int cmp_dec_bin(uint64_t c, int k, uint64_t m, int e)
+{
+	bignum a, b;
+	big_set(&a, c);
+	big_set(&b, m);
+	if (k >= 0)
+		big_pow5(&a, k);
+	else
+		big_pow5(&b, -k);
+	e -= k;
+	if (e >= 0)
+		big_shl(&b, e);
+	else
+		big_shl(&a, -e);
+	return big_cmp(&a, &b);
+}
+
+// Is c * 10^k inside the exact interval around f * 2^e?  The boundaries
+// themselves read back as f when it is even (round half to even).
+
+static int grisu_inside(uint64_t c, int k, uint64_t f, int e, int lower_closer)
+{
+	int lo, hi;
+	if (lower_closer)
+		lo = cmp_dec_bin(c, k, (f << 2) - 1, e - 2);
+	else
+		lo = cmp_dec_bin(c, k, (f << 1) - 1, e - 1);
+	hi = cmp_dec_bin(c, k, (f << 1) + 1, e - 1);
+	if (f & 1)
+		return lo > 0 && hi < 0;
+	else
+		return lo >= 0 && hi <= 0;
+}
+
+// Drop digits while the shorter string, rounded either way, is still inside
+// the exact interval.  Returns the new number of digits.
+
+static int grisu_shorten(uint64_t f, int e, int lower_closer, char *digits, int len, int *pk)
+{
+	while (len > 1) {
+		uint64_t t = 0, c;
+		int k = *pk + 1, i, in_t, in_t1;
+		for (i = 0; i != len - 1; ++i)
+			t = t * 10 + (uint64_t)(digits[i] - '0');
+		in_t = grisu_inside(t, k, f, e, lower_closer);
+		in_t1 = grisu_inside(t + 1, k, f, e, lower_closer);
+		if (in_t && in_t1)
+			// Both fit: take the nearer one
+			c = cmp_dec_bin(t * 10 + 5, k - 1, f, e) < 0 ? t + 1 : t;
+		else if (in_t)
+			c = t;
+		else if (in_t1)
+			c = t + 1;
+		else
+			break;
+		while (!(c % 10)) {
+			c /= 10;
+			++k;
+		}
+		for (len = 0, t = c; t; t /= 10)
+			++len;
+		for (i = len; i--; c /= 10)
+			digits[i] = (char)('0' + c % 10);
+		*pk = k;
+	}
+	return len;
+}
+
+/***********************************
+ * Format *pdval with the fewest significant digits which read back as the
+ * same value (as a float if single is set).  Like %g, uses an exponent if
+ * it's less than -4 or at least the type's maximum significant digits (17
+ * for double, 9 for float).  With FLhash, numbers without an exponent
+ * always get a decimal point: "1.0" instead of "1".  buf should hold 24
+ * characters.  Returns sign prefix like __floatfmt.
+ */
+
+char *__floatshort(int c, int flags, double *pdval, char *buf, int *psl, int single)
+{
+    char digits[18];
+    char *s = buf;
+    char *prefix;
+    double dval = *pdval;
+    uint64_t f;
+    int e, lower_closer, unsure, maxdig, ndig, decpt, i;
+
+    if (single)
+	dval = (float)dval;
+    prefix = __dosign(signbit(dval), flags);
+
+    switch (fpclassify(dval))
+    {
+	case FP_NAN:
+	case FP_INFINITE:
+	    memcpy(buf, isnan(dval) ? "nan" : "inf", 3);
+	    if (!(c & 0x20))
+		for (i = 0; i != 3; ++i)
+		    buf[i] &= ~0x20;
+	    *psl = 3;
+	    return prefix;
+	case FP_ZERO:
+	    digits[0] = '0';
+	    ndig = 1;
+	    decpt = 1;
+	    maxdig = 1;
+	    break;
+	default:
+#if __SIZEOF_DOUBLE__ > 4
+	    if (!single)
+	    {
+		uint64_t u;
+		memcpy(&u, &dval, sizeof(u));
+		e = (int)((u >> 52) & 0x7FF);
+		f = u & 0xFFFFFFFFFFFFFULL;
+		lower_closer = !f && e > 1;
+		if (e)
+		{   f |= 0x10000000000000ULL;
+		    e -= 1075;
+		}
+		else
+		    e = -1074;
+		maxdig = 17;
+	    }
+	    else
+#endif
+	    {
+		float fval = (float)dval;
+		uint32_t u;
+		memcpy(&u, &fval, sizeof(u));
+		e = (int)((u >> 23) & 0xFF);
+		f = u & 0x7FFFFF;
+		lower_closer = !f && e > 1;
+		if (e)
+		{   f |= 0x800000;
+		    e -= 150;
+		}
+		else
+		    e = -149;
+		maxdig = 9;
+	    }
+	    ndig = grisu2(f, e, lower_closer, digits, &decpt, &unsure);
+	    if (unsure)
+		ndig = grisu_shorten(f, e, lower_closer, digits, ndig, &decpt);
+	    decpt += ndig;	/* digits are 0.ddd * 10^decpt	*/
+	    break;
+    }
+
+    if (decpt - 1 < -4 || decpt - 1 >= maxdig)
+    {
+	*s++ = digits[0];
+	if (ndig > 1)
+	{
+	    *s++ = '.';
+	    for (i = 1; i != ndig; ++i)
+		*s++ = digits[i];
+	}
+	*s++ = (c & 0x20) ? 'e' : 'E';
+	__doexponent(&s, decpt - 1, 1);
+    }
+    else if (decpt <= 0)
+    {
+	*s++ = '0';
+	*s++ = '.';
+	for (i = decpt; i != 0; ++i)
+	    *s++ = '0';
+	for (i = 0; i != ndig; ++i)
+	    *s++ = digits[i];
+    }
+    else
+    {
+	for (i = 0; i < ndig || i < decpt; ++i)
+	{
+	    if (i == decpt)
+		*s++ = '.';
+	    *s++ = (i < ndig) ? digits[i] : '0';
+	}
+	if (decpt >= ndig && (flags & FLhash))
+	{
+	    *s++ = '.';
+	    *s++ = '0';
+	}
+    }
+    *psl = (int)(s - buf);
+    return prefix;
+}
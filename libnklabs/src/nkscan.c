@@ -35,9 +35,26 @@
 
 #include "nkstring.h"
 
+// Scanners work on the span of input in the current buffer where they can:
+// see nk_fspan_end() and nk_fspan_next()
+
+static inline int span_isspace(unsigned char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
 int nk_fscan_ws(nkinfile_t *f)
 {
-	for (int c = nk_fpeek(f); nk_isspace(c); c = nk_fnext_fast(f));
+	const unsigned char *p, *e;
+	do {
+		p = f->ptr;
+		e = nk_fspan_end(f);
+		// Indentation: skip four spaces at a time
+		while (e - p >= 4 && !memcmp(p, "    ", 4))
+			p += 4;
+		while (p != e && span_isspace(*p))
+			++p;
+	} while (nk_fspan_next(f, p));
 	return 1;
 }
 
@@ -97,16 +114,16 @@ int nk_fscan_escape(nkinfile_t *f)
 	return c;
 }
 
-static int _nk_fscan_word(int quash_case, nkinfile_t *f, char *buf, int width, size_t buf_size)
+// Scan body of a quoted string into buf, stop at the closing quote
+// Returns the closing quote or -1 if we hit end of file first
+
+static int scan_string(nkinfile_t *f, char **bufp, size_t *buf_sizep)
 {
-	int c;
-	int status = 0;
-	size_t orgpos = nk_ftell(f);
-	c = nk_fpeek(f);
-	if (c == '"') {
-		c = nk_fnext_fast(f);
-		status = 1;
-		while (c != -1 && c != '"') {
+	char *buf = *bufp;
+	size_t buf_size = *buf_sizep;
+	int c = nk_fpeek(f);
+	while (c != -1 && c != '"') {
+		if (c == '\\') {
 			c = nk_fscan_escape(f);
 			if (c == -1)
 				break;
@@ -114,26 +131,61 @@ static int _nk_fscan_word(int quash_case, nkinfile_t *f, char *buf, int width, s
 				*buf++ = (char)c;
 				--buf_size;
 			}
-			c = nk_fpeek(f);
+		} else {
+			// Run of plain characters
+			const unsigned char *p, *e;
+			do {
+				p = f->ptr;
+				e = nk_fspan_end(f);
+				while (p != e && *p != '"' && *p != '\\') {
+					if (buf_size > 1) {
+						*buf++ = (char)*p;
+						--buf_size;
+					}
+					++p;
+				}
+			} while (nk_fspan_next(f, p));
 		}
+		c = nk_fpeek(f);
+	}
+	*bufp = buf;
+	*buf_sizep = buf_size;
+	return c;
+}
+
+static int _nk_fscan_word(int quash_case, nkinfile_t *f, char *buf, int width, size_t buf_size)
+{
+	int c;
+	int status = 0;
+	size_t orgpos = nk_ftell(f);
+	c = nk_fpeek(f);
+	if (c == '"') {
+		nk_fnext_fast(f);
+		status = 1;
+		c = scan_string(f, &buf, &buf_size);
 		if (c == '"') {
 			nk_fnext_fast(f);
 		} else {
 			status = 0;
 		}
 	} else {
-		while (width && c != -1 && !nk_isspace(c)) {
-			if (buf_size > 1) {
-				if (quash_case)
-					*buf++ = (char)nk_tolower(c);
-				else
-					*buf++ = (char)c;
-				--buf_size;
+		const unsigned char *p, *e;
+		do {
+			p = f->ptr;
+			e = nk_fspan_end(f);
+			while (width && p != e && !span_isspace(*p)) {
+				if (buf_size > 1) {
+					if (quash_case)
+						*buf++ = (char)nk_tolower(*p);
+					else
+						*buf++ = (char)*p;
+					--buf_size;
+				}
+				--width;
+				status = 1;
+				++p;
 			}
-			--width;
-			status = 1;
-			c = nk_fnext_fast(f);
-		}
+		} while (nk_fspan_next(f, p));
 	}
 	if (status) {
 		if (buf_size)
@@ -160,18 +212,9 @@ static int _nk_fscan_ident(int quash_case, nkinfile_t *f, char *buf, int width,
 	size_t orgpos = nk_ftell(f);
 	int c = nk_fpeek(f);
 	if (c == '"') {
-		c = nk_fnext_fast(f);
+		nk_fnext_fast(f);
 		status = 1;
-		while (c != -1 && c != '"') {
-			c = nk_fscan_escape(f);
-			if (c == -1)
-				break;
-			if (buf_size > 1) {
-				*buf++ = (char)c;
-				--buf_size;
-			}
-			c = nk_fpeek(f);
-		}
+		c = scan_string(f, &buf, &buf_size);
 		if (c == '"') {
 			nk_fnext_fast(f);
 		} else {
@@ -179,18 +222,23 @@ static int _nk_fscan_ident(int quash_case, nkinfile_t *f, char *buf, int width,
 		}
 		goto bye;
 	} else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c =='_') {
-		while (width && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) {
-			if (buf_size > 1) {
-				if (quash_case)
-					*buf++ = (char)nk_tolower(c);
-				else
-					*buf++ = (char)c;
-				--buf_size;
+		const unsigned char *p, *e;
+		do {
+			p = f->ptr;
+			e = nk_fspan_end(f);
+			while (width && p != e && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_')) {
+				if (buf_size > 1) {
+					if (quash_case)
+						*buf++ = (char)nk_tolower(*p);
+					else
+						*buf++ = (char)*p;
+					--buf_size;
+				}
+				--width;
+				status = 1;
+				++p;
 			}
-			--width;
-			status = 1;
-			c =nk_fnext_fast(f);
-		}
+		} while (nk_fspan_next(f, p));
 	}
 	bye:
 	if (status) {
@@ -214,22 +262,27 @@ int nk_fiscan_ident(nkinfile_t *f, char *buf, int width, size_t buf_size)
 
 int nk_fscan_hex(nkinfile_t *f, uint64_t *val, int width)
 {
-	int c;
+	const unsigned char *p, *e;
 	uint64_t v = 0;
 	int status = 0;
 	size_t orgpos = nk_ftell(f);
-	c = nk_fpeek(f);
-	while (width && ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
-		status = 1;
-		if (c >= '0' && c <= '9')
-			v = v * 16 + (unsigned int)(c - '0');
-		else if (c >= 'a' && c <= 'f')
-			v = v * 16 + (unsigned int)(c - 'a' + 10);
-		else
-			v = v * 16 + (unsigned int)(c - 'A' + 10);
-		--width;
-		c = nk_fnext_fast(f);
-	}
+	do {
+		p = f->ptr;
+		e = nk_fspan_end(f);
+		while (width && p != e) {
+			unsigned int d = (unsigned int)(*p - '0');
+			if (d > 9) {
+				d = (unsigned int)((*p | 0x20) - 'a');
+				if (d > 5)
+					break;
+				d += 10;
+			}
+			status = 1;
+			v = v * 16 + d;
+			--width;
+			++p;
+		}
+	} while (nk_fspan_next(f, p));
 	if (status) {
 		*val = v;
 	} else {
@@ -241,6 +294,7 @@ int nk_fscan_hex(nkinfile_t *f, uint64_t *val, int width)
 int nk_fscan_dec(nkinfile_t *f, uint64_t *val, int width)
 {
 	int c;
+	const unsigned char *p, *e;
 	int inv = 0;
 	uint64_t v = 0;
 	int status = 0;
@@ -248,14 +302,19 @@ int nk_fscan_dec(nkinfile_t *f, uint64_t *val, int width)
 	c = nk_fpeek(f);
 	if (c == '-') {
 		inv = 1;
-		c = nk_fnext_fast(f);
-	}
-	while (c >= '0' && c <= '9' && width) {
-		status = 1;
-		v = v * 10 + (unsigned int)(c - '0');
-		--width;
-		c = nk_fnext_fast(f);
+		nk_fnext_fast(f);
 	}
+	// Run of digits
+	do {
+		p = f->ptr;
+		e = nk_fspan_end(f);
+		while (width && p != e && (unsigned int)(*p - '0') <= 9) {
+			status = 1;
+			v = v * 10 + (unsigned int)(*p - '0');
+			--width;
+			++p;
+		}
+	} while (nk_fspan_next(f, p));
 	if (inv)
 		v = -v;
 	if (status) {
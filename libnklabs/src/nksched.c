@@ -22,6 +22,7 @@
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 
+#include <string.h>
 #include "nkmacros.h"
 #include "nkcli.h"
 #include "nksched.h"
@@ -43,19 +44,52 @@ int nk_alloc_tid()
 	return ++next_tid;
 }
 
-// Work queue items.  First item is base of queue, rest are free items to use.
+// Work queue items.
 
 static struct item {
+#ifdef NK_SCHED_HEAP
+	struct item *next; // Free list link
+	int idx; // Position in heap[]
+	unsigned int seq; // Submission order, so that equal 'when's run FIFO
+#else
 	struct item *next, *prev;
+#endif
 	int tid;
 	void (*func)(void *data);
 	void *data;
 	nk_time_t when; // Time in timer ticks
+#ifdef NK_SCHED_SLACK
+	nk_time_t slack; // Task may be delayed by this many ticks to share a wakeup
+#endif
+#ifdef NK_SCHED_PERIODIC
+	nk_time_t period; // Period in timer ticks for periodic tasks, 0 for one-shot
+#endif
+#if defined(NK_SCHED_PERIODIC) || defined(NK_SCHED_EVENTS)
+	unsigned char flags; // NK_SCHED_xxx flags for periodic tasks, ITEM_FOREVER
+#endif
+#ifdef NK_SCHED_EVENTS
+	nk_event_t *ev; // Event we're waiting for, or NULL
+	struct item *ev_next; // Next task waiting for the same event
+#endif
 	const NK_FLASH char *comment;
 	const NK_FLASH char *name;
 	const NK_FLASH char *by;
 } queue[NK_WORK_QUEUE_SIZE];
 
+#ifdef NK_SCHED_EVENTS
+
+// Item is waiting for an event with no timeout: its 'when' is only a
+// placeholder, it's pushed back instead of being called
+
+#define ITEM_FOREVER 0x80
+
+// Placeholder distance to 'when' for ITEM_FOREVER items: far, but well
+// within wrap-safe comparison range
+
+#define FOREVER_TICKS 0x40000000
+
+#endif
+
 static struct item *freelist;
 
 static struct item *alloc_item()
@@ -72,6 +106,125 @@ static void free_item(struct item *i)
 	freelist = i;
 }
 
+#ifdef NK_SCHED_HEAP
+
+// Pending items are kept in a binary min-heap ordered by 'when' (wrap-safe)
+// and then by submission order.  Insert and remove are O(log n).  Finding
+// the item for a tid is left to the tid index, which the heap implies.
+
+static struct item *heap[NK_WORK_QUEUE_SIZE];
+static int heap_len;
+static unsigned int next_seq;
+
+// True if a should run before b
+
+static int item_before(struct item *a, struct item *b)
+{
+	int32_t d = (int32_t)(a->when - b->when);
+	if (d)
+		return d < 0;
+	return (int)(a->seq - b->seq) < 0;
+}
+
+static void heap_place(int idx, struct item *i)
+{
+	heap[idx] = i;
+	i->idx = idx;
+}
+
+static void sift_up(int idx)
+{
+	struct item *i = heap[idx];
+	while (idx) {
+		int parent = (idx - 1) >> 1;
+		if (!item_before(i, heap[parent]))
+			break;
+		heap_place(idx, heap[parent]);
+		idx = parent;
+	}
+	heap_place(idx, i);
+}
+
+static void sift_down(int idx)
+{
+	struct item *i = heap[idx];
+	for (;;) {
+		int child = 2 * idx + 1;
+		if (child >= heap_len)
+			break;
+		if (child + 1 < heap_len && item_before(heap[child + 1], heap[child]))
+			++child;
+		if (!item_before(heap[child], i))
+			break;
+		heap_place(idx, heap[child]);
+		idx = child;
+	}
+	heap_place(idx, i);
+}
+
+static void engine_insert(struct item *i)
+{
+	i->seq = next_seq++;
+	heap_place(heap_len, i);
+	sift_up(heap_len++);
+}
+
+static void engine_remove(struct item *i)
+{
+	int idx = i->idx;
+	struct item *last = heap[--heap_len];
+	if (last != i) {
+		heap_place(idx, last);
+		if (idx && item_before(last, heap[(idx - 1) >> 1]))
+			sift_up(idx);
+		else
+			sift_down(idx);
+	}
+}
+
+#if defined(NK_SCHED_PERIODIC) || defined(NK_SCHED_EVENTS)
+
+// Move item to its new position after its 'when' has been advanced
+
+static void engine_requeue(struct item *i)
+{
+	i->seq = next_seq++;
+	sift_down(i->idx);
+}
+
+#endif
+
+static struct item *queue_first()
+{
+	return heap_len ? heap[0] : 0;
+}
+
+// Only for tids beyond the tid index
+
+static struct item *scan_item(int tid)
+{
+	int x;
+	for (x = 0; x != heap_len; ++x)
+		if (heap[x]->tid == tid)
+			return heap[x];
+	return 0;
+}
+
+static void engine_init()
+{
+	int i;
+	heap_len = 0;
+	freelist = 0;
+	for (i = 0; i != sizeof(queue) / sizeof(struct item); ++i) {
+		free_item(&queue[i]);
+	}
+}
+
+#else
+
+// Pending items are kept in a doubly linked list sorted by 'when'.  First
+// item of queue[] is the base of the list, rest are free items to use.
+
 static struct item *deque(struct item *i)
 {
 	i->prev->next = i->next;
@@ -87,57 +240,422 @@ static void enque(struct item *q, struct item *i)
 	q->prev = i;
 }
 
-static int queue_not_empty()
+static void engine_insert(struct item *i)
 {
-	return queue != queue->next;
+	struct item *q;
+	// Find first item ahead of us in time, or end of queue
+	for (q = queue->next; q != queue; q = q->next)
+		if ((int32_t)(q->when - i->when) > 0)
+			break;
+	// Insert new item before this one
+	enque(q, i);
 }
 
-// delay in milliseconds
-int _nk_sched(int tid, void (*func)(void *data), void *data, uint32_t delay, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+static void engine_remove(struct item *i)
 {
-	struct item *item;
-	nk_irq_flag_t irq_flag;
-	int rtn = 0;
+	deque(i);
+}
 
-	// Convert delay in milliseconds to ticks
-	delay = nk_convert_delay(delay);
+#if defined(NK_SCHED_PERIODIC) || defined(NK_SCHED_EVENTS)
 
-	irq_flag = nk_irq_lock(&sched_lock);
+// Move item to its new position after its 'when' has been advanced
 
-	// Maybe this function is already queued.. if so reschedule
+static void engine_requeue(struct item *i)
+{
+	deque(i);
+	engine_insert(i);
+}
+
+#endif
+
+static struct item *queue_first()
+{
+	return queue != queue->next ? queue->next : 0;
+}
+
+static struct item *scan_item(int tid)
+{
+	struct item *item;
 	for (item = queue->next; item != queue; item = item->next)
 		if (item->tid == tid)
+			return item;
+	return 0;
+}
+
+static void engine_init()
+{
+	int i;
+	queue->next = queue;
+	queue->prev = queue;
+	freelist = 0;
+	for (i = 1; i != sizeof(queue) / sizeof(struct item); ++i) {
+		free_item(&queue[i]);
+	}
+}
+
+#endif
+
+#if defined(NK_SCHED_HEAP) && !defined(NK_SCHED_TID_INDEX_SIZE)
+// Without an index, finding the item to replace or cancel would be a search
+// of the whole heap, so submit, reschedule and cancel would still be O(n)
+#define NK_SCHED_TID_INDEX_SIZE NK_WORK_QUEUE_SIZE
+#endif
+
+#ifdef NK_SCHED_TID_INDEX_SIZE
+
+// Direct mapped tid to pending item table.  Tids from nk_alloc_tid() are
+// small dense numbers, so most lookups are a single array access.  Larger
+// tids fall back to a search of the queue.
+
+static struct item *tid_index[NK_SCHED_TID_INDEX_SIZE];
+
+#endif
+
+#ifdef NK_SCHED_SLACK
+
+// Number of pending items with slack
+
+static int slack_count;
+
+#endif
+
+static void queue_insert(struct item *i)
+{
+	engine_insert(i);
+#ifdef NK_SCHED_TID_INDEX_SIZE
+	if ((unsigned int)i->tid < NK_SCHED_TID_INDEX_SIZE)
+		tid_index[i->tid] = i;
+#endif
+#ifdef NK_SCHED_SLACK
+	if (i->slack)
+		++slack_count;
+#endif
+}
+
+#ifdef NK_SCHED_EVENTS
+
+// Remove item from its event's list of waiting tasks
+
+static void event_detach(struct item *i)
+{
+	struct item **p;
+	for (p = (struct item **)&i->ev->waiters; *p; p = &(*p)->ev_next)
+		if (*p == i) {
+			*p = i->ev_next;
 			break;
-	if (item == queue) {
+		}
+	i->ev = 0;
+}
+
+#endif
+
+static void queue_remove(struct item *i)
+{
+#ifdef NK_SCHED_EVENTS
+	if (i->ev)
+		event_detach(i);
+#endif
+	engine_remove(i);
+#ifdef NK_SCHED_TID_INDEX_SIZE
+	if ((unsigned int)i->tid < NK_SCHED_TID_INDEX_SIZE)
+		tid_index[i->tid] = 0;
+#endif
+#ifdef NK_SCHED_SLACK
+	if (i->slack)
+		--slack_count;
+#endif
+}
+
+#if defined(NK_SCHED_PERIODIC) || defined(NK_SCHED_EVENTS)
+#define queue_requeue engine_requeue
+#endif
+
+static struct item *find_item(int tid)
+{
+#ifdef NK_SCHED_TID_INDEX_SIZE
+	if ((unsigned int)tid < NK_SCHED_TID_INDEX_SIZE)
+		return tid_index[tid];
+#endif
+	return scan_item(tid);
+}
+
+static void queue_init()
+{
+#ifdef NK_SCHED_TID_INDEX_SIZE
+	int i;
+	for (i = 0; i != NK_SCHED_TID_INDEX_SIZE; ++i)
+		tid_index[i] = 0;
+#endif
+#ifdef NK_SCHED_SLACK
+	slack_count = 0;
+#endif
+	engine_init();
+}
+
+#if defined(NK_SCHED_SLACK) && defined(NK_SCHED_HEAP)
+
+// Lower 'wake' with the items in the subtree at idx.  No item in a subtree
+// is due before its root, so a subtree whose root is not due before 'wake'
+// can't lower it and is skipped.  Only items which run in the coming wakeup
+// are visited, and the recursion is no deeper than the heap.
+
+static nk_time_t heap_wakeup(int idx, nk_time_t wake)
+{
+	struct item *q;
+	if (idx >= heap_len)
+		return wake;
+	q = heap[idx];
+	if ((int32_t)(q->when - wake) >= 0)
+		return wake;
+	if ((int32_t)(q->when + q->slack - wake) < 0)
+		wake = q->when + q->slack;
+	wake = heap_wakeup(2 * idx + 1, wake);
+	return heap_wakeup(2 * idx + 2, wake);
+}
+
+#endif
+
+// Time to wake up for the next batch of work: the earliest 'when + slack'
+// of all pending items.  Every item whose 'when' has passed by then runs
+// in the same wakeup.
+
+static nk_time_t queue_wakeup(struct item *first)
+{
+#ifdef NK_SCHED_SLACK
+	nk_time_t wake = first->when + first->slack;
+	if (slack_count) {
+		// Only items with 'when' before the current answer can lower it
+#ifdef NK_SCHED_HEAP
+		wake = heap_wakeup(1, wake);
+		wake = heap_wakeup(2, wake);
+#else
+		struct item *q;
+		for (q = first->next; q != queue && (int32_t)(q->when - wake) < 0; q = q->next)
+			if ((int32_t)(q->when + q->slack - wake) < 0)
+				wake = q->when + q->slack;
+#endif
+	}
+	return wake;
+#else
+	return first->when;
+#endif
+}
+
+// Submit or replace a task, called with sched_lock held
+
+static int submit(int tid, void (*func)(void *data), void *data, nk_time_t when, nk_time_t slack, nk_time_t period, int flags, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+{
+	struct item *item;
+	int rtn = 0;
+
+	// Maybe this function is already queued.. if so reschedule
+	item = find_item(tid);
+	if (!item) {
 		item = alloc_item();
 		rtn = 1;
 	} else {
-		deque(item);
+		queue_remove(item);
 		rtn = 0;
 	}
 	if (item) {
-		struct item *q;
 		item->tid = tid;
 		item->func = func;
 		item->data = data;
-		item->when = nk_get_time() + delay;
+		item->when = when;
+#ifdef NK_SCHED_SLACK
+		item->slack = slack;
+#else
+		(void)slack;
+#endif
+#ifdef NK_SCHED_PERIODIC
+		item->period = period;
+#else
+		(void)period;
+#endif
+#if defined(NK_SCHED_PERIODIC) || defined(NK_SCHED_EVENTS)
+		item->flags = (unsigned char)flags;
+#else
+		(void)flags;
+#endif
+#ifdef NK_SCHED_EVENTS
+		item->ev = 0;
+#endif
 		item->name = name;
 		item->by = by;
 		item->comment = comment;
-		// Find first item ahead of us in time, or end of queue
-		for (q = queue->next; q != queue; q = q->next)
-			if ((int32_t)(q->when - item->when) > 0)
-				break;
-		// Insert new item before this one
-		enque(q, item);
+		queue_insert(item);
 	} else {
 		// Not enough work queue entries!
 		nk_error_message("Too many work queue entries, task could not be submitted!\n");
 	}
+	return rtn;
+}
+
+// delay in milliseconds
+int _nk_sched(int tid, void (*func)(void *data), void *data, uint32_t delay, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+{
+	nk_irq_flag_t irq_flag;
+	int rtn = 0;
+
+	// Convert delay in milliseconds to ticks
+	delay = nk_convert_delay(delay);
+
+	irq_flag = nk_irq_lock(&sched_lock);
+	rtn = submit(tid, func, data, nk_get_time() + delay, 0, 0, 0, name, by, comment);
+	nk_irq_unlock(&sched_lock, irq_flag);
+	return rtn;
+}
+
+#ifdef NK_SCHED_SLACK
+
+// delay and slack in milliseconds
+int _nk_sched_slack(int tid, void (*func)(void *data), void *data, uint32_t delay, uint32_t slack, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+{
+	nk_irq_flag_t irq_flag;
+	int rtn = 0;
+
+	// Convert milliseconds to ticks
+	delay = nk_convert_delay(delay);
+	slack = nk_convert_delay(slack);
+
+	irq_flag = nk_irq_lock(&sched_lock);
+	rtn = submit(tid, func, data, nk_get_time() + delay, slack, 0, 0, name, by, comment);
+	nk_irq_unlock(&sched_lock, irq_flag);
+	return rtn;
+}
+
+#endif
+
+#ifdef NK_SCHED_PERIODIC
+
+// period and phase in milliseconds
+int _nk_sched_periodic(int tid, void (*func)(void *data), void *data, uint32_t period, uint32_t phase, int flags, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+{
+	nk_irq_flag_t irq_flag;
+	int rtn = 0;
+
+	// Convert milliseconds to ticks
+	period = nk_convert_delay(period);
+	phase = nk_convert_delay(phase);
+
+	irq_flag = nk_irq_lock(&sched_lock);
+	rtn = submit(tid, func, data, nk_get_time() + phase, 0, period, flags, name, by, comment);
+	nk_irq_unlock(&sched_lock, irq_flag);
+	return rtn;
+}
+
+#endif
+
+#ifdef NK_SCHED_EVENTS
+
+// timeout in milliseconds
+int _nk_event_wait(nk_event_t *ev, int tid, void (*func)(void *data), void *data, uint32_t timeout, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+{
+	nk_irq_flag_t irq_flag;
+	nk_time_t delay;
+	int flags = 0;
+	int rtn = 0;
+	struct item *item;
+
+	if (timeout == NK_EVENT_FOREVER) {
+		delay = FOREVER_TICKS;
+		flags = ITEM_FOREVER;
+	} else {
+		delay = nk_convert_delay(timeout);
+	}
+
+	irq_flag = nk_irq_lock(&sched_lock);
+	rtn = submit(tid, func, data, nk_get_time() + delay, 0, 0, flags, name, by, comment);
+	item = find_item(tid);
+	if (item) {
+		item->ev = ev;
+		item->ev_next = (struct item *)ev->waiters;
+		ev->waiters = item;
+	}
 	nk_irq_unlock(&sched_lock, irq_flag);
 	return rtn;
 }
 
+int nk_event_signal(nk_event_t *ev)
+{
+	nk_irq_flag_t irq_flag;
+	struct item *item;
+	int count = 0;
+
+	irq_flag = nk_irq_lock(&sched_lock);
+	item = (struct item *)ev->waiters;
+	ev->waiters = 0;
+	while (item) {
+		struct item *next = item->ev_next;
+		// Already detached, so queue_remove() leaves the list alone
+		item->ev = 0;
+		queue_remove(item);
+		item->when = nk_get_time();
+		item->flags = 0;
+		queue_insert(item);
+		++count;
+		item = next;
+	}
+	nk_irq_unlock(&sched_lock, irq_flag);
+	return count;
+}
+
+#endif
+
+#ifdef NK_SCHED_ISR_SOURCES
+
+// Interrupt sources: an interrupt handler posts a task by setting its
+// pending flag.  The main loop submits pending tasks on its next pass.
+
+volatile unsigned char nk_isr_pending[NK_SCHED_ISR_SOURCES];
+volatile unsigned char nk_isr_any_pending;
+
+static struct isr_source {
+	int tid;
+	void (*func)(void *data);
+	void *data;
+	const NK_FLASH char *name;
+	const NK_FLASH char *by;
+	const NK_FLASH char *comment;
+} isr_sources[NK_SCHED_ISR_SOURCES];
+
+static int next_isr_source;
+
+int nk_alloc_isr_source()
+{
+	if (next_isr_source == NK_SCHED_ISR_SOURCES)
+		return -1;
+	return next_isr_source++;
+}
+
+void _nk_set_isr_source(int src, int tid, void (*func)(void *data), void *data, const NK_FLASH char *name, const NK_FLASH char *by, const NK_FLASH char *comment)
+{
+	nk_irq_flag_t irq_flag = nk_irq_lock(&sched_lock);
+	isr_sources[src].tid = tid;
+	isr_sources[src].func = func;
+	isr_sources[src].data = data;
+	isr_sources[src].name = name;
+	isr_sources[src].by = by;
+	isr_sources[src].comment = comment;
+	nk_irq_unlock(&sched_lock, irq_flag);
+}
+
+// Submit tasks posted by interrupt handlers, called with sched_lock held
+
+static void drain_isr_sources()
+{
+	int x;
+	nk_isr_any_pending = 0;
+	for (x = 0; x != next_isr_source; ++x)
+		if (nk_isr_pending[x]) {
+			struct isr_source *s = &isr_sources[x];
+			nk_isr_pending[x] = 0;
+			submit(s->tid, s->func, s->data, nk_get_time(), 0, 0, 0, s->name, s->by, s->comment);
+		}
+}
+
+#endif
+
 int nk_resched(int tid, void (*func)(void *data), void *data, uint32_t delay)
 {
 	struct item *item;
@@ -149,24 +667,19 @@ int nk_resched(int tid, void (*func)(void *data), void *data, uint32_t delay)
 
 	irq_flag = nk_irq_lock(&sched_lock);
 
-	// Look for tiem
-	for (item = queue->next; item != queue; item = item->next)
-		if (item->tid == tid)
-			break;
-	if (item == queue) { // Not found
+	// Look for item
+	item = find_item(tid);
+	if (!item) { // Not found
 		rtn = 0;
 	} else { // Found
-		struct item *q;
-		deque(item);
+		queue_remove(item);
 		item->when = nk_get_time() + delay;
+#ifdef NK_SCHED_EVENTS
+		item->flags &= ~ITEM_FOREVER;
+#endif
 		item->func = func;
 		item->data = data;
-		// Find first item ahead of us in time, or end of queue
-		for (q = queue->next; q != queue; q = q->next)
-			if ((int32_t)(q->when - item->when) > 0)
-				break;
-		// Insert new item before this one
-		enque(q, item);
+		queue_insert(item);
 		rtn = 1;
 	}
 	nk_irq_unlock(&sched_lock, irq_flag);
@@ -182,13 +695,11 @@ int nk_unsched(int tid)
 	irq_flag = nk_irq_lock(&sched_lock);
 
 	// Look for item
-	for (item = queue->next; item != queue; item = item->next)
-		if (item->tid == tid)
-			break;
-	if (item == queue) { // Item not found
+	item = find_item(tid);
+	if (!item) { // Item not found
 		rtn = 0;
 	} else { // Found
-		deque(item);
+		queue_remove(item);
 		free_item(item);
 		rtn = 1;
 	}
@@ -200,58 +711,186 @@ int nk_unsched(int tid)
 
 int nk_check(int tid)
 {
-	struct item *item;
 	nk_irq_flag_t irq_flag;
 	int rtn = 0;
 
 	irq_flag = nk_irq_lock(&sched_lock);
 
 	// Look for item
-	for (item = queue->next; item != queue; item = item->next)
-		if (item->tid == tid)
-			break;
-	if (item == queue) { // Item not found
-		rtn = 0;
-	} else { // Found
-		rtn = 1;
-	}
+	rtn = (find_item(tid) != 0);
+
 	nk_irq_unlock(&sched_lock, irq_flag);
 	return rtn;
 }
 
 void nk_init_sched()
 {
-	int i;
 	nk_startup_message("Work queue\n");
-	queue->next = queue;
-	queue->prev = queue;
-	freelist = 0;
-	for (i = 1; i != sizeof(queue) / sizeof(struct item); ++i) {
-		free_item(&queue[i]);
-	}
+	queue_init();
 	nk_init_sched_timer();
 }
 
+#ifdef NK_SCHED_STATS_SIZE
+
+// Task profiling: run count and execution time per tid, plus a log2
+// histogram of how late tasks are dispatched.  Times are in scheduler
+// ticks.  Only the main loop touches these.
+
+#define NK_SCHED_STATS_BUCKETS 16
+
+static struct task_stats {
+	const NK_FLASH char *name;
+	const NK_FLASH char *by;
+	uint32_t runs;
+	uint32_t total; // Total execution time
+	nk_time_t max; // Longest execution time
+	nk_time_t max_late; // Latest dispatch
+} task_stats[NK_SCHED_STATS_SIZE];
+
+static uint32_t late_hist[NK_SCHED_STATS_BUCKETS];
+static uint32_t untracked_runs; // Runs of tids beyond task_stats[]
+
+// Record dispatch of an item, called with sched_lock held
+
+static void stats_dispatch(struct item *i, nk_time_t now)
+{
+	nk_time_t late = now - i->when;
+	int bucket = 0;
+	while (late && bucket != NK_SCHED_STATS_BUCKETS - 1) {
+		late >>= 1;
+		++bucket;
+	}
+	++late_hist[bucket];
+	if ((unsigned int)i->tid < NK_SCHED_STATS_SIZE) {
+		struct task_stats *t = &task_stats[i->tid];
+		t->name = i->name;
+		t->by = i->by;
+		if (now - i->when > t->max_late)
+			t->max_late = now - i->when;
+	}
+}
+
+// Record execution time of task which just returned
+
+static void stats_done(int tid, nk_time_t start)
+{
+	nk_time_t elapsed = nk_get_time() - start;
+	if ((unsigned int)tid < NK_SCHED_STATS_SIZE) {
+		struct task_stats *t = &task_stats[tid];
+		++t->runs;
+		t->total += elapsed;
+		if (elapsed > t->max)
+			t->max = elapsed;
+	} else {
+		++untracked_runs;
+	}
+}
+
+static void stats_reset()
+{
+	memset(task_stats, 0, sizeof(task_stats));
+	memset(late_hist, 0, sizeof(late_hist));
+	untracked_runs = 0;
+}
+
+static void stats_print()
+{
+	int x;
+	nk_printf("Task statistics (times in scheduler ticks):\n");
+	for (x = 0; x != NK_SCHED_STATS_SIZE; ++x) {
+		struct task_stats *t = &task_stats[x];
+		if (t->runs) {
+#ifdef NK_PSTR
+			nk_printf(" tid=%d func=%S runs=%lu total=%lu max=%lu avg=%lu max_late=%lu [submitted by %S]\n",
+#else
+			nk_printf(" tid=%d func=%s runs=%lu total=%lu max=%lu avg=%lu max_late=%lu [submitted by %s]\n",
+#endif
+				x, t->name, (unsigned long)t->runs, (unsigned long)t->total, (unsigned long)t->max,
+				(unsigned long)(t->total / t->runs), (unsigned long)t->max_late, t->by);
+		}
+	}
+	if (untracked_runs)
+		nk_printf(" Runs of tids >= %d not tracked: %lu\n", NK_SCHED_STATS_SIZE, (unsigned long)untracked_runs);
+	nk_printf("Dispatch lateness:\n");
+	for (x = 0; x != NK_SCHED_STATS_BUCKETS; ++x) {
+		if (late_hist[x]) {
+			if (x == 0)
+				nk_printf("        0: %lu\n", (unsigned long)late_hist[x]);
+			else if (x == NK_SCHED_STATS_BUCKETS - 1)
+				nk_printf(" >= %5lu: %lu\n", 1UL << (x - 1), (unsigned long)late_hist[x]);
+			else
+				nk_printf(" %2lu..%5lu: %lu\n", 1UL << (x - 1), (1UL << x) - 1, (unsigned long)late_hist[x]);
+		}
+	}
+}
+
+#define WORK_STATS_HELP \
+	"-work stats                Show task run time and dispatch lateness\n" \
+	"-work reset                Clear task statistics\n"
+
+#else
+
+#define WORK_STATS_HELP
+
+#endif
+
+static void print_item(struct item *i)
+{
+	/* Note that on ARM, address will be odd, due to thumb mode bit being set */
+#ifdef NK_PSTR
+	nk_printf(" \"%S\": tid=%d func=%S(0x%p) data=0x%p when=%lu [submitted by %S]\n", i->comment, i->tid, i->name, i->func, i->data, (unsigned long)i->when, i->by);
+#else
+	nk_printf(" \"%s\": tid=%d func=%s(0x%p) data=0x%p when=%lu [submitted by %s]\n", i->comment, i->tid, i->name, i->func, i->data, (unsigned long)i->when, i->by);
+#endif
+}
+
+#ifdef NK_SCHED_HEAP
+
+// Print the heap in the order the items will run: each pass picks the first
+// item after the one printed last.  This is O(n^2), but it's only for the
+// "work" command and needs no extra memory.
+
+static void print_heap()
+{
+	struct item *prev = 0;
+	int x, y;
+	for (x = 0; x != heap_len; ++x) {
+		struct item *next = 0;
+		for (y = 0; y != heap_len; ++y)
+			if ((!prev || item_before(prev, heap[y])) && (!next || item_before(heap[y], next)))
+				next = heap[y];
+		print_item(next);
+		prev = next;
+	}
+}
+
+#endif
+
 static int cmd_work(nkinfile_t *args)
 {
 	nk_irq_flag_t irq_flag;
+#ifndef NK_SCHED_HEAP
 	struct item *i;
+#endif
 	if (nk_fscan(args, "")) {
-		nk_printf("Current time = %lu\n", nk_get_time());
+		nk_printf("Current time = %lu\n", (unsigned long)nk_get_time());
 		nk_printf("Pending tasks:\n");
 		irq_flag = nk_irq_lock(&sched_lock);
-		if (queue->next != queue) {
-			for (i = queue->next; i != queue; i = i->next) {
-				/* Note that on ARM, address will be odd, due to thumb mode bit being set */
-#ifdef NK_PSTR
-				nk_printf(" \"%S\": tid=%d func=%S(0x%p) data=0x%p when=%lu [submitted by %S]\n", i->comment, i->tid, i->name, i->func, i->data, i->when, i->by);
+#ifdef NK_SCHED_HEAP
+		print_heap();
 #else
-				nk_printf(" \"%s\": tid=%d func=%s(0x%p) data=0x%p when=%lu [submitted by %s]\n", i->comment, i->tid, i->name, i->func, i->data, i->when, i->by);
+		for (i = queue->next; i != queue; i = i->next)
+			print_item(i);
 #endif
-			}
-		}
 		nk_irq_unlock(&sched_lock, irq_flag);
 		nk_printf("End of list.\n");
+#ifdef NK_SCHED_STATS_SIZE
+	} else if (nk_fscan(args, "stats ")) {
+		stats_print();
+	} else if (nk_fscan(args, "reset ")) {
+		stats_reset();
+		nk_printf("Task statistics cleared\n");
+#endif
 	} else {
 		nk_printf("Syntax error\n");
 	}
@@ -261,6 +900,7 @@ static int cmd_work(nkinfile_t *args)
 COMMAND(cmd_work,
 	">work                      Show work queue\n"
 	"-work                      Show work queue\n"
+	WORK_STATS_HELP
 )
 
 static int deepness = 0;
@@ -297,39 +937,94 @@ COMMAND(cmd_power,
 	"-power <n>                 Set power mode (0, 1 or 2)\n"
 )
 
+static int (*idle_func)(void);
+
+void nk_set_sched_idle(int (*func)(void))
+{
+	idle_func = func;
+}
+
 void nk_sched_loop()
 {
 	nk_irq_flag_t irq_flag;
+	struct item *first;
+	int idle_done = 0; // Idle function has nothing to do
+#ifdef NK_SCHED_STATS_SIZE
+	nk_time_t start;
+#endif
 
 	nk_startup_message("Begin main loop\n");
 
 	for (;;) {
 		irq_flag = nk_irq_lock(&sched_lock);
+#ifdef NK_SCHED_ISR_SOURCES
+		if (nk_isr_any_pending)
+			drain_isr_sources();
+#endif
+		first = queue_first();
 		// Execute pending work
-		if (queue_not_empty() && (int32_t)(nk_get_time() - queue->next->when) >= 0)
+		if (first && (int32_t)(nk_get_time() - first->when) >= 0)
 		{
 			void (*func)(void *data);
 			void *data;
-			struct item *item = deque(queue->next);
-			func = item->func;
-			data = item->data;
-			current_tid = item->tid;
-			free_item(item);
+#ifdef NK_SCHED_EVENTS
+			if (first->flags & ITEM_FOREVER) {
+				// Waiting for an event with no timeout: push it back
+				first->when += FOREVER_TICKS;
+				queue_requeue(first);
+				nk_irq_unlock(&sched_lock, irq_flag);
+				continue;
+			}
+#endif
+#ifdef NK_SCHED_STATS_SIZE
+			start = nk_get_time();
+			stats_dispatch(first, start);
+#endif
+			func = first->func;
+			data = first->data;
+			current_tid = first->tid;
+#ifdef NK_SCHED_PERIODIC
+			if (first->period) {
+				// Periodic: stays in the queue, advance to next period
+				nk_time_t late = nk_get_time() - first->when;
+				first->when += first->period;
+				if ((first->flags & NK_SCHED_SKIP) && late >= first->period)
+					first->when += (late / first->period) * first->period;
+				queue_requeue(first);
+			} else
+#endif
+			{
+				queue_remove(first);
+				free_item(first);
+			}
 			nk_irq_unlock(&sched_lock, irq_flag);
 			func(data);
+#ifdef NK_SCHED_STATS_SIZE
+			stats_done(current_tid, start);
+#endif
+			idle_done = 0;
+			continue;
+		}
+		else if (idle_func && !idle_done)
+		{
+			// Nothing is due: give the idle function a turn, then check
+			// the queue again
+			nk_irq_unlock(&sched_lock, irq_flag);
+			idle_done = !idle_func();
 			continue;
 		}
 		else
 		{
 			// Set alarm to wake up system for next event
 			// There must be a wake up interrupt, even if the request is for now or in the past
-			if (queue_not_empty())
+			if (first)
 			{
-				nk_sched_wakeup(queue->next->when);
+				nk_sched_wakeup(queue_wakeup(first));
 			}
 			// Enable interrupts and sleep
 			nk_irq_unlock_and_wait(&sched_lock, irq_flag, deepness);
 			// If there are any pending interrupts, the system should wake up
+			idle_done = 0;
 		}
 	}
 }
@@ -41,6 +41,7 @@
 #include <string.h>
 #include "nkscan.h"
 #include "nkprintf.h"
+#include "nkprintf_fp.h"
 #include "nkserialize.h"
 
 // Standard primitive types
@@ -117,10 +118,22 @@ const struct type tyFLOAT = {
 	.check = NULL
 };
 
+// Print floating point with the fewest digits which read back as exactly the
+// same value (same as "%r", or "%hr" if single is set).  flags is FLhash to
+// always include a decimal point or exponent.
+
+static int fprint_fp(nkoutfile_t *f, double val, int single, int flags, const char *ed)
+{
+    char sbuf[32];
+    int len = sizeof(sbuf) - 1;
+    char *pfx = __floatshort('r', flags, &val, sbuf, &len, single);
+    sbuf[len] = 0;
+    return nk_fprintf(f, "%s%s%s", pfx, sbuf, ed);
+}
+
 int nk_dbase_fprint(nkoutfile_t *f, const struct type *type, void *location, int ind, const char *ed)
 {
     int status = 0;
-    char sbuf[32];
     switch (type->what) {
         case tSTRUCT: {
             const struct member *m;
@@ -228,42 +241,14 @@ int nk_dbase_fprint(nkoutfile_t *f, const struct type *type, void *location, int
             status |= nk_fprintf(f, "null%s", ed);
             break; */
         } case tDOUBLE: {
-            int x;
-            // Print double as decimal with enough precision to
-            // recover the original double on read in.
-            // (should be %.17g, but uses too much space)
-            nk_snprintf(sbuf, sizeof(sbuf), "%g", *(double *)location);
-            // %g will omit the decimal point if it can.  But we
-            // always want it.. so add it back.
-            // FIXME: handle nan and inf
-            for (x = 0; sbuf[x]; ++x)
-                if (sbuf[x] == '.' || sbuf[x] == 'e')
-                    break;
-            if (!sbuf[x]) {
-                sbuf[x++] = '.';
-                sbuf[x++] = '0';
-                sbuf[x] = 0;
-            }
-            status |= nk_fprintf(f, "%s%s", sbuf, ed);
+            // FLhash keeps the decimal point, so that it reads back as a
+            // double and not an integer
+            status |= fprint_fp(f, *(double *)location, 0, FLhash, ed);
             break;
         } case tFLOAT: {
-            int x;
-            // Print double as decimal with enough precision to
-            // recover the original double on read in.
-            // (should be %.17g, but uses too much space)
-            nk_snprintf(sbuf, sizeof(sbuf), "%g", *(float *)location);
-            // %g will omit the decimal point if it can.  But we
-            // always want it.. so add it back.
-            // FIXME: handle nan and inf
-            for (x = 0; sbuf[x]; ++x)
-                if (sbuf[x] == '.' || sbuf[x] == 'e')
-                    break;
-            if (!sbuf[x]) {
-                sbuf[x++] = '.';
-                sbuf[x++] = '0';
-                sbuf[x] = 0;
-            }
-            status |= nk_fprintf(f, "%s%s", sbuf, ed);
+            // FLhash keeps the decimal point, so that it reads back as a
+            // float and not an integer
+            status |= fprint_fp(f, *(float *)location, 1, FLhash, ed);
             break;
         } case tINT: {
             status |= nk_fprintf(f, "%d%s", *(int *)location, ed);
@@ -410,10 +395,10 @@ int nk_dbase_serialize(nkoutfile_t *f, const struct type *type, void *location)
 			status |= nk_fprintf(f, "%u", *(unsigned short *)location);
 			break;
 		} case tDOUBLE: {
-			status |= nk_fprintf(f, "%g", *(double *)location);
+			status |= fprint_fp(f, *(double *)location, 0, 0, "");
 			break;
 		} case tFLOAT: {
-			status |= nk_fprintf(f, "%g", *(float *)location);
+			status |= fprint_fp(f, *(float *)location, 1, 0, "");
 			break;
 		} case tSTRING: {
 			char *s = (char *)location;
@@ -535,10 +520,8 @@ static int skip_value(nkinfile_t *f)
 		int c = nk_fpeek(f);
 		size_t org = nk_ftell(f);
 		num = 0;
-		while (c >= '0' && c <= '9') {
-			num = num * 10 + (unsigned)(c - '0');
-			c = nk_fnext_fast(f);
-		}
+		nk_fscan_dec(f, &num, -1);
+		c = nk_fpeek(f);
 		if (c == '.' || c == 'e' || c == 'E') {
 			nk_fseek(f, org);
 			goto DOUBLE;
@@ -549,10 +532,8 @@ static int skip_value(nkinfile_t *f)
 		int c = nk_fnext_fast(f);
 		size_t org = nk_ftell(f);
 		num = 0;
-		while (c >= '0' && c <= '9') {
-			num = num * 10 + (unsigned)(c - '0');
-			c = nk_fnext_fast(f);
-		}
+		nk_fscan_dec(f, &num, -1);
+		c = nk_fpeek(f);
 		if (c == '.' || c == 'e' || c == 'E') {
 			nk_fseek(f, org);
 			goto NEGDOUBLE;
@@ -630,10 +611,8 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				uint64_t num;
 				size_t org = nk_ftell(f);
 				num = 0;
-				while (c >= '0' && c <= '9') {
-					num = num * 10 + (unsigned)(c - '0');
-					c = nk_fnext_fast(f);
-				}
+				nk_fscan_dec(f, &num, -1);
+				c = nk_fpeek(f);
 				if (c == '.' || c == 'e' || c == 'E') {
 					nk_fseek(f, org);
 					goto DOUBLE;
@@ -653,10 +632,8 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				c = nk_fnext_fast(f);
 				org = nk_ftell(f);
 				num = 0;
-				while (c >= '0' && c<= '9') {
-					num = num * 10 + (unsigned)(c - '0');
-					c = nk_fnext_fast(f);
-				}
+				nk_fscan_dec(f, &num, -1);
+				c = nk_fpeek(f);
 				if (c == '.' || c == 'e' || c == 'E') {
 					nk_fseek(f, org);
 					goto NEGDOUBLE;
@@ -714,10 +691,8 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				uint64_t num;
 				size_t org = nk_ftell(f);
 				num = 0;
-				while (c >= '0' && c <= '9') {
-					num = num * 10 + (unsigned)(c - '0');
-					c = nk_fnext_fast(f);
-				}
+				nk_fscan_dec(f, &num, -1);
+				c = nk_fpeek(f);
 				if (c == '.' || c == 'e' || c == 'E') {
 					nk_fseek(f, org);
 					goto DOUBLE1;
@@ -730,17 +705,15 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				c = nk_fnext_fast(f);
 				org = nk_ftell(f);
 				num = 0;
-				while (c >= '0' && c  <= '9') {
-					num = num * 10 + (unsigned)(c - '0');
-					c = nk_fnext_fast(f);
-				}
+				nk_fscan_dec(f, &num, -1);
+				c = nk_fpeek(f);
 				if (c == '.' || c == 'e' || c == 'E') {
 					nk_fseek(f, org);
 					goto NEGDOUBLE1;
 				}
 				*(double *)location = (double)-(int64_t)num;
 				sta = 1;
-			} else if (c == '-' && nk_fseek_rel(f, 1) == '.') {
+			} else if (c == '-' && nk_fpeek_rel(f, 1) == '.') {
 				double val;
 				nk_fnext_fast(f);
 				NEGDOUBLE1:
@@ -753,6 +726,10 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				val = 0.0;
 				sta = nk_fscan_double(f, &val);
 				*(double *)location = (double)val;
+			} else if (c == 'n' || c == 'i' || (c == '-' && nk_fpeek_rel(f, 1) == 'i')) {
+				double val; // nan, inf or -inf
+				sta = nk_fscan_double(f, &val);
+				*(double *)location = (double)val;
 			}
 			break;
 		} case tFLOAT: {
@@ -770,10 +747,8 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				uint64_t num;
 				size_t org = nk_ftell(f);
 				num = 0;
-				while (c >= '0' && c <= '9') {
-					num = num * 10 + (unsigned)(c - '0');
-					c = nk_fnext_fast(f);
-				}
+				nk_fscan_dec(f, &num, -1);
+				c = nk_fpeek(f);
 				if (c == '.' || c == 'e' || c == 'E') {
 					nk_fseek(f, org);
 					goto DOUBLE2;
@@ -786,10 +761,8 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				c = nk_fnext_fast(f);
 				org = nk_ftell(f);
 				num = 0;
-				while (c >= '0' && c <= '0') {
-					num = num * 10 + (unsigned)(c - '0');
-					c = nk_fnext_fast(f);
-				}
+				nk_fscan_dec(f, &num, -1);
+				c = nk_fpeek(f);
 				if (c == '.' || c == 'e' || c == 'E') {
 					nk_fseek(f, org);
 					goto NEGDOUBLE2;
@@ -809,6 +782,10 @@ int nk_fscan_keyval(nkinfile_t *f, const struct type *type, size_t location)
 				val = 0.0;
 				sta = nk_fscan_double(f, &val);
 				*(float *)location = (float)val;
+			} else if (c == 'n' || c == 'i' || (c == '-' && nk_fpeek_rel(f, 1) == 'i')) {
+				double val; // nan, inf or -inf
+				sta = nk_fscan_double(f, &val);
+				*(float *)location = (float)val;
 			}
 			break;
 		} case tSTRING: {
@@ -24,6 +24,7 @@
 #include <string.h>
 #include "nkcli.h"
 #include "nkcrclib.h"
+#include "nkcoroutine.h"
 #include "nkspiflash.h"
 
 int nk_spiflash_write_enable(const struct nk_spiflash_info *info)
@@ -68,6 +69,15 @@ int nk_spiflash_busy_wait(const struct nk_spiflash_info *info)
 	return status;
 }
 
+int nk_spiflash_busy(const struct nk_spiflash_info *info)
+{
+	info->buffer[0] = NK_FLASH_CMD_READ_STATUS;
+	info->buffer[1] = 0;
+	if (info->spi_transfer(info->spi_ptr, info->buffer, 2))
+		return -1;
+	return info->buffer[1] & 1;
+}
+
 int nk_spiflash_erase(const struct nk_spiflash_info *info, uint32_t address, uint32_t byte_count)
 {
 	int status = 0;
@@ -111,6 +121,108 @@ int nk_spiflash_erase(const struct nk_spiflash_info *info, uint32_t address, uin
 	return status;
 }
 
+// Background erase
+
+#ifndef NK_SPIFLASH_ERASE_TIMEOUT
+#define NK_SPIFLASH_ERASE_TIMEOUT 3000 // ms for a single erase command
+#endif
+
+static struct {
+	nk_co_t co;
+	const struct nk_spiflash_info *info;
+	uint32_t address;
+	uint32_t byte_count;
+	uint32_t erase_size;
+	int status;
+	int busy;
+	nk_time_t deadline;
+	void (*done)(void *data, int status);
+	void *data;
+} erase_state;
+
+static uint32_t erase_size(const struct nk_spiflash_info *info, uint32_t address, uint32_t byte_count)
+{
+	int x;
+	for (x = 0; x != info->n_erase_options; ++x)
+		if ((address & (info->erase_options[x].erase_size - 1)) == 0 && byte_count >= info->erase_options[x].erase_size)
+			return info->erase_options[x].erase_size;
+	return 0;
+}
+
+// True when the device is no longer busy or we've given up on it.  Leaves
+// busy set to 1 for timeout, -1 for SPI error.
+
+static int erase_ready(void)
+{
+	erase_state.busy = nk_spiflash_busy(erase_state.info);
+	return erase_state.busy != 1 || (int32_t)(nk_get_time() - erase_state.deadline) >= 0;
+}
+
+static void erase_task(void *data)
+{
+	const struct nk_spiflash_info *info = erase_state.info;
+	(void)data;
+
+	NK_CO_BEGIN(&erase_state.co);
+
+	while (erase_state.byte_count) {
+		int x;
+		int y;
+		uint32_t addr = erase_state.address;
+		erase_state.erase_size = erase_size(info, erase_state.address, erase_state.byte_count);
+		if (!erase_state.erase_size)
+		{
+			nk_printf("ERROR: Invalid erase size\n");
+			erase_state.status = -1;
+			break;
+		}
+		for (x = 0; info->erase_options[x].erase_size != erase_state.erase_size; ++x);
+		erase_state.status |= nk_spiflash_write_enable(info);
+		info->buffer[0] = info->erase_options[x].erase_cmd;
+		for (y = 0; y != info->addr_size; ++y)
+		{
+			info->buffer[info->addr_size - y] = addr;
+			addr >>= 8;
+		}
+		nk_printf("  Erase addr=%lx size=%lu\n", (unsigned long)erase_state.address, (unsigned long)erase_state.erase_size);
+		erase_state.status |= info->spi_transfer(info->spi_ptr, info->buffer, info->addr_size + 1);
+		if (erase_state.status)
+			break;
+
+		// Give the main loop back while the device is busy
+		erase_state.deadline = nk_get_time() + nk_convert_delay(NK_SPIFLASH_ERASE_TIMEOUT);
+		NK_AWAIT_POLL(&erase_state.co, erase_ready(), 1);
+		if (erase_state.busy)
+		{
+			// SPI error or timeout
+			erase_state.status = -1;
+			break;
+		}
+
+		erase_state.address += erase_state.erase_size;
+		erase_state.byte_count -= erase_state.erase_size;
+	}
+
+	if (erase_state.done)
+		erase_state.done(erase_state.data, erase_state.status);
+
+	NK_CO_END(&erase_state.co);
+}
+
+int nk_spiflash_erase_start(const struct nk_spiflash_info *info, uint32_t address, uint32_t byte_count, void (*done)(void *data, int status), void *data)
+{
+	if (nk_co_running(&erase_state.co))
+		return -1;
+	erase_state.info = info;
+	erase_state.address = address;
+	erase_state.byte_count = info->n_erase_options ? byte_count : 0;
+	erase_state.status = 0;
+	erase_state.done = done;
+	erase_state.data = data;
+	nk_co_start(&erase_state.co, erase_task, NULL);
+	return 0;
+}
+
 int nk_spiflash_write(const struct nk_spiflash_info *info, uint32_t address, uint8_t *data, uint32_t byte_count)
 {
 	int status = 0; // Assume success
@@ -241,6 +353,27 @@ uint32_t nk_spiflash_crc(const struct nk_spiflash_info *info, uint32_t addr, uin
     return crc;
 }
 
+// The CLI is held off while the erase runs in the background, so that
+// other tasks keep running
+
+static void erase_command_done(void *data, int status)
+{
+    (void)data;
+    if (status)
+        nk_printf("SPI error\n");
+    nk_printf("done.\n");
+    nk_cli_enable();
+}
+
+static void erase_command(const struct nk_spiflash_info *info, uint32_t addr, uint32_t len)
+{
+    nk_printf("Erasing %"PRIu32" bytes...\n", len);
+    if (nk_spiflash_erase_start(info, addr, len, erase_command_done, NULL))
+        nk_printf("Erase already in progress\n");
+    else
+        nk_cli_disable();
+}
+
 int nk_spiflash_command(const struct nk_spiflash_info *info, nkinfile_t *args)
 {
     int status = 0;
@@ -274,9 +407,7 @@ int nk_spiflash_command(const struct nk_spiflash_info *info, nkinfile_t *args)
     }
     else if (facmode && nk_fscan(args, "erase %"PRIx32" %"PRIx32" ", &addr, &len))
     {
-    	nk_printf("Erasing %"PRIu32" bytes...\n", len);
-        status |= nk_spiflash_erase(info, addr, len);
-        nk_printf("done.\n");
+        erase_command(info, addr, len);
     }
     else if (facmode && nk_fscan(args, "unlock "))
     {
@@ -287,9 +418,7 @@ int nk_spiflash_command(const struct nk_spiflash_info *info, nkinfile_t *args)
     else if (facmode && nk_fscan(args, "erase %"PRIx32" ", &addr))
     {
     	len = 4096;
-    	nk_printf("Erasing %"PRIu32" bytes...\n", len);
-        status |= nk_spiflash_erase(info, addr, len);
-        nk_printf("done.\n");
+        erase_command(info, addr, len);
     }
     else if (facmode && nk_fscan(args, "fill %"PRIx32" %"PRIx32" ", &addr, &len))
     {
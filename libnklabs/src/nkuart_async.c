@@ -0,0 +1,110 @@
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Non-blocking UART read, built on nk_set_uart_callback() and nk_getc() so
+// that it works with any of the UART drivers
+
+#include <stddef.h>
+#include "nksched.h"
+#include "nkuart.h"
+
+static char *read_buf; // Zero when no read is outstanding
+static int read_len;
+static int read_got;
+static uint32_t read_timeout;
+static int read_tid;
+static void (*read_done)(char *buf, int len);
+
+static int timeout_tid;
+
+// Take whatever has arrived
+
+static void read_chars(void)
+{
+	int c;
+	while (read_got != read_len && (c = nk_getc()) != -1)
+		read_buf[read_got++] = (char)c;
+}
+
+static void read_complete(void)
+{
+	char *buf = read_buf;
+	read_buf = 0;
+	nk_unsched(timeout_tid);
+	read_done(buf, read_got);
+}
+
+static void read_timeout_task(void *data);
+
+// Runs on the caller's tid whenever characters are available
+
+static void read_task(void *data)
+{
+	int old_got = read_got;
+	(void)data;
+	if (!read_buf)
+		return;
+	read_chars();
+	if (read_got == read_len) {
+		read_complete();
+	} else {
+		if (read_got != old_got) // Restart timeout
+			nk_sched(timeout_tid, read_timeout_task, NULL, read_timeout, "UART read timeout");
+		nk_set_uart_callback(read_tid, read_task, NULL);
+	}
+}
+
+static void read_timeout_task(void *data)
+{
+	(void)data;
+	if (!read_buf)
+		return;
+	nk_unsched(read_tid); // Stop waiting for characters
+	read_chars(); // In case some just arrived
+	read_complete();
+}
+
+int nk_uart_read_async(char *buf, int len, uint32_t timeout_ms, int tid, void (*done)(char *buf, int len))
+{
+	if (read_buf)
+		return -1;
+	if (!timeout_tid)
+		timeout_tid = nk_alloc_tid();
+	read_buf = buf;
+	read_len = len;
+	read_got = 0;
+	read_timeout = timeout_ms;
+	read_tid = tid;
+	read_done = done;
+	nk_sched(timeout_tid, read_timeout_task, NULL, timeout_ms, "UART read timeout");
+	// Completes right away (from the work queue) if the data is already here
+	nk_sched(tid, read_task, NULL, 0, "UART read");
+	return 0;
+}
+
+void nk_uart_read_cancel()
+{
+	if (read_buf) {
+		read_buf = 0;
+		nk_unsched(timeout_tid);
+		nk_unsched(read_tid);
+	}
+}
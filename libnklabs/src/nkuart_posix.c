@@ -0,0 +1,431 @@
+// POSIX host port: console UART
+
+// Copyright 2020 NK Labs, LLC
+
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+// CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+// OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// The console is stdin/stdout, put into raw mode if it's a terminal.  If the
+// NK_UART_PTY environment variable is set, a pseudo-terminal is opened
+// instead and its name is printed on stderr: connect a terminal program (or
+// sz / rz for YMODEM) to it.
+//
+// When the input reaches end of file (for example, a script piped into
+// stdin), the process exits once all of the input has been read.
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <signal.h>
+#include "nksched.h"
+#include "nkuart.h"
+
+#ifndef NK_SCHED_EVENTS
+#error nkuart_posix.c needs NK_SCHED_EVENTS in nksched_config.h
+#endif
+
+
+// A UART: a pair of file descriptors and an input buffer
+
+struct nk_uart {
+	int in_fd;
+	int out_fd;
+	int in_eof;
+
+	unsigned char rx_buf[NK_UART_RXBUF_SIZE];
+	unsigned int rx_rd;
+	unsigned int rx_wr;
+	int tty_mode;
+	uint32_t baud; // Zero if not a terminal, or at a speed we don't know
+
+	// The kernel buffers input for us, so nothing is ever lost here: only
+	// the high-water mark means anything
+	nk_uart_stats_t stats;
+
+	// Signaled when rx data is available
+	nk_event_t rx_event;
+};
+
+// The console
+
+nk_uart_t nk_uart0 = {
+	.in_fd = 0,
+	.out_fd = 1,
+	.rx_event = NK_EVENT_INIT
+};
+
+static int saved_flags;
+static int saved_termios_valid;
+static struct termios saved_termios;
+
+nk_spinlock_t console_lock = SPIN_LOCK_UNLOCKED;
+
+void nk_uart_set_callback(nk_uart_t *u, int tid, void (*func)(void *data), void *data)
+{
+	nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
+	if (u->rx_rd != u->rx_wr) {
+		// Data is available now
+		nk_sched(tid, func, data, 0, "UART ISR");
+	} else if (u->in_eof) {
+		// Nothing more is coming
+		exit(0);
+	} else {
+		nk_event_wait(&u->rx_event, tid, func, data, NK_EVENT_FOREVER, "UART ISR");
+	}
+	nk_irq_unlock(&console_lock, irq_flag);
+}
+
+int nk_uart_get_mode(nk_uart_t *u)
+{
+	return u->tty_mode;
+}
+
+int nk_uart_set_mode(nk_uart_t *u, int new_mode)
+{
+	int old_mode = u->tty_mode;
+	u->tty_mode = new_mode;
+	return old_mode;
+}
+
+static void out_write(nk_uart_t *u, const char *s, size_t len)
+{
+	while (len) {
+		ssize_t rtn = write(u->out_fd, s, len);
+		if (rtn <= 0)
+			return;
+		s += rtn;
+		len -= (size_t)rtn;
+	}
+}
+
+void nk_uart_putc(nk_uart_t *u, char ch)
+{
+	if (!u->tty_mode && ch == '\n')
+		out_write(u, "\r\n", 2);
+	else
+		out_write(u, &ch, 1);
+}
+
+void nk_uart_puts(nk_uart_t *u, const char *s)
+{
+	nk_uart_send(u, s, (int)strlen(s));
+}
+
+// Write in blocks to keep the number of system calls down
+
+void nk_uart_send(nk_uart_t *u, const char *s, int len)
+{
+	char buf[256];
+	size_t n = 0;
+	while (len--) {
+		if (n >= sizeof(buf) - 1) {
+			out_write(u, buf, n);
+			n = 0;
+		}
+		if (!u->tty_mode && *s == '\n')
+			buf[n++] = '\r';
+		buf[n++] = *s++;
+	}
+	out_write(u, buf, n);
+}
+
+void nk_uart_drain(nk_uart_t *u)
+{
+	// Output is written directly, just wait for a terminal to send it
+	if (isatty(u->out_fd))
+		tcdrain(u->out_fd);
+}
+
+// Speeds a terminal can be set to
+
+static const struct {
+	uint32_t baud;
+	speed_t speed;
+} speeds[] = {
+	{ 2400, B2400 },
+	{ 4800, B4800 },
+	{ 9600, B9600 },
+	{ 19200, B19200 },
+	{ 38400, B38400 },
+	{ 57600, B57600 },
+	{ 115200, B115200 },
+	{ 230400, B230400 },
+#ifdef B460800
+	{ 460800, B460800 },
+	{ 500000, B500000 },
+	{ 921600, B921600 },
+	{ 1000000, B1000000 },
+#endif
+};
+
+// Look up rate in the table: index, or -1 if the terminal can't use it
+
+static int find_speed(nk_uart_t *u, uint32_t baud)
+{
+	size_t x;
+	if (!u->baud)
+		return -1; // Not a terminal
+	for (x = 0; x != sizeof(speeds) / sizeof(speeds[0]); ++x)
+		if (speeds[x].baud == baud)
+			return (int)x;
+	return -1;
+}
+
+int nk_uart_check_baud(nk_uart_t *u, uint32_t baud)
+{
+	return find_speed(u, baud) == -1 ? -1 : 0;
+}
+
+int nk_uart_set_baud(nk_uart_t *u, uint32_t baud)
+{
+	struct termios t;
+	int x = find_speed(u, baud);
+	if (x == -1 || tcgetattr(u->out_fd, &t))
+		return -1;
+	cfsetispeed(&t, speeds[x].speed);
+	cfsetospeed(&t, speeds[x].speed);
+	// Finish sending at the old rate
+	if (tcsetattr(u->out_fd, TCSADRAIN, &t))
+		return -1;
+	u->baud = baud;
+	return 0;
+}
+
+uint32_t nk_uart_get_baud(nk_uart_t *u)
+{
+	return u->baud;
+}
+
+// Transfer any available characters to the input buffer
+
+static void rx_chars(nk_uart_t *u)
+{
+	while (!u->in_eof && u->rx_wr - u->rx_rd != sizeof(u->rx_buf)) {
+		unsigned int ofst = u->rx_wr & (sizeof(u->rx_buf) - 1);
+		size_t len = sizeof(u->rx_buf) - (u->rx_wr - u->rx_rd);
+		ssize_t rtn;
+		if (len > sizeof(u->rx_buf) - ofst)
+			len = sizeof(u->rx_buf) - ofst;
+		rtn = read(u->in_fd, u->rx_buf + ofst, len);
+		if (rtn == 0)
+			u->in_eof = 1;
+		if (rtn <= 0)
+			break;
+		u->rx_wr += (unsigned int)rtn;
+		if (u->rx_wr - u->rx_rd > u->stats.high_water)
+			u->stats.high_water = (uint16_t)(u->rx_wr - u->rx_rd);
+	}
+}
+
+// "Interrupt handler": called from nk_irq_unlock_and_wait() when the input
+// is readable
+
+static void uart0_irq_handler(void)
+{
+	nk_uart_t *u = &nk_uart0;
+	rx_chars(u);
+	if (u->rx_rd != u->rx_wr || u->in_eof)
+		nk_event_signal(&u->rx_event);
+}
+
+int nk_uart_getc(nk_uart_t *u)
+{
+	int ch = -1;
+	if (u->rx_rd == u->rx_wr)
+		rx_chars(u);
+	if (u->rx_rd != u->rx_wr) {
+		ch = u->rx_buf[u->rx_rd++ & (sizeof(u->rx_buf) - 1)];
+	}
+	return ch;
+}
+
+int nk_uart_kbhit(nk_uart_t *u)
+{
+	if (u->rx_rd == u->rx_wr)
+		rx_chars(u);
+	return u->rx_rd != u->rx_wr;
+}
+
+void nk_uart_stats(nk_uart_t *u, nk_uart_stats_t *stats, int clear)
+{
+	*stats = u->stats;
+	if (clear) {
+		memset(&u->stats, 0, sizeof(u->stats));
+		u->stats.high_water = (uint16_t)(u->rx_wr - u->rx_rd);
+	}
+}
+
+int nk_uart_recv(nk_uart_t *u, char *s, int len, uint32_t timeout)
+{
+	int l = 0;
+	int need_time = 1;
+	nk_time_t old_time = 0;
+	nk_time_t clocks = nk_convert_delay(timeout);
+	while (l != len) {
+		int c = nk_uart_getc(u);
+		if (c != -1) {
+			s[l++] = (char)c;
+			need_time = 1;
+		} else if (u->in_eof) {
+			break;
+		} else {
+			if (need_time) {
+				old_time = nk_get_time();
+				need_time = 0;
+			}
+			if ((nk_get_time() - old_time) >= clocks)
+				break;
+		}
+	}
+	return l;
+}
+
+// Put the console back the way we found it
+
+static void restore_console(void)
+{
+	if (saved_termios_valid)
+		tcsetattr(nk_uart0.in_fd, TCSANOW, &saved_termios);
+	fcntl(nk_uart0.in_fd, F_SETFL, saved_flags);
+}
+
+// Ctrl-C still works: leave the terminal usable
+
+static void quit_signal(int sig)
+{
+	restore_console();
+	_exit(128 + sig);
+}
+
+// Only the console exists here
+
+void nk_uart_init(nk_uart_t *u)
+{
+	struct termios raw;
+	if (u != &nk_uart0)
+		return;
+	if (getenv("NK_UART_PTY")) {
+		int fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (fd == -1 || grantpt(fd) || unlockpt(fd)) {
+			perror("posix_openpt");
+			exit(1);
+		}
+		fprintf(stderr, "Console on %s\n", ptsname(fd));
+		// Keep the slave side open ourselves, otherwise the master
+		// reports hang-up until a terminal program opens it
+		if (open(ptsname(fd), O_RDWR | O_NOCTTY) == -1) {
+			perror(ptsname(fd));
+			exit(1);
+		}
+		u->in_fd = u->out_fd = fd;
+		// No echo or line editing on the pseudo-terminal
+		if (!tcgetattr(fd, &raw)) {
+			cfmakeraw(&raw);
+			tcsetattr(fd, TCSANOW, &raw);
+		}
+	} else if (isatty(u->in_fd) && !tcgetattr(u->in_fd, &saved_termios)) {
+		// Raw mode, but keep Ctrl-C
+		saved_termios_valid = 1;
+		raw = saved_termios;
+		cfmakeraw(&raw);
+		raw.c_lflag |= ISIG;
+		tcsetattr(u->in_fd, TCSANOW, &raw);
+	}
+	if (isatty(u->out_fd) && !tcgetattr(u->out_fd, &raw)) {
+		size_t x;
+		for (x = 0; x != sizeof(speeds) / sizeof(speeds[0]); ++x)
+			if (speeds[x].speed == cfgetospeed(&raw))
+				u->baud = speeds[x].baud;
+	}
+	saved_flags = fcntl(u->in_fd, F_GETFL);
+	fcntl(u->in_fd, F_SETFL, saved_flags | O_NONBLOCK);
+	atexit(restore_console);
+	signal(SIGINT, quit_signal);
+	signal(SIGTERM, quit_signal);
+	nk_posix_irq_fd(u->in_fd, uart0_irq_handler);
+}
+
+// The console functions use nk_uart0
+
+void nk_set_uart_callback(int tid, void (*func)(void *data), void *data)
+{
+	nk_uart_set_callback(&nk_uart0, tid, func, data);
+}
+
+int nk_get_uart_mode()
+{
+	return nk_uart_get_mode(&nk_uart0);
+}
+
+int nk_set_uart_mode(int new_mode)
+{
+	return nk_uart_set_mode(&nk_uart0, new_mode);
+}
+
+void nk_putc(char ch)
+{
+	nk_uart_putc(&nk_uart0, ch);
+}
+
+void nk_puts(const char *s)
+{
+	nk_uart_puts(&nk_uart0, s);
+}
+
+void nk_uart_write(const char *s, int len)
+{
+	nk_uart_send(&nk_uart0, s, len);
+}
+
+void nk_uart_flush()
+{
+	nk_uart_drain(&nk_uart0);
+}
+
+int nk_getc()
+{
+	return nk_uart_getc(&nk_uart0);
+}
+
+int nk_kbhit()
+{
+	return nk_uart_kbhit(&nk_uart0);
+}
+
+void nk_uart_get_stats(nk_uart_stats_t *stats, int clear)
+{
+	nk_uart_stats(&nk_uart0, stats, clear);
+}
+
+int nk_uart_read(char *s, int len, uint32_t timeout)
+{
+	return nk_uart_recv(&nk_uart0, s, len, timeout);
+}
+
+void nk_init_uart()
+{
+	nk_uart_init(&nk_uart0);
+}
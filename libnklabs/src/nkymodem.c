@@ -29,10 +29,16 @@
 #include "nkcli.h"
 #include "nkchecked.h"
 #include "nksched.h"
+#include "nkcoroutine.h"
 #include "nkymodem.h"
 
 static int timeout_tid;
 
+// Coroutine which finishes a transfer: send or receive, one at a time
+
+static nk_co_t finish_co;
+static int finish_sta;
+
 // Index into packet_buf for saving multiple packets for debugging
 
 static size_t last_idx;
@@ -144,14 +150,17 @@ static void ymodem_prepare_fin()
 
 static int ymodem_prepare_next(nkinfile_t *file)
 {
-    int x;
-    // Load next block
-    for (x = 0; x != 128; ++x)
+    size_t x = 0;
+    // Load next block, a span at a time
+    while (x != 128 && !nk_feof(file))
     {
-        int c = nk_fgetc(file);
-        if (c == -1)
-            break;
-        packet_buf[3 + x] = (unsigned char)c;
+        const unsigned char *e = nk_fspan_end(file);
+        size_t len = (size_t)(e - file->ptr);
+        if (len > 128 - x)
+            len = 128 - x;
+        memcpy(packet_buf + 3 + x, file->ptr, len);
+        x += len;
+        nk_fspan_next(file, file->ptr + len);
     }
     if (x == 0)
         return 0; // Nothing more to send
@@ -166,9 +175,7 @@ static int ymodem_prepare_next(nkinfile_t *file)
 
 static void ymodem_send_block()
 {
-    size_t x;
-    for (x = 0; x != ymodem_send_block_size; ++x)
-        nk_putc(packet_buf[x]);
+    nk_uart_write((const char *)packet_buf, ymodem_send_block_size);
 }
 
 // Send a file event-
@@ -258,6 +265,37 @@ static int nk_ysend_evt(nkinfile_t *ysend_file, unsigned char c)
     return status;
 }
 
+// Print final message once the other end has had time to restore its
+// terminal
+
+static void ymodem_send_finish(void *data)
+{
+    (void)data;
+    NK_CO_BEGIN(&finish_co);
+
+    // Delay to allow other end to restore terminal
+    NK_AWAIT_DELAY(&finish_co, 1000);
+    nk_printf("\n");
+
+    if (finish_sta == YMODEM_SEND_STATUS_CANCEL)
+    {
+        nk_printf("Transfer canceled.\n");
+    }
+    else if (finish_sta == YMODEM_SEND_STATUS_DONE)
+    {
+        nk_printf("Transfer complete.\n");
+    }
+    else
+    {
+        nk_printf("Unknown status\n");
+    }
+
+    // Re-enable CLI on UART
+    nk_cli_enable();
+
+    NK_CO_END(&finish_co);
+}
+
 // This is the UART callback function
 
 
@@ -285,25 +323,8 @@ static void ymodem_send_task(void *data)
         nk_set_uart_mode(0);
         // async_log_set(ymodem_async);
 
-        // Delay to allow other end to restore terminal
-        nk_udelay(1000000);
-        nk_printf("\n");
-
-        if (sta == YMODEM_SEND_STATUS_CANCEL)
-        {
-            nk_printf("Transfer canceled.\n");
-        }
-        else if (sta == YMODEM_SEND_STATUS_DONE)
-        {
-            nk_printf("Transfer complete.\n");
-        }
-        else
-        {
-            nk_printf("Unknown status\n");
-        }
-
-        // Re-enable CLI on UART
-        nk_cli_enable();
+        finish_sta = sta;
+        nk_co_start(&finish_co, ymodem_send_finish, NULL);
     }
 }
 
@@ -697,6 +718,8 @@ char TIMEOUT[] = "timeout!";
 
 extern nk_checked_t ymodem_file;
 
+static void ymodem_recv_finish(void *data);
+
 static int process_full_outer()
 {
     int sta = ymodem_rcv(nk_yrecv_s->packet_buffer + last_idx, yrecv_len);
@@ -722,37 +745,51 @@ static int process_full_outer()
         // Restore NL->CR-LF mode
         nk_set_uart_mode(0);
 
-        // Time for other end to restore tty
-        nk_udelay(1000000);
+        finish_sta = sta;
+        nk_co_start(&finish_co, ymodem_recv_finish, NULL);
+        return 1;
+    }
+}
 
-        // Re-enable background messages
-        // async_log_set(async);
+// Print final message once the other end has had time to restore its
+// terminal
 
-        nk_printf("\n");
+static void ymodem_recv_finish(void *data)
+{
+    (void)data;
+    NK_CO_BEGIN(&finish_co);
 
-        // Print message
+    // Time for other end to restore tty
+    NK_AWAIT_DELAY(&finish_co, 1000);
 
-        switch (sta) {
-            case YMODEM_RECV_DONE: {
-                nk_printf("Transfer complete: %"PRIu32" bytes\n", ymodem_file.size);
-                nk_yrecv_s->all_done();
-                break;
-            } case YMODEM_RECV_REMOTE_CANCEL: {
-                nk_printf("Canceled after %"PRIu32" bytes\n", ymodem_file.size);
-                break;
-            } case YMODEM_RECV_OPEN_CANCEL: {
-                nk_printf("Canceled after %"PRIu32" bytes (couldn't open file)\n", ymodem_file.size);
-                break;
-            } default: {
-                nk_printf("YMODEM error code %d after %"PRIu32" bytes\n", sta, ymodem_file.size);
-                break;
-            }
-        }
+    // Re-enable background messages
+    // async_log_set(async);
 
-        // Re-enable CLI on UART
-        nk_cli_enable();
-        return 1;
+    nk_printf("\n");
+
+    // Print message
+
+    switch (finish_sta) {
+        case YMODEM_RECV_DONE: {
+            nk_printf("Transfer complete: %"PRIu32" bytes\n", ymodem_file.size);
+            nk_yrecv_s->all_done();
+            break;
+        } case YMODEM_RECV_REMOTE_CANCEL: {
+            nk_printf("Canceled after %"PRIu32" bytes\n", ymodem_file.size);
+            break;
+        } case YMODEM_RECV_OPEN_CANCEL: {
+            nk_printf("Canceled after %"PRIu32" bytes (couldn't open file)\n", ymodem_file.size);
+            break;
+        } default: {
+            nk_printf("YMODEM error code %d after %"PRIu32" bytes\n", finish_sta, ymodem_file.size);
+            break;
+        }
     }
+
+    // Re-enable CLI on UART
+    nk_cli_enable();
+
+    NK_CO_END(&finish_co);
 }
 
 // Buffer full packet, then call ymodem_rcv
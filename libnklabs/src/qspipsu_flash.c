@@ -2901,3 +2901,11 @@ int nk_mcuflash_read(const void *info, uint32_t address, uint8_t *data, size_t b
 		rtn = -1;
 	return rtn;
 }
+
+const uint8_t *nk_mcuflash_map(const void *info, uint32_t address)
+{
+	(void)info;
+	(void)address;
+	// QSPI flash is read with commands
+	return NULL;
+}
@@ -166,6 +166,89 @@ struct testtop testtop = {
 
 struct testtop tryit;
 
+// Flash memory for save/load tests: writes can only clear bits and must be
+// aligned to 8 bytes (the checked file header is 8 bytes)
+
+static unsigned char test_flash[8192];
+
+static int test_flash_read(const void *info, uint32_t addr, uint8_t *buf, size_t size)
+{
+    (void)info;
+    memcpy(buf, test_flash + addr, size);
+    return 0;
+}
+
+static int test_flash_erase(const void *info, uint32_t addr, uint32_t size)
+{
+    (void)info;
+    memset(test_flash + addr, 0xFF, size);
+    return 0;
+}
+
+static int test_flash_write(const void *info, uint32_t addr, const uint8_t *buf, size_t size)
+{
+    size_t x;
+    (void)info;
+    if ((addr | size) & 7)
+        return -1;
+    for (x = 0; x != size; ++x)
+        test_flash[addr + x] &= buf[x];
+    return 0;
+}
+
+#define TEST_BANK(base, gran) { \
+    .area_size = 4096, \
+    .area_base = (base), \
+    .erase_size = 256, \
+    .info = NULL, \
+    .flash_read = test_flash_read, \
+    .flash_erase = test_flash_erase, \
+    .flash_write = test_flash_write, \
+    .granularity = (gran) \
+}
+
+static unsigned char test_buf[128];
+
+static const struct nk_dbase dbase_8 = {
+    .ty = &tyTESTTOP,
+    .bank0 = TEST_BANK(0, 8),
+    .bank1 = TEST_BANK(4096, 8),
+    .buf = test_buf,
+    .buf_size = 64,
+    .buf_blocks = 2,
+    .flash_granularity = 8,
+    .verbose = 1
+};
+
+static const struct nk_dbase dbase_64 = {
+    .ty = &tyTESTTOP,
+    .bank0 = TEST_BANK(0, 64),
+    .bank1 = TEST_BANK(4096, 64),
+    .buf = test_buf,
+    .buf_size = 64,
+    .buf_blocks = 2,
+    .flash_granularity = 64
+};
+
+// Save twice (so both banks are used), then load it back
+
+static void test_save_load(const struct nk_dbase *dbase)
+{
+    char rev = 0;
+    int sta;
+    memset(test_flash, 0xFF, sizeof(test_flash));
+    sta = nk_dbase_save(dbase, &rev, &testtop);
+    sta |= nk_dbase_save(dbase, &rev, &testtop);
+    memset(&tryit, 0, sizeof(tryit));
+    rev = 0;
+    sta |= nk_dbase_load(dbase, &rev, &tryit);
+    nk_printf("Save/load status = %d, rev = %d\n", sta, rev);
+    if (memcmp(&tryit, &testtop, sizeof(struct testtop)))
+        printf("Mismatch!\n");
+    else
+        printf("They match!\n");
+}
+
 int main(int argc, char *argv[])
 {
     // Serialized format
@@ -186,4 +269,10 @@ int main(int argc, char *argv[])
         printf("Mismatch!\n");
     else
         printf("They match!\n");
+
+    nk_printf("Granularity 8:\n");
+    test_save_load(&dbase_8);
+
+    nk_printf("Granularity 64:\n");
+    test_save_load(&dbase_64);
 }
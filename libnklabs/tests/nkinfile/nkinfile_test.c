@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "nkinfile.h"
+#include "nkscan.h"
 
 size_t my_block_read_1(void *block_read_ptr, size_t offset, unsigned char *buffer, size_t size)
 {
@@ -38,6 +39,240 @@ size_t my_block_read_2(void *block_read_ptr, size_t offset, unsigned char *buffe
     }
 }
 
+// Read up to size bytes of a string
+
+size_t my_block_read_n(void *block_read_ptr, size_t offset, unsigned char *buffer, size_t size)
+{
+    char *t = (char *)block_read_ptr;
+    size_t l = strlen(t);
+
+    if (offset >= l)
+        return 0;
+    if (size > l - offset)
+        size = l - offset;
+    memcpy(buffer, t + offset, size);
+    return size;
+}
+
+// Spans of a file read in 4 byte blocks: scanned runs cross block boundaries
+
+void test_spans(void)
+{
+    unsigned char buf[4];
+    char word[32];
+    nkinfile_t f;
+    uint64_t val;
+    const unsigned char *p, *e;
+
+    printf("Spans, nk_fspan_end/nk_fspan_next: ");
+    nkinfile_open(&f, my_block_read_n, "Hello world!", 4, buf);
+    do {
+        p = f.ptr;
+        e = nk_fspan_end(&f);
+        printf("[");
+        while (p != e)
+            printf("%c", *p++);
+        printf("]");
+    } while (nk_fspan_next(&f, p));
+    printf(" eof=%d\n", nk_feof(&f));
+
+    printf("Spans, stop mid span: ");
+    nkinfile_open(&f, my_block_read_n, "abcdefgh", 4, buf);
+    nk_fseek(&f, 1);
+    p = f.ptr;
+    e = nk_fspan_end(&f);
+    p += 2;
+    printf("more=%d ", nk_fspan_next(&f, p));
+    printf("tell=%zu next=%c\n", nk_ftell(&f), nk_fpeek(&f));
+
+    printf("Spans, digit run across blocks: ");
+    nkinfile_open(&f, my_block_read_n, "ab 1234567890123 z", 4, buf);
+    nk_fseek(&f, 3);
+    if (nk_fscan_dec(&f, &val, -1))
+        printf("%llu rest=", (unsigned long long)val);
+    else
+        printf("Bad return ");
+    nk_infile_print(&f); printf("\n");
+
+    printf("Spans, digit run ending at block end: ");
+    nkinfile_open(&f, my_block_read_n, "x 123456 y", 4, buf);
+    nk_fseek(&f, 2);
+    if (nk_fscan_dec(&f, &val, -1))
+        printf("%llu rest=", (unsigned long long)val);
+    else
+        printf("Bad return ");
+    nk_infile_print(&f); printf("\n");
+
+    printf("Spans, hex run to EOF: ");
+    nkinfile_open(&f, my_block_read_n, "0xdeadbeef12", 4, buf);
+    nk_fseek(&f, 2);
+    if (nk_fscan_hex(&f, &val, -1))
+        printf("%llx eof=%d\n", (unsigned long long)val, nk_feof(&f));
+    else
+        printf("Bad return\n");
+
+    printf("Spans, word across blocks: ");
+    nkinfile_open(&f, my_block_read_n, "  this-is-a-long-word next", 4, buf);
+    nk_fscan_ws(&f);
+    if (nk_fscan_word(&f, word, -1, sizeof(word)))
+        printf("%s rest=", word);
+    else
+        printf("Bad return ");
+    nk_infile_print(&f); printf("\n");
+
+    printf("Spans, word truncated to buffer: ");
+    nkinfile_open(&f, my_block_read_n, "abcdefghij k", 4, buf);
+    if (nk_fscan_word(&f, word, -1, 6))
+        printf("%s rest=", word);
+    else
+        printf("Bad return ");
+    nk_infile_print(&f); printf("\n");
+
+    printf("Spans, quoted string across blocks: ");
+    nkinfile_open(&f, my_block_read_n, "x\"quoted string\\\"with escape\" rest", 4, buf);
+    nk_fseek(&f, 1);
+    if (nk_fscan_word(&f, word, -1, sizeof(word)))
+        printf("%s rest=", word);
+    else
+        printf("Bad return ");
+    nk_infile_print(&f); printf("\n");
+
+    printf("Spans, unterminated quoted string: ");
+    nkinfile_open(&f, my_block_read_n, "\"no end", 4, buf);
+    if (nk_fscan_word(&f, word, -1, sizeof(word)))
+        printf("Bad return\n");
+    else
+        printf("rejected, tell=%zu\n", nk_ftell(&f));
+
+    printf("Spans, nk_fscan across blocks: ");
+    nkinfile_open(&f, my_block_read_n, "count=123456 name=\"a b c d e\"", 4, buf);
+    {
+        int n;
+        if (nk_fscan(&f, "count=%d name=%w", &n, word, sizeof(word)))
+            printf("%d %s\n", n, word);
+        else
+            printf("Bad return\n");
+    }
+}
+
+// Block windows: log each block read and prefetch
+
+const char *window_text;
+
+size_t my_window_read(void *block_read_ptr, size_t offset, unsigned char *buffer, size_t size)
+{
+    printf(" r%zu", offset);
+    return my_block_read_n((void *)window_text, offset, buffer, size);
+}
+
+void my_window_prefetch(void *block_read_ptr, size_t offset, unsigned char *buffer, size_t size)
+{
+    printf(" p%zu", offset);
+}
+
+void window_stats(nkinfile_window_t *w)
+{
+    size_t x;
+    printf(" | reads=%zu hits=%zu rereads=%zu blocks:", w->reads, w->hits, w->rereads);
+    for (x = 0; x != w->nblocks; ++x)
+        if (w->pos[x] == NKINFILE_EMPTY)
+            printf(" -");
+        else
+            printf(" %zu", w->pos[x]);
+    printf("\n");
+}
+
+void window_seek_to(nkinfile_t *f, nkinfile_window_t *w, size_t pos)
+{
+    int c;
+    printf("  seek %zu:", pos);
+    c = nk_fseek(f, pos);
+    if (c == -1)
+        printf(" EOF");
+    else
+        printf(" '%c'", c);
+    window_stats(w);
+}
+
+void test_window(void)
+{
+    unsigned char buf[6 * 4];
+    nkinfile_window_t w;
+    nkinfile_t f;
+    int c;
+
+    window_text = "0123456789abcdefghij"; // 20 bytes: 5 blocks of 4
+
+    printf("Window 2, read forward:");
+    nkinfile_open_window(&f, my_window_read, NULL, NULL, 4, buf, 2, &w);
+    printf(" ");
+    while ((c = nk_fgetc(&f)) != -1)
+        printf("%c", c);
+    window_stats(&w);
+
+    printf("Window 2, seek back:\n");
+    window_seek_to(&f, &w, 13); // Gone: reaching EOF read (empty) block 20
+    window_seek_to(&f, &w, 18); // Evicts block 20, not the current block
+    window_seek_to(&f, &w, 5); // Evicts block 16
+    window_seek_to(&f, &w, 9); // Evicts block 12
+    window_seek_to(&f, &w, 4); // Hit
+
+    printf("Window 3, lowest offset is reused:");
+    nkinfile_open_window(&f, my_window_read, NULL, NULL, 4, buf, 3, &w);
+    window_stats(&w);
+    window_seek_to(&f, &w, 4);
+    window_seek_to(&f, &w, 8);
+    window_seek_to(&f, &w, 12); // Evicts block 0
+    window_seek_to(&f, &w, 5); // Hit
+    window_seek_to(&f, &w, 0); // Evicts block 8, not the current block 4
+
+    printf("Window 6 is clamped:");
+    nkinfile_open_window(&f, my_window_read, NULL, NULL, 4, buf, 6, &w);
+    printf(" nblocks=%zu", w.nblocks);
+    window_stats(&w);
+
+    window_text = "0123456789"; // EOF inside third block
+    printf("Window 2, EOF inside a block:");
+    nkinfile_open_window(&f, my_window_read, NULL, NULL, 4, buf, 2, &w);
+    window_stats(&w);
+    window_seek_to(&f, &w, 9);
+    window_seek_to(&f, &w, 10);
+    printf("  eof=%d\n", nk_feof(&f));
+    window_seek_to(&f, &w, 12);
+    window_seek_to(&f, &w, 3);
+
+    window_text = "0123456789ab"; // EOF at a block boundary
+    printf("Window 2, EOF at block boundary:");
+    nkinfile_open_window(&f, my_window_read, NULL, NULL, 4, buf, 2, &w);
+    window_stats(&w);
+    window_seek_to(&f, &w, 11);
+    window_seek_to(&f, &w, 12);
+    printf("  eof=%d\n", nk_feof(&f));
+    window_seek_to(&f, &w, 8);
+
+    window_text = "0123456789abcdefghij";
+    printf("Window 2 with prefetch (not used):");
+    nkinfile_open_window(&f, my_window_read, my_window_prefetch, NULL, 4, buf, 2, &w);
+    window_stats(&w);
+    window_seek_to(&f, &w, 4);
+    window_seek_to(&f, &w, 3);
+
+    printf("Window 3 with prefetch:");
+    nkinfile_open_window(&f, my_window_read, my_window_prefetch, NULL, 4, buf, 3, &w);
+    window_stats(&w);
+    window_seek_to(&f, &w, 4); // Prefetched: completed by a read
+    window_seek_to(&f, &w, 3); // Previous block still there
+    window_seek_to(&f, &w, 16); // Not in window: read, prefetch block 20
+    window_seek_to(&f, &w, 20); // Prefetched block at EOF is empty
+    window_seek_to(&f, &w, 19); // Hit, block 20 is already there
+
+    window_text = "0123456789"; // Short last block
+    printf("Window 3 with prefetch, short last block:");
+    nkinfile_open_window(&f, my_window_read, my_window_prefetch, NULL, 4, buf, 3, &w);
+    window_stats(&w);
+    window_seek_to(&f, &w, 8); // Short block: nothing follows it, no prefetch
+}
+
 int main(int argc, char *argv[])
 {
     unsigned char buf[2];
@@ -178,5 +413,9 @@ int main(int argc, char *argv[])
     printf("..check eof: %d\n", nk_fpeek_rel(&f, x));
     printf("..check currnt: %c\n", nk_fpeek(&f));
 
+    test_spans();
+
+    test_window();
+
     return 0;
 }
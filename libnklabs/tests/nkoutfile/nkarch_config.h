@@ -0,0 +1,5 @@
+// Host build for the nkoutfile test
+
+#include <stdint.h>
+
+#define NK_FLASH
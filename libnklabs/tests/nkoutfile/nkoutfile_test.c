@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include "nkoutfile.h"
+#include "nkchecked.h"
+
+// Test data: each byte is different so misplaced bytes show up
+
+static unsigned char data[256];
+
+// Everything written by the block write functions ends up here
+
+static unsigned char out[256];
+static size_t out_len;
+
+static int rec_write(void *ptr, unsigned char *buf, size_t len)
+{
+    (void)ptr;
+    printf("  block_write %zu\n", len);
+    memcpy(out + out_len, buf, len);
+    out_len += len;
+    return 0;
+}
+
+static int rec_writev(void *ptr, const struct nkoutfile_seg *seg, size_t nseg)
+{
+    size_t x;
+    (void)ptr;
+    printf("  block_writev");
+    for (x = 0; x != nseg; ++x) {
+        printf(" %zu", seg[x].len);
+        memcpy(out + out_len, seg[x].ptr, seg[x].len);
+        out_len += seg[x].len;
+    }
+    printf("\n");
+    return 0;
+}
+
+static void check_out(size_t len)
+{
+    if (memcmp(out, data, len))
+        printf("  Mismatch!\n");
+    else
+        printf("  Output matches, %zu bytes written\n", out_len);
+}
+
+// Write data in pieces of the given sizes, then flush
+
+static void test_fwrite(const char *name, nkoutfile_t *f, const size_t *pieces, size_t npieces)
+{
+    size_t x;
+    size_t offset = 0;
+    printf("%s:\n", name);
+    out_len = 0;
+    for (x = 0; x != npieces; ++x) {
+        printf(" nk_fwrite %zu\n", pieces[x]);
+        if (nk_fwrite(f, data + offset, pieces[x]))
+            printf("  Error!\n");
+        offset += pieces[x];
+    }
+    printf(" nk_fflush\n");
+    if (nk_fflush(f))
+        printf("  Error!\n");
+    check_out(offset);
+}
+
+// Flash memory for nk_checked tests: writes must be aligned to the granularity
+
+static unsigned char test_flash[1024];
+
+static int test_flash_read(const void *info, uint32_t addr, uint8_t *buf, size_t size)
+{
+    (void)info;
+    memcpy(buf, test_flash + addr, size);
+    return 0;
+}
+
+static int test_flash_erase(const void *info, uint32_t addr, uint32_t size)
+{
+    (void)info;
+    memset(test_flash + addr, 0xFF, size);
+    return 0;
+}
+
+static int test_flash_write(const void *info, uint32_t addr, const uint8_t *buf, size_t size)
+{
+    const size_t *gran = (const size_t *)info;
+    size_t x;
+    printf("  flash_write %u %zu\n", (unsigned)addr, size);
+    if ((addr | size) & (*gran - 1))
+    {
+        printf("  Misaligned write!\n");
+        return -1;
+    }
+    for (x = 0; x != size; ++x)
+        test_flash[addr + x] &= buf[x];
+    return 0;
+}
+
+static const size_t gran_8 = 8;
+static const size_t gran_64 = 64;
+
+#define TEST_BANK(base, gran) { \
+    .area_size = 512, \
+    .area_base = (base), \
+    .erase_size = 64, \
+    .info = &(gran), \
+    .flash_read = test_flash_read, \
+    .flash_erase = test_flash_erase, \
+    .flash_write = test_flash_write, \
+    .granularity = (gran) \
+}
+
+static const nk_checked_base_t bank_a = TEST_BANK(0, gran_8);
+static const nk_checked_base_t bank_b = TEST_BANK(512, gran_8);
+static const nk_checked_base_t bank_64 = TEST_BANK(0, gran_64);
+
+// Check that a file reads back as the test data
+
+static void check_file(const nk_checked_base_t *bank, size_t len)
+{
+    nk_checked_t var_file;
+    unsigned char buf[16];
+    unsigned char back[256];
+    if (nk_checked_read_open(&var_file, bank, buf, sizeof(buf)))
+        printf("  Read open failed!\n");
+    else if (var_file.size != len)
+        printf("  Wrong size %u!\n", (unsigned)var_file.size);
+    else if (nk_checked_read(&var_file, 0, back, len) != len || memcmp(back, data, len))
+        printf("  Mismatch!\n");
+    else
+        printf("  File reads back OK, crc = %08x\n", (unsigned)var_file.crc);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t x;
+    unsigned char buf[16];
+    nkoutfile_t f[1];
+    nk_checked_t var_file;
+
+    for (x = 0; x != sizeof(data); ++x)
+        data[x] = (unsigned char)(x * 7 + 1);
+
+    // nk_fwrite with granularity 4 into a 16 byte buffer
+
+    static const size_t pieces_a[] = { 3, 30, 2, 16, 1 };
+    static const size_t pieces_b[] = { 16, 5, 11, 40 };
+
+    nkoutfile_open(f, rec_write, NULL, buf, sizeof(buf), 4);
+    test_fwrite("block_write, buffered data", f, pieces_a, 5);
+
+    nkoutfile_open(f, rec_write, NULL, buf, sizeof(buf), 4);
+    test_fwrite("block_write, block aligned", f, pieces_b, 4);
+
+    nkoutfile_open_writev(f, rec_writev, NULL, buf, sizeof(buf), 4);
+    test_fwrite("block_writev, buffered data", f, pieces_a, 5);
+
+    nkoutfile_open_writev(f, rec_writev, NULL, buf, sizeof(buf), 4);
+    test_fwrite("block_writev, block aligned", f, pieces_b, 4);
+
+    // nk_checked_writev with write units split across two and three segments
+
+    printf("nk_checked_writev:\n");
+    struct nkoutfile_seg seg[7];
+    static const size_t seg_lens[] = { 3, 10, 1, 2, 16, 0, 8 };
+    size_t offset = 0;
+    for (x = 0; x != 7; ++x) {
+        seg[x].ptr = data + offset;
+        seg[x].len = seg_lens[x];
+        offset += seg_lens[x];
+    }
+    memset(test_flash, 0, sizeof(test_flash));
+    if (nk_checked_write_open(&var_file, &bank_a) || nk_checked_writev(&var_file, seg, 7) || nk_checked_write_close(&var_file))
+        printf("  Error!\n");
+    check_file(&bank_a, offset);
+
+    printf("nk_checked_write, same data:\n");
+    if (nk_checked_write_open(&var_file, &bank_b) || nk_checked_write(&var_file, data, offset) || nk_checked_write_close(&var_file))
+        printf("  Error!\n");
+    check_file(&bank_b, offset);
+    if (memcmp(test_flash, test_flash + 512, 8 + offset))
+        printf("  Flash contents differ!\n");
+    else
+        printf("  Flash contents match\n");
+
+    // Whole path: nk_fwrite through nk_checked_writev
+
+    printf("nk_fwrite through nk_checked_writev:\n");
+    nk_checked_write_open(&var_file, &bank_a);
+    nkoutfile_open_writev(f, (int (*)(void *,const struct nkoutfile_seg *,size_t))nk_checked_writev, &var_file, buf, sizeof(buf), 8);
+    offset = 0;
+    for (x = 0; x != 5; ++x) {
+        printf(" nk_fwrite %zu\n", pieces_a[x]);
+        if (nk_fwrite(f, data + offset, pieces_a[x]))
+            printf("  Error!\n");
+        offset += pieces_a[x];
+    }
+    // Fill the last write unit, so nk_fflush does not pad
+    while ((size_t)(f->ptr - f->start) & 7)
+        nk_fputc(f, data[offset++]);
+    printf(" nk_fflush\n");
+    if (nk_fflush(f) || nk_checked_write_close(&var_file))
+        printf("  Error!\n");
+    check_file(&bank_a, offset);
+
+    printf("nk_checked_writev, granularity too large:\n");
+    nk_checked_write_open(&var_file, &bank_64);
+    printf("  status = %d\n", nk_checked_writev(&var_file, seg, 7));
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nkprintf.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Integer formatting speed for values of different sizes, checked against
+// the C library's snprintf.  Shortest round-trip floating point (%r) is
+// checked by reading it back with strtod.
+
+#define COUNT 200000
+
+uint64_t values[COUNT];
+
+uint64_t rng = 1;
+
+uint64_t rand_next(void)
+{
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    return rng;
+}
+
+// CPU cycles (or nanoseconds where there is no cycle counter)
+
+uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Values spread evenly over the number of bits, so every digit count shows up
+
+void fill(int bits, int sign)
+{
+    int x;
+    for (x = 0; x != COUNT; ++x) {
+        int b = 1 + (int)(rand_next() >> 40) % bits;
+        uint64_t v = rand_next() >> (64 - b);
+        if (sign && (rand_next() >> 63))
+            v = -v;
+        values[x] = v;
+    }
+}
+
+unsigned long errors;
+
+void check(const char *fmt, const char *got, const char *want)
+{
+    if (strcmp(got, want)) {
+        if (errors++ < 10)
+            printf("Mismatch for %s: got '%s' expected '%s'\n", fmt, got, want);
+    }
+}
+
+#define BENCH(name, fmt, type, bits, sign) do { \
+        int x; \
+        uint64_t c; \
+        double t; \
+        char buf[32], want[32]; \
+        fill(bits, sign); \
+        for (x = 0; x != COUNT; ++x) { \
+            nk_snprintf(buf, sizeof(buf), fmt, (type)values[x]); \
+            snprintf(want, sizeof(want), fmt, (type)values[x]); \
+            check(fmt, buf, want); \
+        } \
+        t = now(); \
+        c = cycles(); \
+        for (x = 0; x != COUNT; ++x) \
+            nk_snprintf(buf, sizeof(buf), fmt, (type)values[x]); \
+        c = cycles() - c; \
+        t = now() - t; \
+        printf("%-22s %-5s %7.2f M numbers/s, %5llu cycles/number\n", name, fmt, COUNT / t / 1e6, \
+               (unsigned long long)(c / COUNT)); \
+    } while (0)
+
+// Random finite doubles (or floats) with any exponent
+
+double dvalues[COUNT];
+
+void fill_double(int single)
+{
+    int x;
+    for (x = 0; x != COUNT; ++x) {
+        uint64_t u = rand_next();
+        if (single) {
+            uint32_t v = (uint32_t)(u >> 32);
+            float f;
+            if (((v >> 23) & 0xFF) == 0xFF)
+                v ^= 0x40000000;
+            memcpy(&f, &v, sizeof(f));
+            dvalues[x] = f;
+        } else {
+            if (((u >> 52) & 0x7FF) == 0x7FF)
+                u ^= 0x4000000000000000ULL;
+            memcpy(&dvalues[x], &u, sizeof(u));
+        }
+    }
+}
+
+#define FBENCH(name, fmt, single, check_it) do { \
+        int x; \
+        uint64_t c; \
+        double t; \
+        char buf[32]; \
+        fill_double(single); \
+        for (x = 0; check_it && x != COUNT; ++x) { \
+            nk_snprintf(buf, sizeof(buf), fmt, dvalues[x]); \
+            if (single ? strtof(buf, NULL) != (float)dvalues[x] : strtod(buf, NULL) != dvalues[x]) { \
+                if (errors++ < 10) \
+                    printf("Mismatch for %s: got '%s' for %.17g\n", fmt, buf, dvalues[x]); \
+            } \
+        } \
+        t = now(); \
+        c = cycles(); \
+        for (x = 0; x != COUNT; ++x) \
+            nk_snprintf(buf, sizeof(buf), fmt, dvalues[x]); \
+        c = cycles() - c; \
+        t = now() - t; \
+        printf("%-22s %-5s %7.2f M numbers/s, %5llu cycles/number\n", name, fmt, COUNT / t / 1e6, \
+               (unsigned long long)(c / COUNT)); \
+    } while (0)
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    // Fixed cost of nk_snprintf and of emitting the characters
+    {
+        int x;
+        uint64_t c;
+        double t;
+        char buf[32];
+        t = now();
+        c = cycles();
+        for (x = 0; x != COUNT; ++x)
+            nk_snprintf(buf, sizeof(buf), "%s", "123456789");
+        c = cycles() - c;
+        t = now() - t;
+        printf("%-22s %-5s %7.2f M strings/s, %5llu cycles/string\n", "9 char string", "%s", COUNT / t / 1e6,
+               (unsigned long long)(c / COUNT));
+    }
+
+    BENCH("16-bit signed", "%d", int, 16, 1);
+    BENCH("32-bit signed", "%d", int, 32, 1);
+    BENCH("32-bit unsigned", "%u", unsigned, 32, 0);
+    BENCH("32-bit hex", "%x", unsigned, 32, 0);
+    BENCH("64-bit signed", "%lld", long long, 64, 1);
+    BENCH("64-bit unsigned", "%llu", unsigned long long, 64, 0);
+    BENCH("64-bit hex", "%llX", unsigned long long, 64, 0);
+
+    FBENCH("double, 6 digits", "%e", 0, 0);
+    FBENCH("double, round trip", "%r", 0, 1);
+    FBENCH("float, round trip", "%hr", 1, 1);
+
+    printf("Mismatches: %lu\n", errors);
+
+    return errors != 0;
+}
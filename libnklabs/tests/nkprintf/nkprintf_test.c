@@ -1,5 +1,38 @@
+#include <stdarg.h>
+#include <string.h>
 #include "nkprintf.h"
 
+// Print the way nk_log() does: pack the arguments, then format from the
+// packed copy.  Output has to be the same as nk_printf().
+
+static void packed_printf(const char *fmt, ...)
+{
+    unsigned char args[64];
+    char direct[80];
+    char packed[80];
+    nkoutfile_t f;
+    va_list ap;
+
+    va_start(ap, fmt);
+    nkoutfile_open_mem(&f, direct, sizeof(direct) - 1);
+    _nk_vprintf(&f, fmt, ap);
+    *f.ptr = 0;
+    va_end(ap);
+
+    memset(args, 0, sizeof(args));
+    va_start(ap, fmt);
+    if (_nk_vpack_args(args, sizeof(args), fmt, ap) < 0)
+        args[0] = 0;
+    va_end(ap);
+    nkoutfile_open_mem(&f, packed, sizeof(packed) - 1);
+    _nk_vprintf_packed(&f, fmt, args);
+    *f.ptr = 0;
+
+    nk_printf("%s", packed);
+    if (strcmp(direct, packed))
+        nk_printf("Packed output differs from: %s", direct);
+}
+
 int main(int argc, char *argv[])
 {
     int x;
@@ -29,6 +62,24 @@ int main(int argc, char *argv[])
     nk_printf("--|%f|--\n", .000120);
     nk_printf("--|%e|--\n", .000120);
     nk_printf("--|%g|--\n", .000120);
+    nk_printf("--|%r|--\n", .000120);
+    nk_printf("--|%r|--\n", 0.1);
+    nk_printf("--|%r|--\n", 1.0/3.0);
+    nk_printf("--|%#r|--\n", 100.0);
+    nk_printf("--|%r|--\n", 1e22);
+    // Grisu2 alone gives one digit too many for these
+    nk_printf("--|%r|--\n", 1e23);
+    nk_printf("--|%r|--\n", 5e22);
+    nk_printf("--|%r|--\n", 8.41e21);
+    nk_printf("--|%r|--\n", 3.7129194692784797e-210);
+    nk_printf("--|%hr|--\n", -59825032.0f);
+    nk_printf("--|%hr|--\n", -181059392.0f);
+    nk_printf("--|%R|--\n", 5e-324);
+    nk_printf("--|%r|--\n", 1.7976931348623157e308);
+    nk_printf("--|%+r|--\n", -0.0);
+    nk_printf("--|%hr|--\n", 0.1f);
+    nk_printf("--|%#hr|--\n", 16777216.0f);
+    nk_printf("--|%R|--\n", -1.0/0.0);
     nk_printf("--|%c|--\n", 'A');
     nk_printf("--|%d|--\n", 0x7FFFFFFe);
     nk_printf("--|%ld|--\n", (long)0x7FFFFFFe);
@@ -45,6 +96,15 @@ int main(int argc, char *argv[])
     nk_printf("--|%20d|--\n", 12);
     nk_printf("--|%.5d|--\n", 12);
 
+    // Packed arguments, as used by nk_log
+
+    packed_printf("--|%*_|%d|--\n", 3, 42);
+    packed_printf("--|%*_%d|--\n", 3, 42);
+    packed_printf("--|%*_1%d|--\n", 2, 42);
+    packed_printf("--|%-*_|%s|--\n", 2, "after");
+    packed_printf("--|%*.*d|%x|--\n", 6, 3, 7, 0xbeef);
+    packed_printf("--|%_d|%*_|%ld|--\n", 1234567, 1, 99L);
+
     nk_printf("Try nkstdnull: "); nk_fprintf(nkstdnull, "What!!?"); nk_printf("\n");
 
     nk_printf("Try nkstderr: "); nk_fprintf(nkstderr, "Typical error message"); nk_printf("\n");
@@ -0,0 +1,5 @@
+// Host build of nkscan for the test and benchmark
+
+#include <stdint.h>
+
+#define NK_FLASH
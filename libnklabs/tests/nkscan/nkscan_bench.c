@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nkprintf.h"
+#include "nkscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Parse throughput for a large database text blob, as printed by
+// nk_dbase_fprint: nested structures and arrays of integers, hex numbers,
+// floating point numbers, booleans and strings.  It is read from memory
+// (one span) and through a block reader (many small spans), with one block
+// buffer or with a window of several.
+
+#define RECORDS 20000
+#define PASSES 20
+
+char *blob;
+size_t blob_len;
+
+uint64_t rng = 1;
+
+uint64_t rand_next(void)
+{
+    rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    return rng;
+}
+
+// CPU cycles (or nanoseconds where there is no cycle counter)
+
+uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Build the blob and compute what parsing it should find
+
+uint64_t want_sum;
+unsigned long want_count;
+
+void fill(void)
+{
+    size_t size = (size_t)RECORDS * 256 + 64;
+    size_t n = 0;
+    int x;
+    blob = malloc(size);
+    nk_snprintf(blob + n, size - n, "{\n  tarray: [\n");
+    n += strlen(blob + n);
+    for (x = 0; x != RECORDS; ++x) {
+        int32_t i = (int32_t)(rand_next() >> 32);
+        uint32_t u = (uint32_t)(rand_next() >> 32) >> (rand_next() >> 59);
+        uint16_t h = (uint16_t)(rand_next() >> 48);
+        int16_t d = (int16_t)(rand_next() >> 48);
+        unsigned frac = (unsigned)(rand_next() >> 32) % 1000;
+        nk_snprintf(blob + n, size - n,
+            "    {\n"
+            "      tstring: \"Hello %d\",\n"
+            "      tint: %d,\n"
+            "      tuint: %u,\n"
+            "      thex: 0x%x,\n"
+            "      tdouble: %d.%03u,\n"
+            "      tbool: %s\n"
+            "    }%s\n",
+            x, (int)i, (unsigned)u, (unsigned)h, (int)d, frac, (x & 1) ? "true" : "false", x + 1 == RECORDS ? "" : ",");
+        n += strlen(blob + n);
+        want_sum += (uint64_t)(int64_t)i + u + h + (uint64_t)(int64_t)d; // Fraction is dropped
+        want_count += 6;
+    }
+    nk_snprintf(blob + n, size - n, "  ]\n}\n");
+    n += strlen(blob + n);
+    blob_len = n;
+}
+
+// Walk a value, adding up the numbers found
+
+uint64_t sum;
+unsigned long count;
+
+int parse_value(nkinfile_t *f)
+{
+    char buf[32];
+    uint64_t v;
+    double d;
+    int c;
+    nk_fscan_ws(f);
+    c = nk_fpeek(f);
+    if (c == '{' || c == '[') {
+        int close = (c == '{' ? '}' : ']');
+        nk_fnext_fast(f);
+        for (;;) {
+            nk_fscan_ws(f);
+            if (nk_fpeek(f) == close) {
+                nk_fnext(f);
+                return 1;
+            }
+            if (close == '}') {
+                if (!nk_fscan_ident(f, buf, -1, sizeof(buf)))
+                    return 0;
+                nk_fscan_ws(f);
+                if (nk_fpeek(f) != ':')
+                    return 0;
+                nk_fnext_fast(f);
+            }
+            if (!parse_value(f))
+                return 0;
+            nk_fscan_ws(f);
+            if (nk_fpeek(f) == ',')
+                nk_fnext_fast(f);
+        }
+    } else if (c == '"') {
+        if (!nk_fscan_word(f, buf, -1, sizeof(buf)))
+            return 0;
+        ++count;
+    } else if (c == '0' && nk_fpeek_rel(f, 1) == 'x') {
+        nk_fseek_rel(f, 2);
+        if (!nk_fscan_hex(f, &v, -1))
+            return 0;
+        sum += v;
+        ++count;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        size_t pos = nk_ftell(f);
+        if (!nk_fscan_dec(f, &v, -1))
+            return 0;
+        c = nk_fpeek(f);
+        if (c == '.' || c == 'e') {
+            nk_fseek(f, pos);
+            if (!nk_fscan_double(f, &d))
+                return 0;
+            v = (uint64_t)(int64_t)d;
+        }
+        sum += v;
+        ++count;
+    } else if (nk_fscan_ident(f, buf, -1, sizeof(buf))) {
+        ++count;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Block reader over the blob
+
+#define BLOCK_SIZE 256
+
+unsigned char block_buf[BLOCK_SIZE * NKINFILE_WINDOW_MAX];
+
+size_t blob_read(void *ptr, size_t pos, unsigned char *buffer, size_t block_size)
+{
+    size_t len = block_size;
+    (void)ptr;
+    if (pos >= blob_len)
+        return 0;
+    if (len > blob_len - pos)
+        len = blob_len - pos;
+    memcpy(buffer, blob + pos, len);
+    return len;
+}
+
+unsigned long errors;
+
+// Best of PASSES, as this is easily disturbed
+
+void bench(const char *name, int blocks, int window)
+{
+    nkinfile_t f[1];
+    nkinfile_window_t w[1];
+    int x;
+    uint64_t c = 0;
+    double t = 0;
+    for (x = 0; x != PASSES; ++x) {
+        uint64_t c1;
+        double t1;
+        sum = 0;
+        count = 0;
+        t1 = now();
+        c1 = cycles();
+        if (window)
+            nkinfile_open_window(f, blob_read, NULL, NULL, BLOCK_SIZE, block_buf, (size_t)blocks, w);
+        else if (blocks)
+            nkinfile_open(f, blob_read, NULL, BLOCK_SIZE, block_buf);
+        else
+            nkinfile_open_mem(f, (const unsigned char *)blob, blob_len);
+        if (!parse_value(f) || !nk_fscan(f, " "))
+            ++errors;
+        c1 = cycles() - c1;
+        t1 = now() - t1;
+        if (!x || c1 < c)
+            c = c1;
+        if (!x || t1 < t)
+            t = t1;
+        if (sum != want_sum || count != want_count)
+            ++errors;
+    }
+    printf("%-18s %7.2f MB/s, %5.2f cycles/byte\n", name, (double)blob_len / t / 1e6,
+           (double)c / (double)blob_len);
+    if (window)
+        printf("%-18s %lu blocks read, %lu hits, %lu re-reads\n", "", (unsigned long)w->reads, (unsigned long)w->hits,
+               (unsigned long)w->rereads);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    fill();
+    printf("Blob is %lu bytes, %lu values\n", (unsigned long)blob_len, want_count);
+
+    bench("Memory", 0, 0);
+    bench("256 byte blocks", 1, 0);
+    bench("1 block window", 1, 1);
+    bench("2 block window", 2, 1);
+
+    printf("Errors: %lu\n", errors);
+
+    return errors != 0;
+}
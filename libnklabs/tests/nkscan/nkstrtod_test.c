@@ -0,0 +1,131 @@
+// fstrtod() against the C library's strtod()
+// Built with and without NKSCAN_SMALL_STRTOD: see the Makefile
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "nkinfile.h"
+#include "nkstrtod.h"
+
+static double parse(const char *s)
+{
+    nkinfile_t f;
+    double d;
+    nkinfile_open_string(&f, s);
+    if (!fstrtod(&f, &d))
+        printf("  %s: no number!\n", s);
+    else if (nk_fpeek(&f) != -1)
+        printf("  %s: not all of it parsed!\n", s);
+    return d;
+}
+
+// Print result, and the C library's result if it's different
+
+static void check(const char *s)
+{
+    double d = parse(s);
+    double want = strtod(s, NULL);
+    printf("%s -> %a", s, d);
+    if (memcmp(&d, &want, sizeof(d)))
+        printf(" (strtod: %a)", want);
+    printf("\n");
+}
+
+static const char *hard[] =
+{
+    // Exact halfway between two doubles: round to even
+    "9007199254740993", // 2^53 + 1: down
+    "9007199254740995", // 2^53 + 3: up
+    "4503599627370496.5", // 2^52 + 1/2: down
+    "4503599627370497.5", // 2^52 + 3/2: up
+    "1.00000000000000011102230246251565404236316680908203125", // 1 + 2^-53: down
+    "1.00000000000000033306690738754696212708950042724609375", // 1 + 3 * 2^-53: up
+    // Just either side of halfway
+    "9007199254740993.0000000000000001",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    // Classic hard cases
+    "1e23",
+    "8.98846567431158e307",
+    "2.2250738585072011e-308", // largest subnormal
+    "2.2250738585072012e-308", // DBL_MIN
+    "2.2250738585072014e-308",
+    "0.1",
+    "0.3",
+    "123456789012345678",
+    // Subnormals
+    "4.9406564584124654e-324", // smallest
+    "5e-324",
+    "2.4703282292062327e-324", // below half of the smallest: zero
+    "2.4703282292062328e-324", // above half of the smallest
+    "1e-320",
+    "3.5e-320",
+    "1.1125369292536007e-308",
+    // Ends of the table: 10^-342 and 10^308
+    "1e-342",
+    "9999999999999999999e-342",
+    "1e-343",
+    "1e308",
+    "17976931348623157e292", // DBL_MAX
+    "1.7976931348623158e308", // rounds down to DBL_MAX
+    "1.7976931348623159e308", // rounds up to infinity
+    "1e309",
+    // More than 19 digits: w + 1 must give the same result, otherwise it
+    // falls back to scaling by powers of ten
+    "12345678901234567890",
+    "123456789012345678901234567890",
+    "0.1000000000000000055511151231257827021181583404541015625",
+    "2.22507385850720113605740979670913197593481954635164564e-308",
+    "179769313486231580793728971405303415079934132710037826936173778980444968292764750946649017977587207096330286416692887910946555547851940402630657488671505820681908902000708383676273854845817711531764475730270069855571366959622842914819860834936475292719074168444365510704342711559699508093042880177904174497791.9999999",
+    // Smallest subnormal with all the leading zeros
+    "0.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000004940656458412465441765687928682213723650598",
+    NULL
+};
+
+// Random doubles, printed by the C library
+
+static uint64_t state = 0x123456789ABCDEF1ULL;
+
+static uint64_t xorshift64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void sweep(const char *fmt, int count)
+{
+    int x;
+    int diff = 0;
+    char buf[64];
+    for (x = 0; x != count; ++x) {
+        uint64_t bits;
+        double d;
+        do {
+            bits = xorshift64();
+            memcpy(&d, &bits, sizeof(d));
+        } while ((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL); // No NaN or infinity
+        snprintf(buf, sizeof(buf), fmt, d);
+        double got = parse(buf);
+        double want = strtod(buf, NULL);
+        if (memcmp(&got, &want, sizeof(got)))
+            ++diff;
+    }
+    printf("%d random doubles printed with %s: %d differ from strtod\n", count, fmt, diff);
+}
+
+int main(int argc, char *argv[])
+{
+    int x;
+
+    for (x = 0; hard[x]; ++x)
+        check(hard[x]);
+
+    sweep("%.17g", 100000);
+    sweep("%.16g", 100000);
+    sweep("%.25g", 100000);
+
+    return 0;
+}
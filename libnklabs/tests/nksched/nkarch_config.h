@@ -0,0 +1,52 @@
+// Host model of the target for nksched tests
+//
+// Time only advances when the scheduler sleeps: nk_irq_unlock_and_wait()
+// jumps straight to the time given to the last nk_sched_wakeup().  Time
+// spent with sched_lock held is accumulated in test_lock_cycles.
+
+#include <stdint.h>
+
+#define NK_FLASH
+
+typedef int nk_spinlock_t;
+typedef unsigned long nk_irq_flag_t;
+#define SPIN_LOCK_UNLOCKED 0
+
+typedef uint32_t nk_time_t;
+
+#define NK_TIME_COUNTS_PER_SECOND 1000
+
+// CPU cycle counter (or nanoseconds where there is none)
+uint64_t test_cycles(void);
+
+extern uint64_t test_lock_cycles;
+extern uint64_t test_lock_start;
+
+static inline nk_irq_flag_t nk_irq_lock(nk_spinlock_t *lock)
+{
+    (void)lock;
+    test_lock_start = test_cycles();
+    return 0;
+}
+
+static inline void nk_irq_unlock(nk_spinlock_t *lock, nk_irq_flag_t flags)
+{
+    (void)lock;
+    (void)flags;
+    test_lock_cycles += test_cycles() - test_lock_start;
+}
+
+// Advance time to the requested wakeup, or call test_idle() if nothing is pending
+void nk_irq_unlock_and_wait(nk_spinlock_t *lock, nk_irq_flag_t flags, int deepness);
+
+// Called by the model when the scheduler would sleep forever
+void test_idle(void);
+
+extern nk_time_t test_time;
+extern unsigned long test_wakeups;
+
+nk_time_t nk_get_time();
+nk_time_t nk_convert_delay(uint32_t delay);
+void nk_init_sched_timer();
+void nk_sched_wakeup(nk_time_t when);
+void nk_udelay(unsigned long usec);
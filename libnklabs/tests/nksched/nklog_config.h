@@ -0,0 +1,5 @@
+// Small, so that the test can fill it
+
+#define NK_LOG_SIZE 128
+
+#define NK_LOG_ARGS_MAX 40
@@ -0,0 +1,4 @@
+
+// #define NKSCAN_NOFLOAT
+
+#define NKSCAN_NODBASE
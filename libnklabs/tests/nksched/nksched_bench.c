@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "nksched.h"
+
+// Measure time spent with sched_lock held for scheduler calls at
+// different queue depths
+
+#define OPS 20000
+
+uint32_t rng = 1;
+
+uint32_t rand_next(void)
+{
+	rng = rng * 1103515245 + 12345;
+	return (rng >> 8) & 0xFFFF;
+}
+
+void task(void *data)
+{
+	(void)data;
+}
+
+void test_idle(void)
+{
+}
+
+int tids[1024];
+
+void bench(int depth)
+{
+	int x;
+	uint64_t resched_cycles, cancel_cycles;
+
+	nk_init_sched();
+	for (x = 0; x != depth; ++x) {
+		if (!tids[x])
+			tids[x] = nk_alloc_tid();
+		nk_sched(tids[x], task, NULL, rand_next() % 10000, "Bench");
+	}
+
+	// Replace an existing task with a new deadline
+	test_lock_cycles = 0;
+	for (x = 0; x != OPS; ++x)
+		nk_sched(tids[rand_next() % depth], task, NULL, rand_next() % 10000, "Bench");
+	resched_cycles = test_lock_cycles;
+
+	// Cancel a task and submit it again
+	test_lock_cycles = 0;
+	for (x = 0; x != OPS; ++x) {
+		int t = tids[rand_next() % depth];
+		nk_unsched(t);
+		nk_sched(t, task, NULL, rand_next() % 10000, "Bench");
+	}
+	cancel_cycles = test_lock_cycles;
+
+	printf("depth %4d: nk_sched %6llu cycles/call, nk_unsched + nk_sched %6llu cycles/pair\n",
+		   depth, (unsigned long long)(resched_cycles / OPS), (unsigned long long)(cancel_cycles / OPS));
+}
+
+int main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+#ifdef NK_SCHED_HEAP
+	printf("Work queue engine: binary heap\n");
+#else
+	printf("Work queue engine: sorted list\n");
+#endif
+#ifdef NK_SCHED_TID_INDEX_SIZE
+	printf("Tid index: %d entries\n", NK_SCHED_TID_INDEX_SIZE);
+#endif
+	bench(4);
+	bench(64);
+	bench(1024);
+	return 0;
+}
@@ -0,0 +1,14 @@
+// Big enough for the 1024 deep benchmark
+
+#define NK_WORK_QUEUE_SIZE 1100
+
+// The Makefile builds each program once as-is (sorted list), once with
+// -DNK_SCHED_HEAP (which implies a tid index for the whole queue) and once
+// with the heap plus a small NK_SCHED_TID_INDEX_SIZE, so that larger tids
+// are searched for, and NK_SCHED_STATS_SIZE
+
+#define NK_SCHED_ISR_SOURCES 2
+
+#define NK_SCHED_PERIODIC
+#define NK_SCHED_SLACK
+#define NK_SCHED_EVENTS
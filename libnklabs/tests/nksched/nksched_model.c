@@ -0,0 +1,67 @@
+// Host model of scheduler timer and interrupt lock
+
+#include <time.h>
+#include "nksched.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+uint64_t test_lock_cycles;
+uint64_t test_lock_start;
+nk_time_t test_time;
+unsigned long test_wakeups;
+
+static int wakeup_pending;
+static nk_time_t wakeup_when;
+
+uint64_t test_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+nk_time_t nk_get_time()
+{
+	return test_time;
+}
+
+nk_time_t nk_convert_delay(uint32_t delay)
+{
+	return delay * (NK_TIME_COUNTS_PER_SECOND / 1000);
+}
+
+void nk_init_sched_timer()
+{
+	wakeup_pending = 0;
+}
+
+void nk_sched_wakeup(nk_time_t when)
+{
+	wakeup_pending = 1;
+	wakeup_when = when;
+}
+
+void nk_irq_unlock_and_wait(nk_spinlock_t *lock, nk_irq_flag_t flags, int deepness)
+{
+	(void)deepness;
+	nk_irq_unlock(lock, flags);
+	if (wakeup_pending) {
+		wakeup_pending = 0;
+		if ((int32_t)(wakeup_when - test_time) > 0)
+			test_time = wakeup_when;
+		++test_wakeups;
+	} else {
+		test_idle();
+	}
+}
+
+void nk_udelay(unsigned long usec)
+{
+	(void)usec;
+}
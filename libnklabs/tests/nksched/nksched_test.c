@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "nksched.h"
+#include "nkcoroutine.h"
+#include "nklog.h"
+
+// Scheduler behavior test: same expected output for every queue engine
+
+int tid_a, tid_b, tid_c, tid_d, tid_e, tid_f, tid_g;
+
+int phase;
+int b_runs;
+
+void task(void *data)
+{
+	printf("time=%lu tid=%d %s\n", (unsigned long)nk_get_time(), nk_get_tid(), (char *)data);
+	if (nk_get_tid() == tid_b && !b_runs++) {
+		// Submit from within a task: new task for now, and ourself again later
+		nk_sched(tid_f, task, "F (submitted by B)", 0, "F");
+		nk_sched(tid_b, task, "B again", 7, "B");
+	}
+}
+
+// Periodic tasks: a hog task makes both of them late
+
+int tid_skip, tid_catchup, tid_hog;
+int skip_runs, catchup_runs;
+
+void periodic_task(void *data)
+{
+	int *runs = (int *)data;
+	printf("time=%lu tid=%d %s run %d\n", (unsigned long)nk_get_time(), nk_get_tid(), runs == &skip_runs ? "skip" : "catchup", *runs);
+	if (++*runs == 6)
+		nk_unsched(nk_get_tid());
+}
+
+void hog_task(void *data)
+{
+	(void)data;
+	printf("time=%lu tid=%d hog runs for 25 ms\n", (unsigned long)nk_get_time(), nk_get_tid());
+	test_time += 25;
+}
+
+// Coroutine: delays, then waits for a flag set by another task
+
+nk_co_t co;
+int co_count;
+int co_flag;
+
+void co_task(void *data)
+{
+	NK_CO_BEGIN(&co);
+	printf("time=%lu co start %s\n", (unsigned long)nk_get_time(), (char *)data);
+	for (co_count = 0; co_count != 3; ++co_count) {
+		NK_AWAIT_DELAY(&co, 10);
+		printf("time=%lu co delay %d\n", (unsigned long)nk_get_time(), co_count);
+	}
+	NK_AWAIT_UNTIL(&co, co_flag);
+	printf("time=%lu co got flag\n", (unsigned long)nk_get_time());
+	NK_AWAIT_POLL(&co, co_flag == 3, 4);
+	printf("time=%lu co polled flag=%d\n", (unsigned long)nk_get_time(), co_flag);
+	NK_CO_END(&co);
+}
+
+void co_flag_task(void *data)
+{
+	(void)data;
+	++co_flag;
+	printf("time=%lu flag=%d running=%d\n", (unsigned long)nk_get_time(), co_flag, nk_co_running(&co));
+	if (co_flag == 1)
+		nk_co_wake(&co);
+}
+
+void co_check_task(void *data)
+{
+	(void)data;
+	printf("time=%lu co after wake: running=%d\n", (unsigned long)nk_get_time(), nk_co_running(&co));
+}
+
+// Events
+
+nk_event_t ev = NK_EVENT_INIT;
+int tid_w1, tid_w2, tid_w3, tid_w4;
+
+void waiter_task(void *data)
+{
+	printf("time=%lu tid=%d %s, waiting=%d\n", (unsigned long)nk_get_time(), nk_get_tid(), (char *)data, nk_event_waiting(&ev));
+}
+
+void signal_task(void *data)
+{
+	(void)data;
+	printf("time=%lu signal woke %d\n", (unsigned long)nk_get_time(), nk_event_signal(&ev));
+}
+
+// Dispatch order check with many tasks
+
+#define STRESS_TASKS 500
+
+int stress_tid[STRESS_TASKS];
+nk_time_t stress_when[STRESS_TASKS];
+char stress_pending[STRESS_TASKS];
+unsigned long stress_count;
+unsigned long stress_cancelled;
+unsigned long stress_errors;
+nk_time_t stress_last;
+uint32_t stress_hash;
+
+uint32_t rng = 1;
+
+uint32_t rand_next(void)
+{
+	rng = rng * 1103515245 + 12345;
+	return (rng >> 8) & 0xFFFF;
+}
+
+void stress_task(void *data)
+{
+	int n = (int)(intptr_t)data;
+	if (!stress_pending[n])
+		++stress_errors;
+	stress_pending[n] = 0;
+	if (nk_get_time() != stress_when[n])
+		++stress_errors;
+	if ((int32_t)(nk_get_time() - stress_last) < 0)
+		++stress_errors;
+	stress_last = nk_get_time();
+	stress_hash = stress_hash * 31 + (uint32_t)n;
+	++stress_count;
+}
+
+void stress_submit(int n)
+{
+	uint32_t delay = rand_next() % 64;
+	stress_when[n] = nk_get_time() + delay;
+	stress_pending[n] = 1;
+	nk_sched(stress_tid[n], stress_task, (void *)(intptr_t)n, delay, "Stress");
+}
+
+// Deferred logging: tasks which are due run before records are printed
+
+void log_task(void *data)
+{
+	printf("time=%lu tid=%d %s\n", (unsigned long)nk_get_time(), nk_get_tid(), (char *)data);
+	nk_log("logged by %s\n", (char *)data);
+}
+
+// Slack stress: every task must run between its deadline and its deadline
+// plus slack, with the same wakeups for every engine
+
+#define SLACK_TASKS 200
+
+nk_time_t slack_when[SLACK_TASKS];
+nk_time_t slack_slack[SLACK_TASKS];
+unsigned long slack_count;
+unsigned long slack_errors;
+uint32_t slack_hash;
+
+void slack_task(void *data)
+{
+	int n = (int)(intptr_t)data;
+	if ((int32_t)(nk_get_time() - slack_when[n]) < 0 || (int32_t)(nk_get_time() - slack_when[n] - slack_slack[n]) > 0)
+		++slack_errors;
+	slack_hash = slack_hash * 31 + (uint32_t)n + nk_get_time();
+	++slack_count;
+}
+
+void test_idle(void)
+{
+	int x;
+	if (phase == 0) {
+		phase = 1;
+		printf("Queue empty\n");
+
+		tid_skip = nk_alloc_tid();
+		tid_catchup = nk_alloc_tid();
+		tid_hog = nk_alloc_tid();
+		printf("sched_periodic skip: %d\n", nk_sched_periodic(tid_skip, periodic_task, &skip_runs, 10, 0, NK_SCHED_SKIP, "Skip"));
+		printf("sched_periodic catchup: %d\n", nk_sched_periodic(tid_catchup, periodic_task, &catchup_runs, 10, 5, NK_SCHED_CATCHUP, "Catchup"));
+		printf("sched hog: %d\n", nk_sched(tid_hog, hog_task, NULL, 12, "Hog"));
+		printf("check skip: %d\n", nk_check(tid_skip));
+	} else if (phase == 1) {
+		phase = 2;
+		printf("Queue empty\n");
+
+		// Slack: X and Y share one wakeup, Z has no slack
+		test_wakeups = 0;
+		printf("sched_slack X: %d\n", nk_sched_slack(nk_alloc_tid(), task, "X (10 + 20 slack)", 10, 20, "X"));
+		printf("sched_slack Y: %d\n", nk_sched_slack(nk_alloc_tid(), task, "Y (15 + 5 slack)", 15, 5, "Y"));
+		printf("sched Z: %d\n", nk_sched(nk_alloc_tid(), task, "Z (25)", 25, "Z"));
+		printf("sched_slack W: %d\n", nk_sched_slack(nk_alloc_tid(), task, "W (40 + 100 slack)", 40, 100, "W"));
+	} else if (phase == 2) {
+		phase = 3;
+		printf("Queue empty after %lu wakeups\n", test_wakeups);
+
+		nk_co_start(&co, co_task, "C1");
+		printf("co running: %d\n", nk_co_running(&co));
+		nk_sched(nk_alloc_tid(), co_flag_task, NULL, 50, "Flag 1");
+		nk_sched(nk_alloc_tid(), co_flag_task, NULL, 51, "Flag 2");
+		nk_sched(nk_alloc_tid(), co_flag_task, NULL, 61, "Flag 3");
+	} else if (phase == 3) {
+		phase = 4;
+		printf("Queue empty, co running: %d\n", nk_co_running(&co));
+
+		// Finished coroutine must not run again: neither from a late wake
+		// nor from a stale delay
+		nk_co_wake(&co);
+		_nk_co_sched(&co, 3, "Stale delay");
+		nk_sched(nk_alloc_tid(), co_check_task, NULL, 5, "Co check");
+
+		// W1 forever, W2 times out, W3 and W4 (re-waited) are signaled, W5 is canceled
+		tid_w1 = nk_alloc_tid();
+		tid_w2 = nk_alloc_tid();
+		tid_w3 = nk_alloc_tid();
+		tid_w4 = nk_alloc_tid();
+		printf("event_wait W1: %d\n", nk_event_wait(&ev, tid_w1, waiter_task, "W1 (forever)", NK_EVENT_FOREVER, "W1"));
+		printf("event_wait W2: %d\n", nk_event_wait(&ev, tid_w2, waiter_task, "W2 (10 ms timeout)", 10, "W2"));
+		printf("event_wait W3: %d\n", nk_event_wait(&ev, tid_w3, waiter_task, "W3 (100 ms timeout)", 100, "W3"));
+		printf("sched W4: %d\n", nk_sched(tid_w4, waiter_task, "W4", 5, "W4"));
+		printf("event_wait W4: %d\n", nk_event_wait(&ev, tid_w4, waiter_task, "W4 (replaced, forever)", NK_EVENT_FOREVER, "W4"));
+		x = nk_alloc_tid();
+		printf("event_wait W5: %d\n", nk_event_wait(&ev, x, waiter_task, "W5", NK_EVENT_FOREVER, "W5"));
+		printf("unsched W5: %d\n", nk_unsched(x));
+		printf("sched signal: %d\n", nk_sched(nk_alloc_tid(), signal_task, NULL, 30, "Signal"));
+		printf("sched signal: %d\n", nk_sched(nk_alloc_tid(), signal_task, NULL, 40, "Signal"));
+	} else if (phase == 4) {
+		phase = 5;
+		printf("Queue empty, waiting=%d\n", nk_event_waiting(&ev));
+
+		// Stress: submit, then randomly cancel or resubmit some
+		stress_last = nk_get_time();
+		for (x = 0; x != STRESS_TASKS; ++x)
+			stress_tid[x] = nk_alloc_tid();
+		for (x = 0; x != STRESS_TASKS; ++x)
+			stress_submit(x);
+		for (x = 0; x != STRESS_TASKS; ++x) {
+			int n = (int)(rand_next() % STRESS_TASKS);
+			if (rand_next() & 1) {
+				if (nk_unsched(stress_tid[n])) {
+					stress_pending[n] = 0;
+					++stress_cancelled;
+				}
+			} else {
+				stress_submit(n);
+			}
+		}
+	} else if (phase == 5) {
+		phase = 6;
+		for (x = 0; x != STRESS_TASKS; ++x)
+			if (stress_pending[x])
+				++stress_errors;
+		printf("Stress: dispatched %lu, cancelled %lu, errors=%lu, order hash=%lx\n",
+			   stress_count, stress_cancelled, stress_errors, (unsigned long)stress_hash);
+
+		nk_init_log();
+		nk_log("int %d long %ld long long %lld hex %x char %c string %s\n", -5, 100000L, 1LL << 40, 0xbeef, 'z', "const");
+		nk_log("width |%5d|%-5d|%*d| precision %.3d float %g\n", 42, 42, 4, 7, 12, 1.5);
+		nk_sched(nk_alloc_tid(), log_task, "L1", 0, "L1");
+		nk_sched(nk_alloc_tid(), log_task, "L2", 3, "L2");
+		printf("Logged at time=%lu\n", (unsigned long)nk_get_time());
+	} else if (phase == 6) {
+		phase = 7;
+		printf("Queue empty\n");
+		nk_log("fill |%*_%d|\n", 3, 42);
+		// More than fits
+		for (x = 0; x != 20; ++x)
+			nk_log("burst %d\n", x);
+		nk_log("too many arguments %lld %lld %lld %lld %lld\n", 1LL, 2LL, 3LL, 4LL, 5LL);
+	} else if (phase == 7) {
+		phase = 8;
+		printf("Queue empty\n");
+		test_wakeups = 0;
+		for (x = 0; x != SLACK_TASKS; ++x) {
+			uint32_t delay = rand_next() % 1000;
+			uint32_t slack = (rand_next() & 1) ? rand_next() % 50 : 0;
+			slack_when[x] = nk_get_time() + delay;
+			slack_slack[x] = slack;
+			nk_sched_slack(nk_alloc_tid(), slack_task, (void *)(intptr_t)x, delay, slack, "Slack");
+		}
+	} else if (phase == 8) {
+		phase = 9;
+		printf("Slack stress: dispatched %lu in %lu wakeups, errors=%lu, hash=%lx\n",
+			   slack_count, test_wakeups, slack_errors, (unsigned long)slack_hash);
+	} else {
+		printf("Queue empty\n");
+		fflush(stdout);
+		exit(0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	int src;
+
+	// Start just before wrap-around
+	test_time = 0xFFFFFFF0;
+
+	nk_init_sched();
+
+	tid_a = nk_alloc_tid();
+	tid_b = nk_alloc_tid();
+	tid_c = nk_alloc_tid();
+	tid_d = nk_alloc_tid();
+	tid_e = nk_alloc_tid();
+	tid_f = nk_alloc_tid();
+	tid_g = nk_alloc_tid();
+
+	printf("sched A: %d\n", nk_sched(tid_a, task, "A", 30, "A"));
+	printf("sched B: %d\n", nk_sched(tid_b, task, "B", 10, "B"));
+	printf("sched C: %d\n", nk_sched(tid_c, task, "C (same time as B)", 10, "C"));
+	printf("sched D: %d\n", nk_sched(tid_d, task, "D", 20, "D"));
+	printf("sched E: %d\n", nk_sched(tid_e, task, "E", 50, "E"));
+	printf("resched A: %d\n", nk_resched(tid_a, task, "A (rescheduled)", 5));
+	printf("resched F: %d\n", nk_resched(tid_f, task, "F", 5));
+	printf("unsched D: %d\n", nk_unsched(tid_d));
+	printf("unsched D: %d\n", nk_unsched(tid_d));
+	printf("check D: %d\n", nk_check(tid_d));
+	printf("check E: %d\n", nk_check(tid_e));
+	printf("sched E: %d\n", nk_sched(tid_e, task, "E (replaced)", 40, "E"));
+
+	// A tid beyond any tid index
+	printf("sched 5000: %d\n", nk_sched(5000, task, "5000", 3, "Big tid"));
+	printf("check 5000: %d\n", nk_check(5000));
+	printf("sched 5001: %d\n", nk_sched(5001, task, "5001", 2, "Big tid"));
+	printf("unsched 5000: %d\n", nk_unsched(5000));
+	printf("check 5000: %d\n", nk_check(5000));
+
+	// Post from "interrupt handler": task runs once, at the time of the next pass of the main loop
+	src = nk_alloc_isr_source();
+	printf("alloc_isr_source: %d\n", src);
+	nk_set_isr_source(src, tid_g, task, "G (posted by ISR)", "ISR");
+	nk_sched_from_isr(src);
+	nk_sched_from_isr(src);
+	printf("alloc_isr_source: %d\n", nk_alloc_isr_source());
+	printf("alloc_isr_source: %d\n", nk_alloc_isr_source());
+
+	nk_sched_loop();
+
+	return 0;
+}
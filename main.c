@@ -2,6 +2,8 @@
 #include "nkuart.h"
 #include "nksched.h"
 #include "nkcli.h"
+#include "nklog.h"
+#include "nkmcuflash.h"
 
 
 #ifdef TEST
@@ -10,7 +12,6 @@ int test_tid;
 void test_task(void *data)
 {
     nk_puts("Hi\r\n");
-    nk_sched(test_tid, (void (*)(void *))test_task, NULL, 1000, "Test");
 }
 #endif
 
@@ -22,11 +23,13 @@ int main(void)
 #else
     nk_puts("Hello, world!\r\n");
 #endif
+    nk_init_mcuflash();
     nk_init_sched();
+    nk_init_log();
     nk_init_cli();
 #ifdef TEST
     test_tid = nk_alloc_tid();
-    nk_sched(test_tid, (void (*)(void *))test_task, NULL, 1000, "Test");
+    nk_sched_periodic(test_tid, (void (*)(void *))test_task, NULL, 1000, 1000, NK_SCHED_SKIP, "Test");
 #endif
     nk_sched_loop();
 }
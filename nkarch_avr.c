@@ -24,25 +24,151 @@
 #include "nkmcuflash.h"
 #include "nkarch_avr.h"
 
-// Scheduler timer- using PICORV32 timer
+// Scheduler timer- using timer 2
 
 static volatile nk_time_t wallclock;
 
 // Convert delay in milliseconds to number of scheduler timer clock ticks
 nk_time_t nk_convert_delay(uint32_t delay)
 {
-    return delay * (NK_TIME_COUNTS_PER_SECOND / 1000);
+    // Split to avoid overflow for fractional ticks per millisecond
+    return delay * (NK_TIME_COUNTS_PER_SECOND / 1000) +
+           (delay / 1000) * (NK_TIME_COUNTS_PER_SECOND % 1000) +
+           (delay % 1000) * (NK_TIME_COUNTS_PER_SECOND % 1000) / 1000;
 }
 
 #ifdef TCCR2
-ISR(TIMER2_COMP_vect)
+// ATmega32
+#define TIMER2_COMP_VECT TIMER2_COMP_vect
+#define TIMER2_CTRL TCCR2
+#define TIMER2_OCR OCR2
+#define TIMER2_TIMSK TIMSK
+#define TIMER2_TIFR TIFR
+#define TIMER2_OCIE OCIE2
+#define TIMER2_OCF OCF2
+#define TIMER2_ASSR_BUSY ((1 << TCN2UB) | (1 << OCR2UB) | (1 << TCR2UB))
 #else
-ISR(TIMER2_COMPA_vect)
+#define TIMER2_COMP_VECT TIMER2_COMPA_vect
+#define TIMER2_CTRL TCCR2B
+#define TIMER2_OCR OCR2A
+#define TIMER2_TIMSK TIMSK2
+#define TIMER2_TIFR TIFR2
+#define TIMER2_OCIE OCIE2A
+#define TIMER2_OCF OCF2A
+#define TIMER2_ASSR_BUSY ((1 << TCN2UB) | (1 << OCR2AUB) | (1 << OCR2BUB) | (1 << TCR2AUB) | (1 << TCR2BUB))
 #endif
+
+#ifdef NK_AVR_TICKLESS
+
+// wallclock holds the upper 24 bits, TCNT2 is the lower 8 bits
+
+ISR(TIMER2_OVF_vect)
 {
-    ++wallclock;
+    wallclock += 256;
+}
+
+// Compare match only has to wake us up: it's a one-shot
+
+ISR(TIMER2_COMP_VECT)
+{
+    TIMER2_TIMSK &= (uint8_t)~(1 << TIMER2_OCIE);
+}
+
+#ifdef NK_AVR_TIMER2_ASYNC
+// Clock from the crystal, divide by 32
+#define TIMER2_PRESCALE 3
+#else
+// Clock from F_CPU, divide by 1024
+#define TIMER2_PRESCALE 7
+#endif
+
+void nk_init_sched_timer()
+{
+#ifdef NK_AVR_TIMER2_ASYNC
+    // Switch to the crystal while the timer interrupts are still disabled
+    TIMER2_TIMSK = 0;
+    ASSR = (1 << AS2);
+#endif
+    // Normal mode
+#ifdef TCCR2
+    TCCR2 = (TIMER2_PRESCALE << CS20);
+#else
+    TCCR2A = 0;
+    TCCR2B = (TIMER2_PRESCALE << CS20);
+#endif
+#ifdef NK_AVR_TIMER2_ASYNC
+    // Writes reach the asynchronous timer a few crystal cycles later.  A
+    // spurious overflow from the clock switch only moves the start time.
+    TCNT2 = 0;
+    while (ASSR & TIMER2_ASSR_BUSY);
+#endif
+    TIMER2_TIMSK = (1 << TOIE2);
+
+    // Enable interrupts
+    sei();
+}
+
+#ifdef NK_AVR_TIMER2_ASYNC
+
+// Called with interrupts disabled before power-save sleep.  This also waits
+// for an OCR2 write from nk_sched_wakeup() to complete.
+
+void nk_avr_timer2_sync(void)
+{
+    TIMER2_CTRL = (TIMER2_PRESCALE << CS20);
+    while (ASSR & TIMER2_ASSR_BUSY);
+}
+
+#endif
+
+// Get current time
+
+extern nk_spinlock_t sched_lock;
+
+nk_time_t nk_get_time()
+{
+    nk_irq_flag_t irq_flag;
+    nk_time_t wall;
+    uint8_t count;
+
+    irq_flag = nk_irq_lock(&sched_lock);
+    count = TCNT2;
+    wall = wallclock;
+    // Overflow happened, but its interrupt has not run yet
+    if ((TIMER2_TIFR & (1 << TOV2)) && count < 128)
+        wall += 256;
+    nk_irq_unlock(&sched_lock, irq_flag);
+
+    return wall + count;
 }
 
+// Generate timer interrupt to wake up system
+// Interrupts are disabled when this is called.
+
+void nk_sched_wakeup(nk_time_t when)
+{
+    int32_t delta = (int32_t)(when - nk_get_time());
+
+    if (delta < 256) {
+        // Deadline is before the counter comes around again: use compare match.
+        // Make sure the match is in the future, even if 'when' is now or past.
+        if (delta < 2)
+            when = nk_get_time() + 2;
+        TIMER2_OCR = (uint8_t)when;
+        TIMER2_TIFR = (1 << TIMER2_OCF); // Clear stale match
+        TIMER2_TIMSK |= (1 << TIMER2_OCIE);
+    } else {
+        // Overflow interrupt will wake us up first, we'll try again then
+        TIMER2_TIMSK &= (uint8_t)~(1 << TIMER2_OCIE);
+    }
+}
+
+#else
+
+ISR(TIMER2_COMP_VECT)
+{
+    ++wallclock;
+}
 
 void nk_init_sched_timer()
 {
@@ -63,7 +189,7 @@ void nk_init_sched_timer()
     sei();
 }
 
-// Generate timer interrupt to wake up system
+// Generate timer interrupt to wake up system: the 1 kHz tick does this for us
 
 void nk_sched_wakeup(nk_time_t when)
 {
@@ -86,6 +212,8 @@ nk_time_t nk_get_time()
     return wall;
 }
 
+#endif
+
 // Busy loop delay
 // Also use sched timer...
 
@@ -93,7 +221,7 @@ void nk_udelay(unsigned long usec)
 {
     // Generic implementation
     nk_time_t old = nk_get_time();
-    nk_time_t clocks = usec * (NK_TIME_COUNTS_PER_SECOND / 1000000);
+    nk_time_t clocks = usec / (1000000 / NK_TIME_COUNTS_PER_SECOND);
     while ((nk_get_time() - old) < clocks);
 }
 
@@ -119,13 +247,28 @@ int nk_mcuflash_write(const void *info, uint32_t address, const uint8_t *data, s
     return -1;
 }
 
+// Program memory is a separate address space: read it with LPM through an
+// NK_FLASH pointer
+
 int nk_mcuflash_read(const void *info, uint32_t address, uint8_t *data, size_t byte_count)
+{
+    const NK_FLASH uint8_t *p;
+    (void)info;
+    if (address > FLASHEND || byte_count > FLASHEND + 1UL - address)
+        return -1;
+    p = (const NK_FLASH uint8_t *)(uintptr_t)address;
+    while (byte_count--)
+        *data++ = *p++;
+    return 0;
+}
+
+// Not in data address space
+
+const uint8_t *nk_mcuflash_map(const void *info, uint32_t address)
 {
     (void)info;
     (void)address;
-    (void)data;
-    (void)byte_count;
-    return -1;
+    return NULL;
 }
 
 void nk_reboot(void)
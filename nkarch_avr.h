@@ -30,6 +30,19 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <avr/wdt.h>
+#include <avr/sleep.h>
+
+// CPU clock
+
+#ifndef F_CPU
+#ifdef TCCR2
+// Probably ATmega32 on STK500 with 3.68 MHz clock
+#define F_CPU 3686400UL
+#else
+// Probably ATmega328pb with 16 MHz clock
+#define F_CPU 16000000UL
+#endif
+#endif
 
 // AVR: define to put help text and format strings in flash memory
 #define NK_PSTR
@@ -40,6 +53,9 @@
 #define NK_FLASH
 #endif
 
+// nkuart_avr.c provides the nk_uart_t API of nkuart.h
+#define NK_UART_INSTANCES
+
 typedef uint8_t nk_irq_flag_t;
 typedef uint8_t nk_spinlock_t;
 #define SPIN_LOCK_UNLOCKED 0
@@ -56,11 +72,44 @@ inline __attribute__((always_inline)) void nk_irq_unlock(nk_spinlock_t *lock, nk
 // Restore interrupt enable flag
 // Release spinlock on multi-core systems
 // Sleep until an interrupt occurs
+//
+// deepness 0: don't sleep
+// deepness 1: idle mode, everything keeps running
+// deepness 2: power-save mode, only timer 2 keeps running.  Note that the
+//             UART can not wake the CPU from this mode.  Timer 2 only runs
+//             in it when it is clocked asynchronously from a watch crystal,
+//             so without NK_AVR_TIMER2_ASYNC this is the same as idle mode.
+
+#ifdef NK_AVR_TIMER2_ASYNC
+// Write a timer 2 register and wait for it to reach the asynchronous timer
+void nk_avr_timer2_sync(void);
+#endif
 
 inline __attribute__((always_inline)) void nk_irq_unlock_and_wait(nk_spinlock_t *lock, nk_irq_flag_t flags, int deepness)
 {
     (void)lock;
-    (void)deepness;
+    if (deepness) {
+#ifdef NK_AVR_TIMER2_ASYNC
+        if (deepness == 1) {
+            set_sleep_mode(SLEEP_MODE_IDLE);
+        } else {
+            // Going back to power-save less than one crystal cycle after a
+            // timer 2 wakeup loses the next timer 2 interrupt, and nothing
+            // else can wake us up: a completed register write ensures that
+            // the cycle has passed.
+            nk_avr_timer2_sync();
+            set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+        }
+#else
+        set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+        sleep_enable();
+        // The instruction after sei is always executed before any pending
+        // interrupt, so we can not miss the wakeup
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
     SREG = flags;
 }
 
@@ -80,7 +129,22 @@ inline __attribute__((always_inline)) nk_irq_flag_t nk_irq_lock(nk_spinlock_t *l
 typedef uint32_t nk_time_t;
 
 // Units for scheduler time
+
+#ifdef NK_AVR_TIMER2_ASYNC
+#ifndef NK_AVR_TICKLESS
+#error "NK_AVR_TIMER2_ASYNC requires NK_AVR_TICKLESS"
+#endif
+// Timer 2 runs free from a 32.768 kHz crystal on TOSC1/TOSC2, divided by 32
+#define NK_TIME_COUNTS_PER_SECOND 1024
+#elif defined(NK_AVR_TICKLESS)
+// Timer 2 runs free at F_CPU / 1024, extended to 32 bits by its overflow
+// interrupt.  nk_sched_wakeup() sets up a compare match interrupt for the
+// next deadline, so there is no periodic tick.
+#define NK_TIME_COUNTS_PER_SECOND (F_CPU / 1024)
+#else
+// Timer 2 interrupts at 1 kHz
 #define NK_TIME_COUNTS_PER_SECOND 1000
+#endif
 #define NK_TIME_COUNTS_PER_USECOND 0
 
 // Get current time
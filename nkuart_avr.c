@@ -23,21 +23,31 @@
 #include "nksched.h"
 #include "nkuart.h"
 
+#ifndef NK_SCHED_EVENTS
+#error nkuart_avr.c needs NK_SCHED_EVENTS in nksched_config.h
+#endif
+
 // Select UART if there are more than one
 #ifndef RXC
 
 // Probably ATmega328pb with 16 MHz clock
-#define F_CPU 16000000UL
+#ifndef BAUD
 #define BAUD 38400
+#endif
 
 #define UCSRA UCSR0A
 #define RXC RXC0
+#define TXC TXC0
+#define FE FE0
+#define DOR DOR0
+#define U2X U2X0
 
 #define UCSRB UCSR0B
 #define RXEN RXEN0
 #define TXEN TXEN0
 #define UDRE UDRE0
 #define RXCIE RXCIE0
+#define UDRIE UDRIE0
 
 #define UCSRC UCSR0C
 #define USBS USBS0
@@ -53,144 +63,724 @@
 #else
 
 // Probably ATmega32 on STK500 with 3.68 MHz clock
-#define F_CPU 3686400UL
+#ifndef BAUD
 #define BAUD 115200
+#endif
+
+
+#endif
+
+#ifndef NK_UART1_BAUD
+#define NK_UART1_BAUD BAUD
+#endif
+
+// Rx buffer index type: it only has to hold the buffer size, so keep it to a
+// single byte when we can.  It's used in the interrupt handler.
+
+#ifndef NK_UART_RX_IDX_TYPE
+#if NK_UART_RXBUF_SIZE <= 128 && (!defined(NK_UART1_RXBUF_SIZE) || NK_UART1_RXBUF_SIZE <= 128)
+#define NK_UART_RX_IDX_TYPE uint8_t
+#else
+#define NK_UART_RX_IDX_TYPE uint16_t
+#endif
+#endif
+
+typedef NK_UART_RX_IDX_TYPE rx_idx_t;
+
+#if defined(NK_UART_TXBUF_SIZE) || defined(NK_UART1_TXBUF_SIZE)
+
+// Tx buffers are drained by the data register empty interrupt
+
+#define UART_TX_RING
+
+#if (!defined(NK_UART_TXBUF_SIZE) || NK_UART_TXBUF_SIZE <= 128) && (!defined(NK_UART1_TXBUF_SIZE) || NK_UART1_TXBUF_SIZE <= 128)
+typedef uint8_t tx_idx_t;
+#else
+typedef uint16_t tx_idx_t;
+#endif
+
+#endif
+
+#if defined(NK_UART_RX_WAKE_THRESHOLD) && !defined(NK_UART_RX_WAKE_IDLE)
+#define NK_UART_RX_WAKE_IDLE 2
+#endif
+
+#if defined(NK_UART_XONXOFF) || defined(NK_UART_CTS_PIN) || defined(NK_UART_RTS_PORT) || defined(NK_UART1_CTS_PIN) || defined(NK_UART1_RTS_PORT)
+#define UART_FLOW
+#endif
+
+#define XON 0x11
+#define XOFF 0x13
+
+// Register access.  The host test model replaces these to see every access.
+
+#ifndef UART_RD
+#define UART_RD(u, reg) (*(u)->reg)
+#define UART_WR(u, reg, val) (*(u)->reg = (uint8_t)(val))
+#endif
+
+// A USART and its buffers
+
+struct nk_uart {
+	// Registers
+	volatile uint8_t *ucsra;
+	volatile uint8_t *ucsrb;
+	volatile uint8_t *ucsrc;
+	volatile uint8_t *udr;
+	volatile uint8_t *ubrrl;
+	volatile uint8_t *ubrrh;
+	uint16_t ubrr; // Baud rate divisor, with UBRR_U2X
+	uint32_t baud;
+
+	nk_spinlock_t *lock;
+
+	// Rx buffer
+	unsigned char *rx_buf;
+	rx_idx_t rx_mask; // Size - 1
+	rx_idx_t rx_rd;
+	volatile rx_idx_t rx_wr;
+
+#ifdef UART_TX_RING
+	// Tx buffer: none if tx_buf is NULL
+	unsigned char *tx_buf;
+	tx_idx_t tx_mask; // Size - 1
+	volatile tx_idx_t tx_rd;
+	tx_idx_t tx_wr;
+#endif
+
+	uint8_t tx_started; // Set once anything has been sent: TXC is meaningful
+	uint8_t tty_mode;
 
+#ifdef UART_FLOW
+	// Flow control pins, none if NULL
+	volatile uint8_t *cts_pin; // CTS input: high stops our transmitter
+	volatile uint8_t *rts_port; // RTS output: we drive it high to stop the other side
+	uint8_t cts_mask;
+	uint8_t rts_mask;
 
+	uint8_t tx_xoff; // XOFF received
+	uint8_t rx_stopped; // We have asked the other side to stop
+	uint8_t tx_xchar; // XON or XOFF waiting to be sent
 #endif
 
-// Console UART Rx buffer
+	nk_uart_stats_t stats;
 
-static unsigned char rx_buf[NK_UART_RXBUF_SIZE];
-static uint32_t rx_buf_rd;
-static volatile uint32_t rx_buf_wr;
-static int tty_mode;
+	// Signaled when rx data is available
+	nk_event_t rx_event;
+
+#ifdef NK_SCHED_ISR_SOURCES
+	// Interrupt source for waking up the task waiting for rx_event
+	int rx_isr_source;
+#endif
+
+#ifdef NK_UART_RX_WAKE_THRESHOLD
+	// Waiting task: rx_idle_check() schedules it once there is enough data
+	// or the line has gone idle
+	int rx_tid;
+	void (*rx_func)(void *data);
+	void *rx_data;
+	nk_time_t rx_last; // When the interrupt handler last received data
+	uint8_t rx_idle_armed; // Idle timeout is running
+#endif
+};
+
+// Baud rate divisors
+//
+// UBRR is rounded to the nearest divisor for both the normal (16 clocks per
+// bit) and the U2X double speed (8 clocks per bit) modes, and the one closer
+// to the rate asked for is used: U2X is flagged in the top bit of the
+// divisor.  Everything here is a constant expression, so the table below and
+// the default rates cost nothing at run time.
+
+#define UBRR_U2X 0x8000U
+
+#define UBRR_DIV(baud, clocks) ((F_CPU + (clocks) * (baud) / 2) / ((clocks) * (baud)))
+#define UBRR_N(baud, clocks) (UBRR_DIV(baud, clocks) ? UBRR_DIV(baud, clocks) - 1 : 0)
+
+// Rate we actually get and its error, in units of 0.1%
+#define UBRR_ACTUAL(baud, clocks) (F_CPU / ((clocks) * (UBRR_N(baud, clocks) + 1)))
+#define UBRR_DIFF(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+#define UBRR_ERR(baud, clocks) (UBRR_DIFF(UBRR_ACTUAL(baud, clocks), (baud)) * 1000UL / (baud))
+
+#define BAUD_U2X(baud) (UBRR_ERR(baud, 8UL) < UBRR_ERR(baud, 16UL))
+#define BAUD_UBRR(baud) (BAUD_U2X(baud) ? (UBRR_N(baud, 8UL) | UBRR_U2X) : UBRR_N(baud, 16UL))
+#define BAUD_CLOCKS(baud) (BAUD_U2X(baud) ? 8UL : 16UL)
+#define BAUD_ERR(baud) UBRR_ERR(baud, BAUD_CLOCKS(baud))
+#define BAUD_SIGNED_ERR(baud) (UBRR_ACTUAL(baud, BAUD_CLOCKS(baud)) >= (baud) ? (long)BAUD_ERR(baud) : -(long)BAUD_ERR(baud))
+
+// The receiver tolerates about 4% total error with 8 data bits, less with
+// U2X: allow half of that, since the other side has some too
+
+#ifndef NK_UART_BAUD_MAX_ERROR
+#define NK_UART_BAUD_MAX_ERROR 25
+#endif
+
+#if BAUD_ERR(BAUD) > NK_UART_BAUD_MAX_ERROR
+#error BAUD can not be generated accurately enough from F_CPU
+#endif
+
+#if defined(NK_UART1_RXBUF_SIZE) && BAUD_ERR(NK_UART1_BAUD) > NK_UART_BAUD_MAX_ERROR
+#error NK_UART1_BAUD can not be generated accurately enough from F_CPU
+#endif
+
+// Rates for nk_uart_set_baud()
+
+struct baud_rate {
+	uint32_t baud;
+	uint16_t ubrr; // Divisor, with UBRR_U2X
+	int16_t err; // Error in units of 0.1%
+};
+
+#define BAUD_RATE(baud) { (baud), BAUD_UBRR(baud), BAUD_SIGNED_ERR(baud) }
+
+static const NK_FLASH struct baud_rate baud_rates[] = {
+	BAUD_RATE(2400UL),
+	BAUD_RATE(4800UL),
+	BAUD_RATE(9600UL),
+	BAUD_RATE(19200UL),
+	BAUD_RATE(38400UL),
+	BAUD_RATE(57600UL),
+	BAUD_RATE(76800UL),
+	BAUD_RATE(115200UL),
+	BAUD_RATE(230400UL),
+	BAUD_RATE(250000UL),
+	BAUD_RATE(460800UL),
+	BAUD_RATE(500000UL),
+	BAUD_RATE(921600UL),
+	BAUD_RATE(1000000UL),
+};
 
 nk_spinlock_t console_lock = SPIN_LOCK_UNLOCKED;
 
-// Task to submit when rx data available
-int waiting_rx_tid;
-void (*waiting_rx_task)(void *data);
-void *waiting_rx_task_data;
+// Console
 
-void nk_set_uart_callback(int tid, void (*func)(void *data), void *data)
+static unsigned char rx_buf0[NK_UART_RXBUF_SIZE];
+#ifdef NK_UART_TXBUF_SIZE
+static unsigned char tx_buf0[NK_UART_TXBUF_SIZE];
+#endif
+
+nk_uart_t nk_uart0 = {
+	.ucsra = &UCSRA,
+	.ucsrb = &UCSRB,
+	.ucsrc = &UCSRC,
+	.udr = &UDR,
+	.ubrrl = &UBRRL,
+	.ubrrh = &UBRRH,
+	.ubrr = BAUD_UBRR(BAUD),
+	.baud = BAUD,
+	.lock = &console_lock,
+	.rx_buf = rx_buf0,
+	.rx_mask = NK_UART_RXBUF_SIZE - 1,
+#ifdef NK_UART_TXBUF_SIZE
+	.tx_buf = tx_buf0,
+	.tx_mask = NK_UART_TXBUF_SIZE - 1,
+#endif
+#ifdef NK_UART_CTS_PIN
+	.cts_pin = &NK_UART_CTS_PIN,
+	.cts_mask = (1 << NK_UART_CTS_BIT),
+#endif
+#ifdef NK_UART_RTS_PORT
+	.rts_port = &NK_UART_RTS_PORT,
+	.rts_mask = (1 << NK_UART_RTS_BIT),
+#endif
+	.rx_event = NK_EVENT_INIT,
+#ifdef NK_SCHED_ISR_SOURCES
+	.rx_isr_source = -1,
+#endif
+};
+
+#ifdef NK_UART1_RXBUF_SIZE
+
+// Second USART (ATmega328PB)
+
+static nk_spinlock_t uart1_lock = SPIN_LOCK_UNLOCKED;
+
+static unsigned char rx_buf1[NK_UART1_RXBUF_SIZE];
+#ifdef NK_UART1_TXBUF_SIZE
+static unsigned char tx_buf1[NK_UART1_TXBUF_SIZE];
+#endif
+
+nk_uart_t nk_uart1 = {
+	.ucsra = &UCSR1A,
+	.ucsrb = &UCSR1B,
+	.ucsrc = &UCSR1C,
+	.udr = &UDR1,
+	.ubrrl = &UBRR1L,
+	.ubrrh = &UBRR1H,
+	.ubrr = BAUD_UBRR(NK_UART1_BAUD),
+	.baud = NK_UART1_BAUD,
+	.lock = &uart1_lock,
+	.rx_buf = rx_buf1,
+	.rx_mask = NK_UART1_RXBUF_SIZE - 1,
+#ifdef NK_UART1_TXBUF_SIZE
+	.tx_buf = tx_buf1,
+	.tx_mask = NK_UART1_TXBUF_SIZE - 1,
+#endif
+#ifdef NK_UART1_CTS_PIN
+	.cts_pin = &NK_UART1_CTS_PIN,
+	.cts_mask = (1 << NK_UART1_CTS_BIT),
+#endif
+#ifdef NK_UART1_RTS_PORT
+	.rts_port = &NK_UART1_RTS_PORT,
+	.rts_mask = (1 << NK_UART1_RTS_BIT),
+#endif
+	.rx_event = NK_EVENT_INIT,
+#ifdef NK_SCHED_ISR_SOURCES
+	.rx_isr_source = -1,
+#endif
+};
+
+#endif
+
+// Number of characters in Rx buffer
+#define rx_count(u) ((rx_idx_t)((u)->rx_wr - (u)->rx_rd))
+
+// Clear transmit complete flag: it's write one to clear, and the error flags
+// must be written as zero
+
+#define clear_txc(u) UART_WR(u, ucsra, (UART_RD(u, ucsra) & (1 << U2X)) | (1 << TXC))
+
+#ifdef NK_UART_RX_WAKE_THRESHOLD
+
+// Runs in place of the waiting task when the event is signaled or the idle
+// timeout expires.  The interrupt handler only records the time of the last
+// data, so the timeout is extended here instead of on every character.
+
+static void rx_idle_check(void *data)
 {
-        nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
-	if (rx_buf_rd != rx_buf_wr) {
+	nk_uart_t *u = (nk_uart_t *)data;
+	nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+	nk_time_t idle = nk_convert_delay(NK_UART_RX_WAKE_IDLE);
+	nk_time_t quiet = nk_get_time() - u->rx_last;
+	if (rx_count(u) && rx_count(u) < NK_UART_RX_WAKE_THRESHOLD && quiet < idle) {
+		// Still receiving: wait for the rest of the idle time
+		uint32_t ms = (uint32_t)(((idle - quiet) * 1000UL + NK_TIME_COUNTS_PER_SECOND - 1) / NK_TIME_COUNTS_PER_SECOND);
+		nk_event_wait(&u->rx_event, u->rx_tid, rx_idle_check, u, ms, "UART idle");
+	} else {
+		u->rx_idle_armed = 0;
+		nk_sched(u->rx_tid, u->rx_func, u->rx_data, 0, "UART ISR");
+	}
+	nk_irq_unlock(u->lock, irq_flag);
+}
+
+#endif
+
+void nk_uart_set_callback(nk_uart_t *u, int tid, void (*func)(void *data), void *data)
+{
+        nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+#ifdef NK_UART_RX_WAKE_THRESHOLD
+	u->rx_tid = tid;
+	u->rx_func = func;
+	u->rx_data = data;
+	u->rx_idle_armed = 0;
+	if (rx_count(u) >= NK_UART_RX_WAKE_THRESHOLD) {
+		nk_sched(tid, func, data, 0, "UART ISR");
+	} else {
+		// Wait for more, but not forever if we have some
+		if (rx_count(u)) {
+			u->rx_last = nk_get_time();
+			u->rx_idle_armed = 1;
+		}
+		nk_event_wait(&u->rx_event, tid, rx_idle_check, u, u->rx_idle_armed ? NK_UART_RX_WAKE_IDLE : NK_EVENT_FOREVER, "UART idle");
+#else
+	if (u->rx_rd != u->rx_wr) {
 		// Data is available now
 		nk_sched(tid, func, data, 0, "UART ISR");
-		waiting_rx_task = 0;
 	} else {
-		waiting_rx_tid = tid;
-		waiting_rx_task = func;
-		waiting_rx_task_data = data;
+		nk_event_wait(&u->rx_event, tid, func, data, NK_EVENT_FOREVER, "UART ISR");
+#endif
+#ifdef NK_SCHED_ISR_SOURCES
+		if (u->rx_isr_source != -1)
+			nk_set_isr_source(u->rx_isr_source, tid, func, data, "UART ISR");
+#endif
 	}
-	nk_irq_unlock(&console_lock, irq_flag);
+	nk_irq_unlock(u->lock, irq_flag);
 }
 
-int nk_get_uart_mode()
+#ifdef UART_FLOW
+
+// True if the other side has asked us to stop sending
+
+static inline uint8_t tx_stopped(nk_uart_t *u)
 {
-	return tty_mode;
+	if (u->cts_pin && (UART_RD(u, cts_pin) & u->cts_mask))
+		return 1;
+	return u->tx_xoff;
 }
 
-int nk_set_uart_mode(int new_mode)
+#ifdef NK_UART_XONXOFF
+
+// Send XON or XOFF ahead of any buffered output, called with interrupts
+// disabled
+
+static void send_xchar(nk_uart_t *u, uint8_t c)
+{
+#ifdef UART_TX_RING
+	if (u->tx_buf) {
+		u->tx_xchar = c;
+		UART_WR(u, ucsrb, UART_RD(u, ucsrb) | (1 << UDRIE));
+		return;
+	}
+#endif
+	while (!(UART_RD(u, ucsra) & (1 << UDRE)));
+	clear_txc(u);
+	UART_WR(u, udr, c);
+	u->tx_started = 1;
+}
+
+#endif
+
+// Ask the other side to stop or start sending, called with interrupts
+// disabled
+
+static void rx_flow(nk_uart_t *u, uint8_t stop)
 {
-	int old_mode = tty_mode;
-	tty_mode = new_mode;
+	u->rx_stopped = stop;
+	if (u->rts_port) {
+		if (stop)
+			UART_WR(u, rts_port, UART_RD(u, rts_port) | u->rts_mask);
+		else
+			UART_WR(u, rts_port, UART_RD(u, rts_port) & ~u->rts_mask);
+	}
+#ifdef NK_UART_XONXOFF
+	// Binary mode: XON and XOFF are data
+	if (!u->tty_mode)
+		send_xchar(u, stop ? XOFF : XON);
+#endif
+}
+
+// Stop the other side when the Rx buffer is 3/4 full, start it again once
+// it's down to 1/4
+
+#define rx_stop_level(u) ((rx_idx_t)((u)->rx_mask - ((u)->rx_mask >> 2)))
+#define rx_start_level(u) ((rx_idx_t)(((u)->rx_mask + 1) >> 2))
+
+#endif
+
+int nk_uart_get_mode(nk_uart_t *u)
+{
+	return u->tty_mode;
+}
+
+int nk_uart_set_mode(nk_uart_t *u, int new_mode)
+{
+	int old_mode = u->tty_mode;
+#ifdef NK_UART_XONXOFF
+	nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+	if (new_mode && !old_mode) {
+		// XON and XOFF become data: forget any XOFF, and don't leave the
+		// other side stopped by one
+		u->tx_xoff = 0;
+		if (u->rx_stopped)
+			send_xchar(u, XON);
+	} else if (!new_mode && old_mode && u->rx_stopped) {
+		send_xchar(u, XOFF);
+	}
+	u->tty_mode = (uint8_t)new_mode;
+	nk_irq_unlock(u->lock, irq_flag);
+#else
+	u->tty_mode = (uint8_t)new_mode;
+#endif
 	return old_mode;
 }
 
-static void wait_for_space()
+static void rx_chars(nk_uart_t *u);
+
+// No Tx buffer: spin until data register is empty
+
+static void tx_put_direct(nk_uart_t *u, unsigned char ch)
 {
-    while (!(UCSRA & (1 << UDRE))) ;
+	nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+#ifdef UART_FLOW
+	// Keep receiving while we wait, to see XON
+	while (!(UART_RD(u, ucsra) & (1 << UDRE)) || tx_stopped(u))
+		rx_chars(u);
+#else
+	while (!(UART_RD(u, ucsra) & (1 << UDRE)));
+#endif
+	clear_txc(u);
+	UART_WR(u, udr, ch);
+	u->tx_started = 1;
+	nk_irq_unlock(u->lock, irq_flag);
 }
 
-void nk_putc(char ch)
+#ifdef UART_TX_RING
+
+// Send oldest character from Tx buffer, called with interrupts disabled
+
+static void tx_send(nk_uart_t *u)
+{
+	clear_txc(u);
+	UART_WR(u, udr, u->tx_buf[u->tx_rd & u->tx_mask]);
+	u->tx_rd = (tx_idx_t)(u->tx_rd + 1);
+	u->tx_started = 1;
+}
+
+static inline void udre_isr(nk_uart_t *u)
+{
+#ifdef UART_FLOW
+	if (u->tx_xchar) {
+		clear_txc(u);
+		UART_WR(u, udr, u->tx_xchar);
+		u->tx_xchar = 0;
+		u->tx_started = 1;
+	} else if (u->tx_rd != u->tx_wr && !tx_stopped(u))
+#else
+	if (u->tx_rd != u->tx_wr)
+#endif
+		tx_send(u);
+	else
+		UART_WR(u, ucsrb, UART_RD(u, ucsrb) & ~(1 << UDRIE)); // Empty or stopped: stop interrupting
+}
+
+ISR(USART_UDRE_vect)
+{
+	udre_isr(&nk_uart0);
+}
+
+#if defined(NK_UART1_RXBUF_SIZE) && defined(NK_UART1_TXBUF_SIZE)
+ISR(USART1_UDRE_vect)
 {
-        nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
-	if (!tty_mode && ch == '\n') {
-		wait_for_space();
-		UDR = '\r';
+	udre_isr(&nk_uart1);
+}
+#endif
+
+// Make progress on output by hand when interrupts are disabled
+
+static void tx_poll(nk_uart_t *u)
+{
+	if (UART_RD(u, ucsra) & (1 << UDRE))
+		udre_isr(u);
+#ifdef UART_FLOW
+	rx_chars(u); // Watch for XON
+#endif
+}
+
+// Append to Tx buffer.  If the buffer is full, either wait for space or drop
+// the character (NK_UART_TX_DROP).  Interrupts are only disabled for a few
+// cycles at a time, unless we are called with them disabled: then we have to
+// make space by sending characters ourselves.
+
+static void tx_put(nk_uart_t *u, unsigned char ch)
+{
+	nk_irq_flag_t irq_flag;
+	if (!u->tx_buf) {
+		tx_put_direct(u, ch);
+		return;
+	}
+	irq_flag = nk_irq_lock(u->lock);
+	while ((tx_idx_t)(u->tx_wr - u->tx_rd) == (tx_idx_t)(u->tx_mask + 1)) {
+#ifdef NK_UART_TX_DROP
+		nk_irq_unlock(u->lock, irq_flag);
+		return;
+#else
+		if (irq_flag & (1 << SREG_I)) {
+			// Let the interrupt make space
+			nk_irq_unlock(u->lock, irq_flag);
+			irq_flag = nk_irq_lock(u->lock);
+		} else {
+			tx_poll(u);
+		}
+#endif
 	}
-	wait_for_space();
-        UDR = ch;
-	nk_irq_unlock(&console_lock, irq_flag);
+	u->tx_buf[u->tx_wr & u->tx_mask] = ch;
+	u->tx_wr = (tx_idx_t)(u->tx_wr + 1);
+	UART_WR(u, ucsrb, UART_RD(u, ucsrb) | (1 << UDRIE));
+	nk_irq_unlock(u->lock, irq_flag);
 }
 
-void nk_puts(const char *s)
+void nk_uart_drain(nk_uart_t *u)
+{
+	nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+	if (u->tx_buf) {
+		while (u->tx_rd != u->tx_wr) {
+			if (irq_flag & (1 << SREG_I)) {
+				nk_irq_unlock(u->lock, irq_flag);
+				irq_flag = nk_irq_lock(u->lock);
+			} else {
+				tx_poll(u);
+			}
+		}
+	}
+	// Wait for last character to leave shift register
+	if (u->tx_started)
+		while (!(UART_RD(u, ucsra) & (1 << TXC)));
+	nk_irq_unlock(u->lock, irq_flag);
+}
+
+#else
+
+#define tx_put(u, ch) tx_put_direct(u, ch)
+
+void nk_uart_drain(nk_uart_t *u)
+{
+	// Wait for last character to leave shift register
+	if (u->tx_started)
+		while (!(UART_RD(u, ucsra) & (1 << TXC)));
+}
+
+#endif
+
+#ifdef UART_FLOW
+
+// Call from the CTS pin change interrupt: restart output
+
+void nk_uart_cts_changed(nk_uart_t *u)
+{
+#ifdef UART_TX_RING
+	nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+	if (u->tx_buf && u->tx_rd != u->tx_wr && !tx_stopped(u))
+		UART_WR(u, ucsrb, UART_RD(u, ucsrb) | (1 << UDRIE));
+	nk_irq_unlock(u->lock, irq_flag);
+#else
+	(void)u;
+#endif
+}
+
+#endif
+
+void nk_uart_putc(nk_uart_t *u, char ch)
+{
+	if (!u->tty_mode && ch == '\n')
+		tx_put(u, '\r');
+	tx_put(u, (unsigned char)ch);
+}
+
+void nk_uart_puts(nk_uart_t *u, const char *s)
 {
-        nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
 	while (*s) {
-		nk_putc(*s++);
+		nk_uart_putc(u, *s++);
 	}
-	nk_irq_unlock(&console_lock, irq_flag);
 }
 
-void nk_uart_write(const char *s, int len)
+void nk_uart_send(nk_uart_t *u, const char *s, int len)
 {
-	nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
 	while (len--) {
-		nk_putc(*s++);
+		nk_uart_putc(u, *s++);
 	}
-	nk_irq_unlock(&console_lock, irq_flag);
 }
 
 // Transfer any available characters from UART FIFO to input buffer
 
-static void rx_chars(void)
+static void rx_chars(nk_uart_t *u)
 {
-	while (UCSRA & (1 << RXC)) {
-		uint8_t c = UDR;
-		if (rx_buf_wr - rx_buf_rd != sizeof(rx_buf)) {
-			rx_buf[rx_buf_wr++ & (sizeof(rx_buf) - 1)] = c;
+	uint8_t status;
+	// Error flags belong to the character in UDR: read them first
+	while ((status = UART_RD(u, ucsra)) & (1 << RXC)) {
+		uint8_t c = UART_RD(u, udr);
+		rx_idx_t count = rx_count(u);
+		if (status & (1 << DOR))
+			++u->stats.overrun;
+		if (status & (1 << FE))
+			++u->stats.framing;
+#ifdef NK_UART_XONXOFF
+		if (!u->tty_mode && (c == XON || c == XOFF)) {
+			u->tx_xoff = (c == XOFF);
+#ifdef UART_TX_RING
+			if (!u->tx_xoff && u->tx_buf && u->tx_rd != u->tx_wr)
+				UART_WR(u, ucsrb, UART_RD(u, ucsrb) | (1 << UDRIE));
+#endif
+			continue;
+		}
+#endif
+		if (count != (rx_idx_t)(u->rx_mask + 1)) {
+			u->rx_buf[u->rx_wr & u->rx_mask] = c;
+			u->rx_wr = (rx_idx_t)(u->rx_wr + 1);
+			if (count >= u->stats.high_water)
+				u->stats.high_water = (uint16_t)(count + 1);
+#ifdef UART_FLOW
+			if (count >= rx_stop_level(u) && !u->rx_stopped)
+				rx_flow(u, 1);
+#endif
+		} else {
+			++u->stats.dropped;
 		}
 	}
 }
 
-// Interrupt if characters are available: but Apollo gives interrupt on 4 byte units, not single byte, so
-// we still have to poll.
+static inline void rx_isr(nk_uart_t *u)
+{
+	rx_chars(u);
+	if (nk_event_waiting(&u->rx_event)) {
+#ifdef NK_UART_RX_WAKE_THRESHOLD
+		u->rx_last = nk_get_time();
+		if (rx_count(u) < NK_UART_RX_WAKE_THRESHOLD) {
+			// Not enough yet: start the idle timeout on the first data of a
+			// burst, rx_idle_check() extends it
+			if (!u->rx_idle_armed) {
+				u->rx_idle_armed = 1;
+				nk_event_wait(&u->rx_event, u->rx_tid, rx_idle_check, u, NK_UART_RX_WAKE_IDLE, "UART idle");
+			}
+			return;
+		}
+#endif
+#ifdef NK_SCHED_ISR_SOURCES
+		// The posted task replaces the waiting one, which ends the wait
+		if (u->rx_isr_source != -1)
+			nk_sched_from_isr(u->rx_isr_source);
+		else
+#endif
+		nk_event_signal(&u->rx_event);
+	}
+}
 
 ISR(USART_RXC_vect)
 {
-	rx_chars();
-	if (waiting_rx_task) {
-		nk_sched(waiting_rx_tid, waiting_rx_task, waiting_rx_task_data, 0, "UART ISR");
-		waiting_rx_task = 0;
-	}
+	rx_isr(&nk_uart0);
 }
 
-int nk_getc()
+#ifdef NK_UART1_RXBUF_SIZE
+ISR(USART1_RX_vect)
+{
+	rx_isr(&nk_uart1);
+}
+#endif
+
+int nk_uart_getc(nk_uart_t *u)
 {
 	int ch = -1;
-        nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
-        rx_chars();
-	if (rx_buf_rd != rx_buf_wr) {
-		ch = rx_buf[rx_buf_rd++ & (sizeof(rx_buf) - 1)];
+        nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+        rx_chars(u);
+	if (u->rx_rd != u->rx_wr) {
+		ch = u->rx_buf[u->rx_rd & u->rx_mask];
+		u->rx_rd = (rx_idx_t)(u->rx_rd + 1);
+#ifdef UART_FLOW
+		if (u->rx_stopped && rx_count(u) <= rx_start_level(u))
+			rx_flow(u, 0);
+#endif
 	}
-	nk_irq_unlock(&console_lock, irq_flag);
+	nk_irq_unlock(u->lock, irq_flag);
 	return ch;
 }
 
-int nk_kbhit()
+int nk_uart_kbhit(nk_uart_t *u)
 {
-        nk_irq_flag_t irq_flag = nk_irq_lock(&console_lock);
-	if (rx_buf_rd != rx_buf_wr) {
-		nk_irq_unlock(&console_lock, irq_flag);
-		return 1;
-	} else {
-		nk_irq_unlock(&console_lock, irq_flag);
-		return 0;
+	int rtn;
+        nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+	rtn = (u->rx_rd != u->rx_wr);
+	nk_irq_unlock(u->lock, irq_flag);
+	return rtn;
+}
+
+void nk_uart_stats(nk_uart_t *u, nk_uart_stats_t *stats, int clear)
+{
+	nk_irq_flag_t irq_flag = nk_irq_lock(u->lock);
+	*stats = u->stats;
+	if (clear) {
+		memset(&u->stats, 0, sizeof(u->stats));
+		u->stats.high_water = rx_count(u);
 	}
+	nk_irq_unlock(u->lock, irq_flag);
 }
 
-int nk_uart_read(char *s, int len, nk_time_t timeout)
+int nk_uart_recv(nk_uart_t *u, char *s, int len, uint32_t timeout)
 {
 	int l = 0;
 	int need_time = 1;
-	nk_time_t old_time;
-	nk_time_t clocks = timeout * NK_TIME_COUNTS_PER_USECOND;
+	nk_time_t old_time = 0;
+	nk_time_t clocks = nk_convert_delay(timeout);
 	while (l != len) {
-		int c = nk_getc();
+		int c = nk_uart_getc(u);
 		if (c != -1) {
 			s[l++] = (char)c;
 			need_time = 1;
@@ -206,27 +796,139 @@ int nk_uart_read(char *s, int len, nk_time_t timeout)
 	return l;
 }
 
-// UART configuration settings.
+// Load baud rate divisor and U2X.  Writing zero to TXC leaves it alone.
 
-#define UBRR_VALUE ((F_CPU / (BAUD * 16UL)) - 1)
+static void set_ubrr(nk_uart_t *u)
+{
+	UART_WR(u, ucsra, (u->ubrr & UBRR_U2X) ? (1 << U2X) : 0);
+	UART_WR(u, ubrrh, (u->ubrr & ~UBRR_U2X) >> 8);
+	UART_WR(u, ubrrl, u->ubrr);
+}
 
-void nk_init_uart()
+// Look up rate in the table: NULL if we can't generate it accurately enough
+
+static const NK_FLASH struct baud_rate *find_baud(uint32_t baud)
+{
+	uint8_t x;
+	for (x = 0; x != sizeof(baud_rates) / sizeof(baud_rates[0]); ++x)
+		if (baud_rates[x].baud == baud) {
+			if (baud_rates[x].err > NK_UART_BAUD_MAX_ERROR || baud_rates[x].err < -NK_UART_BAUD_MAX_ERROR)
+				return NULL;
+			return &baud_rates[x];
+		}
+	return NULL;
+}
+
+int nk_uart_check_baud(nk_uart_t *u, uint32_t baud)
+{
+	(void)u;
+	return find_baud(baud) ? 0 : -1;
+}
+
+int nk_uart_set_baud(nk_uart_t *u, uint32_t baud)
+{
+	nk_irq_flag_t irq_flag;
+	const NK_FLASH struct baud_rate *rate = find_baud(baud);
+	if (!rate)
+		return -1;
+	// Finish sending at the old rate
+	nk_uart_drain(u);
+	irq_flag = nk_irq_lock(u->lock);
+	u->ubrr = rate->ubrr;
+	u->baud = baud;
+	set_ubrr(u);
+	nk_irq_unlock(u->lock, irq_flag);
+	return 0;
+}
+
+uint32_t nk_uart_get_baud(nk_uart_t *u)
+{
+	return u->baud;
+}
+
+// UART configuration settings.
+
+void nk_uart_init(nk_uart_t *u)
 {
+#ifdef NK_SCHED_ISR_SOURCES
+   u->rx_isr_source = nk_alloc_isr_source();
+#endif
    // Set up UART
    // Set baud
-   UBRRH = (UBRR_VALUE >> 8);
-   UBRRL = (UBRR_VALUE);
+   set_ubrr(u);
    // Enable Tx, Rx and Rx interrupts
-   UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
+   UART_WR(u, ucsrb, (1 << RXEN) | (1 << TXEN) | (1 << RXCIE));
 
    // Set format
-   UCSRC =
+   UART_WR(u, ucsrc,
      0
 #ifdef URSEL
      | (1 << URSEL) // Select UCSRC regsiter on ATmega32
 #endif
      | (1 << USBS) // Two stop bits
-     | (3 << UCSZ0); // 8 data bits
-     ;
+     | (3 << UCSZ0) // 8 data bits
+     );
    sei();
 }
+
+// The console functions use nk_uart0
+
+void nk_set_uart_callback(int tid, void (*func)(void *data), void *data)
+{
+	nk_uart_set_callback(&nk_uart0, tid, func, data);
+}
+
+int nk_get_uart_mode()
+{
+	return nk_uart_get_mode(&nk_uart0);
+}
+
+int nk_set_uart_mode(int new_mode)
+{
+	return nk_uart_set_mode(&nk_uart0, new_mode);
+}
+
+void nk_putc(char ch)
+{
+	nk_uart_putc(&nk_uart0, ch);
+}
+
+void nk_puts(const char *s)
+{
+	nk_uart_puts(&nk_uart0, s);
+}
+
+void nk_uart_write(const char *s, int len)
+{
+	nk_uart_send(&nk_uart0, s, len);
+}
+
+void nk_uart_flush()
+{
+	nk_uart_drain(&nk_uart0);
+}
+
+int nk_getc()
+{
+	return nk_uart_getc(&nk_uart0);
+}
+
+int nk_kbhit()
+{
+	return nk_uart_kbhit(&nk_uart0);
+}
+
+void nk_uart_get_stats(nk_uart_stats_t *stats, int clear)
+{
+	nk_uart_stats(&nk_uart0, stats, clear);
+}
+
+int nk_uart_read(char *s, int len, uint32_t timeout)
+{
+	return nk_uart_recv(&nk_uart0, s, len, timeout);
+}
+
+void nk_init_uart()
+{
+	nk_uart_init(&nk_uart0);
+}
@@ -0,0 +1,6 @@
+// Host model of avr/interrupt.h
+
+#define ISR(vector) void vector(void); void vector(void)
+
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= (uint8_t)~0x80)
@@ -0,0 +1,26 @@
+// Host model of the AVR registers used by nkarch_avr.c (ATmega328p names)
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t MCUSR;
+
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2, ASSR;
+
+#define WGM21 1
+#define CS20 0
+
+#define TOIE2 0
+#define OCIE2A 1
+
+#define TOV2 0
+#define OCF2A 1
+
+#define AS2 5
+#define TCN2UB 4
+#define OCR2AUB 3
+#define OCR2BUB 2
+#define TCR2AUB 1
+#define TCR2BUB 0
+
+#define FLASHEND 0x7FFF
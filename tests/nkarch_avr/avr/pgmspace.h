@@ -0,0 +1,6 @@
+// Host model of avr/pgmspace.h: there is only one address space
+
+#include <string.h>
+
+#define PSTR(s) (s)
+#define strlen_P(s) strlen(s)
@@ -0,0 +1,12 @@
+// Host model of avr/sleep.h: sleep_cpu() runs the timer model until an
+// interrupt is taken
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_SAVE 3
+
+void model_sleep(void);
+
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable() ((void)0)
+#define sleep_disable() ((void)0)
+#define sleep_cpu() model_sleep()
@@ -0,0 +1,155 @@
+// Host model of AVR timer 2 and sleep
+//
+// Time only passes while the CPU is asleep, or when another model charges
+// for CPU cycles with model_cpu().  model_sleep() advances timer 2 one count
+// at a time until it raises an enabled interrupt, then calls the interrupt
+// handler from nkarch_avr.c.
+
+#define NK_AVR_MODEL
+
+#include <stdint.h>
+#include "nkarch.h"
+#include "nkarch_avr_model.h"
+
+volatile uint8_t SREG;
+volatile uint8_t MCUSR;
+volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2, ASSR;
+
+uint64_t model_cycles;
+unsigned long model_wakeups;
+
+// Compare match flag is write-one-to-clear on the real part, so keep it
+// here and treat a 1 written to TIFR2 as a clear request.
+static int ocf_pending;
+
+// Interrupt handlers from nkarch_avr.c
+void TIMER2_COMPA_vect(void) __attribute__((weak));
+void TIMER2_OVF_vect(void) __attribute__((weak));
+
+// Other peripheral models, if the test has any
+void model_peripheral_step(void) __attribute__((weak));
+model_isr_t model_peripheral_interrupt(void) __attribute__((weak));
+
+static unsigned long prescale(void)
+{
+    switch ((TCCR2B >> CS20) & 7) {
+        case 1: return 1;
+        case 2: return 8;
+        case 3: return 32;
+        case 4: return 64;
+        case 5: return 128;
+        case 6: return 256;
+        case 7: return 1024;
+        default: return 0;
+    }
+}
+
+// Advance timer 2 by one count
+
+static void timer_step(void)
+{
+    if (TIFR2 & (1 << OCF2A)) {
+        TIFR2 &= (uint8_t)~(1 << OCF2A);
+        ocf_pending = 0;
+    }
+    if (ASSR & (1 << AS2)) {
+        // Clocked from a 32.768 kHz crystal: convert to CPU cycles.  Writes
+        // to the timer take effect at once, so ASSR never shows busy.
+        static uint64_t frac;
+        frac += (uint64_t)prescale() * F_CPU;
+        model_cycles += frac / 32768;
+        frac %= 32768;
+    } else {
+        model_cycles += prescale();
+    }
+    if (TCCR2A & (1 << WGM21)) {
+        // Clear timer on compare match
+        if (TCNT2 == OCR2A) {
+            TCNT2 = 0;
+            ocf_pending = 1;
+        } else {
+            ++TCNT2;
+        }
+    } else {
+        if (++TCNT2 == 0)
+            TIFR2 |= (1 << TOV2);
+        if (TCNT2 == OCR2A)
+            ocf_pending = 1;
+    }
+    if (model_peripheral_step)
+        model_peripheral_step();
+}
+
+// Take one pending interrupt, return true if one was taken
+
+static int take_interrupt(void)
+{
+    if (!(SREG & 0x80))
+        return 0;
+    if (ocf_pending && (TIMSK2 & (1 << OCIE2A)) && TIMER2_COMPA_vect) {
+        ocf_pending = 0;
+        SREG &= (uint8_t)~0x80;
+        TIMER2_COMPA_vect();
+        SREG |= 0x80;
+        return 1;
+    }
+    if ((TIFR2 & (1 << TOV2)) && (TIMSK2 & (1 << TOIE2)) && TIMER2_OVF_vect) {
+        TIFR2 &= (uint8_t)~(1 << TOV2);
+        SREG &= (uint8_t)~0x80;
+        TIMER2_OVF_vect();
+        SREG |= 0x80;
+        return 1;
+    }
+    if (model_peripheral_interrupt) {
+        model_isr_t isr = model_peripheral_interrupt();
+        if (isr) {
+            SREG &= (uint8_t)~0x80;
+            isr();
+            SREG |= 0x80;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void model_sleep(void)
+{
+    if (!prescale())
+        return; // Timer stopped: nothing would ever wake us
+    while (!take_interrupt())
+        timer_step();
+    ++model_wakeups;
+}
+
+// Let the timer run as if a task was busy.  Interrupts are taken if they
+// are enabled.
+
+void model_busy(unsigned long counts)
+{
+    while (counts--) {
+        timer_step();
+        take_interrupt();
+    }
+}
+
+// Charge for CPU cycles spent running code.  Timer 2 counts, and one
+// interrupt is taken if any is pending.
+
+void model_cpu(unsigned long cycles)
+{
+    static unsigned long pending;
+    unsigned long p = prescale();
+    if (!p) {
+        // Timer stopped
+        model_cycles += cycles;
+        if (model_peripheral_step)
+            model_peripheral_step();
+    } else {
+        pending += cycles;
+        while (pending >= p) {
+            pending -= p;
+            timer_step();
+        }
+    }
+    take_interrupt();
+}
@@ -0,0 +1,24 @@
+// Host model of AVR timer 2 and sleep
+
+#include <stdint.h>
+
+// CPU cycles since reset
+extern uint64_t model_cycles;
+
+// Number of times the CPU woke up from sleep
+extern unsigned long model_wakeups;
+
+// Let the timer run for some counts, as if a task was busy
+void model_busy(unsigned long counts);
+
+// Let the CPU run for some cycles, taking interrupts if they are enabled
+void model_cpu(unsigned long cycles);
+
+// Hooks for other peripheral models: model_peripheral_step() is called
+// whenever time advances, model_peripheral_interrupt() returns the handler
+// for a pending interrupt, or NULL.
+
+typedef void (*model_isr_t)(void);
+
+void model_peripheral_step(void);
+model_isr_t model_peripheral_interrupt(void);
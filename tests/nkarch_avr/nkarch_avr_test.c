@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "nksched.h"
+#include "nkarch_avr_model.h"
+
+// Run the scheduler on the timer 2 model for two seconds and count wakeups
+
+int tid_periodic, tid_short, tid_long, tid_busy, tid_end;
+
+nk_time_t start;
+int periodic_runs;
+int32_t max_late;
+int32_t min_late;
+
+void check_late(nk_time_t deadline)
+{
+    int32_t late = (int32_t)(nk_get_time() - deadline);
+    if (late > max_late)
+        max_late = late;
+    if (late < min_late)
+        min_late = late;
+}
+
+void periodic_task(void *data)
+{
+    (void)data;
+    ++periodic_runs;
+    check_late(start + nk_convert_delay(100) * (nk_time_t)periodic_runs);
+}
+
+void short_task(void *data)
+{
+    (void)data;
+    printf("Short task lateness: %ld ticks\n", (long)(nk_get_time() - (start + nk_convert_delay(5))));
+}
+
+void long_task(void *data)
+{
+    (void)data;
+    printf("Long task lateness: %ld ticks\n", (long)(nk_get_time() - (start + nk_convert_delay(1234))));
+}
+
+void busy_task(void *data)
+{
+    nk_irq_flag_t irq_flag;
+    nk_time_t before, after;
+    (void)data;
+    // Timer overflows while interrupts are disabled
+    irq_flag = nk_irq_lock(&sched_lock);
+    before = nk_get_time();
+    model_busy(200);
+    after = nk_get_time();
+    nk_irq_unlock(&sched_lock, irq_flag);
+    printf("Time advanced by %lu ticks in 200 timer counts with interrupts off\n", (unsigned long)(after - before));
+}
+
+void end_task(void *data)
+{
+    (void)data;
+    printf("Periodic task: %d runs, lateness %ld to %ld ticks\n", periodic_runs, (long)min_late, (long)max_late);
+    printf("Simulated time: %lu ms\n", (unsigned long)(model_cycles / (F_CPU / 1000)));
+    printf("Wakeups: %lu\n", model_wakeups);
+    fflush(stdout);
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    nk_init_sched();
+#ifdef NK_AVR_TIMER2_ASYNC
+    // Timer 2 keeps running in power-save mode
+    nk_set_sched_sleep_mode(2);
+#else
+    nk_set_sched_sleep_mode(1);
+#endif
+
+#ifdef NK_AVR_TIMER2_ASYNC
+    printf("Tickless from 32.768 kHz crystal: %lu ticks per second\n", (unsigned long)NK_TIME_COUNTS_PER_SECOND);
+#elif defined(NK_AVR_TICKLESS)
+    printf("Tickless: %lu ticks per second\n", (unsigned long)NK_TIME_COUNTS_PER_SECOND);
+#else
+    printf("1 kHz tick: %lu ticks per second\n", (unsigned long)NK_TIME_COUNTS_PER_SECOND);
+#endif
+
+    start = nk_get_time();
+    min_late = 0x7FFFFFFF;
+    max_late = -0x7FFFFFFF;
+
+    tid_periodic = nk_alloc_tid();
+    tid_short = nk_alloc_tid();
+    tid_long = nk_alloc_tid();
+    tid_busy = nk_alloc_tid();
+    tid_end = nk_alloc_tid();
+
+    nk_sched_periodic(tid_periodic, periodic_task, NULL, 100, 100, NK_SCHED_CATCHUP, "Periodic");
+    nk_sched(tid_short, short_task, NULL, 5, "Short");
+    nk_sched(tid_long, long_task, NULL, 1234, "Long");
+    nk_sched(tid_busy, busy_task, NULL, 503, "Busy");
+    nk_sched(tid_end, end_task, NULL, 2000, "End");
+
+    nk_sched_loop();
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+// The Makefile selects tick or tickless with -DNK_AVR_TICKLESS, and the
+// crystal clock with -DNK_AVR_TIMER2_ASYNC
+
+// avr-gcc named address space, not needed on the host
+#define __flash
+
+#include "nkarch_avr.h"
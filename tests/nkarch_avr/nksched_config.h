@@ -0,0 +1,4 @@
+#define NK_WORK_QUEUE_SIZE 8
+
+#define NK_SCHED_PERIODIC
+#define NK_SCHED_EVENTS
@@ -0,0 +1,66 @@
+// Host model of the AVR registers used by nkarch_avr.c and nkuart_avr.c
+// (ATmega328p names)
+//
+// Outside of the models themselves, SREG and the USART registers are
+// accessed through functions, so that every access costs a CPU cycle and
+// the USART model sees reads and writes.
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t MCUSR;
+
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2, ASSR;
+
+#define WGM21 1
+#define CS20 0
+
+#define TOIE2 0
+#define OCIE2A 1
+
+#define TOV2 0
+#define OCF2A 1
+
+#define AS2 5
+#define TCN2UB 4
+#define OCR2AUB 3
+#define OCR2BUB 2
+#define TCR2AUB 1
+#define TCR2BUB 0
+
+#define SREG_I 7
+
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0, UBRR0L, UBRR0H;
+
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define U2X0 1
+
+#define RXCIE0 7
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+
+#define USBS0 3
+#define UCSZ00 1
+
+// Flow control pins
+extern volatile uint8_t PIND, PORTD, DDRD;
+
+#ifndef NK_AVR_MODEL
+
+volatile uint8_t *model_sreg(void);
+#define SREG (*model_sreg())
+
+uint8_t model_rd(volatile uint8_t *reg);
+void model_wr(volatile uint8_t *reg, uint8_t val);
+
+#define UART_RD(u, reg) model_rd((u)->reg)
+#define UART_WR(u, reg, val) model_wr((u)->reg, (uint8_t)(val))
+
+#endif
+
+#define FLASHEND 0x7FFF
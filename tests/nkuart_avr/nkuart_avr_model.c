@@ -0,0 +1,302 @@
+// Host model of AVR USART 0 and the device at the other end of its line
+//
+// The USART has a one character transmit holding register, a two
+// character receive FIFO, and interrupts.  Characters take their real time
+// on the line, given by the baud rate registers.
+//
+// The other end ("peer") is a slow consumer with a small buffer: it stops
+// the AVR with XOFF or CTS when its buffer is half full.  It can also send
+// the test pattern to the AVR, honouring XOFF or RTS from the AVR.
+
+#define NK_AVR_MODEL
+
+#include <stddef.h>
+#include "nkarch.h"
+#include "nkarch_avr_model.h"
+#include "nkuart_avr_model.h"
+
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0, UBRR0L, UBRR0H;
+volatile uint8_t PIND, PORTD, DDRD;
+
+// Flow control pins, as wired by the Makefile
+#define CTS_BIT 2
+#define RTS_BIT 3
+
+#define XON 0x11
+#define XOFF 0x13
+
+unsigned long model_peer_rx_count;
+unsigned long model_peer_rx_errors;
+unsigned long model_peer_rx_lost;
+unsigned long model_peer_stops;
+unsigned long model_avr_stops;
+unsigned long model_udr_collisions;
+
+// Interrupt handlers from nkuart_avr.c and the test
+void USART_RX_vect(void) __attribute__((weak));
+void USART_UDRE_vect(void) __attribute__((weak));
+void PCINT2_vect(void) __attribute__((weak));
+
+// Transmitter
+
+static uint8_t u2x;
+static int txc;
+static int tx_hold_full;
+static uint8_t tx_hold;
+static int tx_busy;
+static uint8_t tx_shift;
+static uint64_t tx_done;
+
+// Receiver
+
+static int rx_fifo_len;
+static uint8_t rx_fifo[2];
+static uint8_t rx_status[2];
+static int rx_busy;
+static uint8_t rx_shift;
+static uint64_t rx_done;
+
+// Peer
+
+#define PEER_BUF_SIZE 32
+#define PEER_STOP 16 // Stop the AVR when this full
+#define PEER_START 4 // Start it again when down to this
+#define PEER_CHARS_PER_BYTE 4 // Character times to consume each byte
+
+static unsigned peer_buf_len;
+static uint64_t peer_next_consume;
+static int peer_stopping; // Peer has stopped the AVR
+static int peer_xoff; // AVR has sent XOFF to the peer
+static uint8_t peer_xchar; // XON or XOFF for peer to send
+static unsigned long peer_send_left;
+static unsigned long peer_send_idx;
+
+static int pcint_pending;
+
+// Cycles per character
+
+static uint64_t char_time(void)
+{
+    unsigned long ubrr = ((unsigned long)(UBRR0H & 0x0F) << 8) | UBRR0L;
+    unsigned long bits = 1 + 8 + ((UCSR0C & (1 << USBS0)) ? 2 : 1);
+    return (u2x ? 8 : 16) * (ubrr + 1) * bits;
+}
+
+static int peer_held(void)
+{
+#ifdef NK_UART_RTS_PORT
+    if (PORTD & (1 << RTS_BIT))
+        return 1;
+#endif
+    return peer_xoff;
+}
+
+// Peer starts sending its next character if it can
+
+static void peer_try_send(uint64_t t)
+{
+    if (rx_busy)
+        return;
+    if (peer_xchar) {
+        rx_shift = peer_xchar;
+        peer_xchar = 0;
+    } else if (peer_send_left && !peer_held()) {
+        rx_shift = (uint8_t)MODEL_PATTERN(peer_send_idx);
+        ++peer_send_idx;
+        --peer_send_left;
+    } else {
+        return;
+    }
+    rx_busy = 1;
+    rx_done = t + char_time();
+}
+
+// Peer stops or starts the AVR depending on its buffer level
+
+static void peer_flow(void)
+{
+    int stop = peer_stopping;
+    if (peer_buf_len >= PEER_STOP)
+        stop = 1;
+    else if (peer_buf_len <= PEER_START)
+        stop = 0;
+    if (stop == peer_stopping)
+        return;
+    peer_stopping = stop;
+    if (stop)
+        ++model_peer_stops;
+#ifdef NK_UART_XONXOFF
+    peer_xchar = stop ? XOFF : XON;
+#endif
+#ifdef NK_UART_CTS_PIN
+    if (stop) {
+        PIND |= (1 << CTS_BIT);
+    } else {
+        PIND &= (uint8_t)~(1 << CTS_BIT);
+        pcint_pending = 1;
+    }
+#endif
+}
+
+static void peer_receive(uint8_t c, uint64_t t)
+{
+#ifdef NK_UART_XONXOFF
+    if (c == XON || c == XOFF) {
+        peer_xoff = (c == XOFF);
+        if (peer_xoff)
+            ++model_avr_stops;
+        return;
+    }
+#endif
+    if (c != (uint8_t)MODEL_PATTERN(model_peer_rx_count))
+        ++model_peer_rx_errors;
+    ++model_peer_rx_count;
+    if (peer_buf_len == PEER_BUF_SIZE) {
+        ++model_peer_rx_lost;
+    } else {
+        if (!peer_buf_len)
+            peer_next_consume = t + PEER_CHARS_PER_BYTE * char_time();
+        ++peer_buf_len;
+    }
+    peer_flow();
+}
+
+static void tx_start(uint64_t t)
+{
+    if (!tx_busy && tx_hold_full) {
+        tx_shift = tx_hold;
+        tx_hold_full = 0;
+        tx_busy = 1;
+        tx_done = t + char_time();
+    }
+}
+
+// Run everything which happens up to now, in time order
+
+void model_peripheral_step(void)
+{
+    for (;;) {
+        uint64_t t = model_cycles + 1;
+        int which = 0;
+        if (tx_busy && tx_done < t) {
+            t = tx_done;
+            which = 1;
+        }
+        if (rx_busy && rx_done < t) {
+            t = rx_done;
+            which = 2;
+        }
+        if (peer_buf_len && peer_next_consume < t) {
+            t = peer_next_consume;
+            which = 3;
+        }
+        if (!which)
+            break;
+        switch (which) {
+            case 1: // Character has left the AVR
+                tx_busy = 0;
+                peer_receive(tx_shift, t);
+                tx_start(t);
+                if (!tx_busy)
+                    txc = 1;
+                break;
+            case 2: // Character has arrived at the AVR
+                rx_busy = 0;
+                if (rx_fifo_len == 2) {
+                    // Lost
+                    rx_status[1] |= (1 << DOR0);
+                } else {
+                    rx_fifo[rx_fifo_len] = rx_shift;
+                    rx_status[rx_fifo_len] = 0;
+                    ++rx_fifo_len;
+                }
+                break;
+            case 3: // Peer consumed a byte
+                if (--peer_buf_len)
+                    peer_next_consume = t + PEER_CHARS_PER_BYTE * char_time();
+                peer_flow();
+                break;
+        }
+        peer_try_send(t);
+    }
+}
+
+model_isr_t model_peripheral_interrupt(void)
+{
+    if (pcint_pending) {
+        pcint_pending = 0;
+        if (PCINT2_vect)
+            return PCINT2_vect;
+    }
+    if ((UCSR0B & (1 << RXCIE0)) && rx_fifo_len && USART_RX_vect)
+        return USART_RX_vect;
+    if ((UCSR0B & (1 << UDRIE0)) && !tx_hold_full && USART_UDRE_vect)
+        return USART_UDRE_vect;
+    return NULL;
+}
+
+void model_peer_send_byte(uint8_t c)
+{
+    peer_xchar = c;
+    peer_try_send(model_cycles);
+}
+
+void model_peer_send(unsigned long count)
+{
+    peer_send_left += count;
+    peer_try_send(model_cycles);
+}
+
+// Register accesses from the code under test: each costs a cycle
+
+volatile uint8_t *model_sreg(void)
+{
+    model_cpu(1);
+    return &SREG;
+}
+
+uint8_t model_rd(volatile uint8_t *reg)
+{
+    model_cpu(1);
+    if (reg == &UCSR0A) {
+        uint8_t val = u2x;
+        if (rx_fifo_len)
+            val |= (uint8_t)((1 << RXC0) | rx_status[0]);
+        if (txc)
+            val |= (1 << TXC0);
+        if (!tx_hold_full)
+            val |= (1 << UDRE0);
+        return val;
+    } else if (reg == &UDR0) {
+        uint8_t c = rx_fifo[0];
+        if (rx_fifo_len) {
+            rx_fifo[0] = rx_fifo[1];
+            rx_status[0] = rx_status[1];
+            --rx_fifo_len;
+        }
+        return c;
+    } else {
+        return *reg;
+    }
+}
+
+void model_wr(volatile uint8_t *reg, uint8_t val)
+{
+    model_cpu(1);
+    if (reg == &UCSR0A) {
+        u2x = val & (1 << U2X0);
+        if (val & (1 << TXC0))
+            txc = 0;
+    } else if (reg == &UDR0) {
+        if (tx_hold_full)
+            ++model_udr_collisions;
+        tx_hold = val;
+        tx_hold_full = 1;
+        tx_start(model_cycles);
+    } else {
+        if (reg == &PORTD && (val & ~PORTD & (1 << RTS_BIT)))
+            ++model_avr_stops;
+        *reg = val;
+        peer_try_send(model_cycles);
+    }
+}
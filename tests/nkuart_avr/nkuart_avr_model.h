@@ -0,0 +1,27 @@
+// Host model of AVR USART 0 and the device at the other end of its line
+
+#include <stdint.h>
+
+// Send count bytes of the test pattern to the AVR
+void model_peer_send(unsigned long count);
+
+// Send one byte to the AVR, ahead of the pattern
+void model_peer_send_byte(uint8_t c);
+
+// Bytes the AVR has sent to the peer, and how many of them did not match
+// the test pattern
+extern unsigned long model_peer_rx_count;
+extern unsigned long model_peer_rx_errors;
+
+// Bytes lost because the peer's buffer was full
+extern unsigned long model_peer_rx_lost;
+
+// Number of times the peer asked the AVR to stop, and was asked to stop
+extern unsigned long model_peer_stops;
+extern unsigned long model_avr_stops;
+
+// Writes to UDR while it was not empty
+extern unsigned long model_udr_collisions;
+
+// Test pattern: avoids XON and XOFF
+#define MODEL_PATTERN(n) ((char)('A' + (n) % 26))
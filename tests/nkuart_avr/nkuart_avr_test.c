@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "nksched.h"
+#include "nkuart.h"
+#include "nkarch_avr_model.h"
+#include "nkuart_avr_model.h"
+
+// Stream the test pattern both ways between nkuart_avr.c and a slow
+// consumer, at 1 Mbaud, and count lost bytes
+
+#define TX_LEN 2000
+#define RX_LEN 600
+
+// Rx consumer takes this many bytes per millisecond
+#define RX_PER_MS 8
+
+int tid_rx, tid_end;
+
+char tx_data[TX_LEN];
+
+unsigned long rx_got;
+unsigned long rx_errors;
+
+#ifdef NK_UART_CTS_PIN
+// The application's pin change interrupt for CTS
+ISR(PCINT2_vect)
+{
+	nk_uart_cts_changed(&nk_uart0);
+}
+#endif
+
+void rx_task(void *data)
+{
+	int n;
+	(void)data;
+	for (n = 0; n != RX_PER_MS; ++n) {
+		int c = nk_getc();
+		if (c == -1)
+			break;
+		if (c != MODEL_PATTERN(rx_got))
+			++rx_errors;
+		++rx_got;
+	}
+	if (n)
+		nk_sched(tid_rx, rx_task, NULL, 1, "Slow consumer");
+	else
+		nk_set_uart_callback(tid_rx, rx_task, NULL);
+}
+
+// In binary mode (YMODEM), XON and XOFF are data
+
+void binary_task(void *data)
+{
+	int c = nk_getc();
+	unsigned long before = model_peer_rx_count;
+	char ch = MODEL_PATTERN(TX_LEN);
+	(void)data;
+	printf("Binary: received 0x%x\n", c);
+	nk_uart_write(&ch, 1);
+	nk_uart_flush();
+	printf("Binary: peer received %lu more\n", model_peer_rx_count - before);
+	fflush(stdout);
+	exit(0);
+}
+
+void end_task(void *data)
+{
+	nk_uart_stats_t stats;
+	(void)data;
+	nk_uart_get_stats(&stats, 0);
+	printf("Rx: sent %d, received %lu, mismatches %lu\n", RX_LEN, rx_got, rx_errors);
+	printf("Rx: overruns %u, dropped %u, high water %u\n", stats.overrun, stats.dropped, stats.high_water);
+	printf("Rx: AVR asked the peer to stop %lu times\n", model_avr_stops);
+
+	nk_unsched(tid_rx);
+	nk_set_uart_mode(1);
+	model_peer_send_byte(0x13);
+	nk_sched(tid_end, binary_task, NULL, 1, "Binary");
+}
+
+void tx_test(void)
+{
+	int x;
+	uint64_t start = model_cycles;
+	for (x = 0; x != TX_LEN; ++x)
+		tx_data[x] = MODEL_PATTERN(x);
+	nk_uart_write(tx_data, TX_LEN);
+	nk_uart_flush();
+	printf("Tx: sent %d, peer received %lu, mismatches %lu, lost %lu\n", TX_LEN, model_peer_rx_count, model_peer_rx_errors, model_peer_rx_lost);
+	printf("Tx: peer asked the AVR to stop %lu times, UDR collisions %lu\n", model_peer_stops, model_udr_collisions);
+	printf("Tx: took %lu us\n", (unsigned long)((model_cycles - start) / (F_CPU / 1000000)));
+}
+
+// Switch to 115200 (U2X at 16 MHz) and back: 230400 is too far off
+
+#define BAUD_LEN 10
+
+void baud_test(void)
+{
+	uint64_t start;
+	int rtn = nk_uart_check_baud(&nk_uart0, 230400);
+	printf("Baud: check 230400 returned %d, 115200 returned %d\n", rtn, nk_uart_check_baud(&nk_uart0, 115200));
+	rtn = nk_uart_set_baud(&nk_uart0, 230400);
+	printf("Baud: set 230400 returned %d\n", rtn);
+	rtn = nk_uart_set_baud(&nk_uart0, 115200);
+	printf("Baud: set 115200 returned %d, rate is %lu\n", rtn, (unsigned long)nk_uart_get_baud(&nk_uart0));
+	start = model_cycles;
+	nk_uart_write(tx_data, BAUD_LEN);
+	nk_uart_flush();
+	printf("Baud: %d characters took %lu us\n", BAUD_LEN, (unsigned long)((model_cycles - start) / (F_CPU / 1000000)));
+	rtn = nk_uart_set_baud(&nk_uart0, BAUD);
+	printf("Baud: set %lu returned %d\n", (unsigned long)BAUD, rtn);
+}
+
+int main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	nk_init_sched();
+	nk_set_sched_sleep_mode(1);
+	nk_init_uart();
+
+#if defined(NK_UART_XONXOFF)
+	printf("XON/XOFF flow control\n");
+#elif defined(NK_UART_CTS_PIN)
+	printf("RTS/CTS flow control\n");
+#else
+	printf("No flow control\n");
+#endif
+
+	tx_test();
+	baud_test();
+
+	tid_rx = nk_alloc_tid();
+	tid_end = nk_alloc_tid();
+	nk_set_uart_callback(tid_rx, rx_task, NULL);
+	nk_sched(tid_end, end_task, NULL, 200, "End");
+	model_peer_send(RX_LEN);
+
+	nk_sched_loop();
+
+	return 0;
+}
@@ -0,0 +1,7 @@
+// The Makefile selects the flow control mode
+
+#include "nkarch.h"
+
+#define NK_UART_RXBUF_SIZE 128
+
+#define NK_UART_TXBUF_SIZE 64